@@ -0,0 +1,543 @@
+/*
+ * Benchmark of the engine, without GIMP.
+ *
+ * Runs a fixed table of cases over the images in Test/in_images,
+ * through the simple API imageSynth() (heal a selection from its surroundings)
+ * and through the full engine() (separate target and corpus.)
+ * Selections are the predefined rectangles of Test/testResynth.py.
+ * The engine seeds its prng with a fixed seed, so a case is repeatable
+ * (exactly, only when not threaded; see buildSwitches.h.)
+ *
+ * Reports per case, as JSON on stdout:
+ * wall and CPU time, target pixels and probes per second, peak RSS, and a checksum of the result.
+ * Compare the JSON of two builds to measure a change to the engine.
+ *
+ * Build with the library sources, like Test.cpp, e.g.:
+ *   g++ -O2 -pthread Benchmark.cpp engine.cpp imageSynth.cpp imageSynthArena.cpp engineParams.cpp imageFormat.cpp glibProxy.cpp -lpng -o benchmark
+ * Define BENCHMARK_NO_PNG to build without libpng; then only PPM/PGM images load
+ * (convert the PNGs, keeping their names, e.g. brick.ppm.)
+ *
+ * Usage:
+ *   benchmark [imagesDirectory [repetitions [caseNameSubstring]]]
+ * Defaults: ../Test/in_images, 1 repetition, all cases.
+ * With repetitions, reports the fastest.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>  // getrusage, peak RSS
+
+#ifndef BENCHMARK_NO_PNG
+#include <png.h>
+#endif
+
+#include "buildSwitches.h"  // THREAD_LIMIT
+#include "glibProxy.h"
+#include "imageSynthConstants.h"
+#include "imageFormat.h"
+#include "imageFormatIndicies.h"
+#include "map.h"
+#include "engineParams.h"
+#include "engine.h"
+#include "imageSynth.h"
+
+
+/*
+ * An image in memory: not row padded, pixelels per pixel given by format.
+ */
+typedef struct {
+	unsigned int width;
+	unsigned int height;
+	TImageFormat format;
+	unsigned int pixelelsPerPixel;
+	std::vector<unsigned char> data;
+} TBenchmarkImage;
+
+
+// Rectangle: x, y, width, height.  Same as GIMP's gimp_rect_select
+typedef struct {
+	unsigned int x;
+	unsigned int y;
+	unsigned int width;
+	unsigned int height;
+} TBenchmarkRect;
+
+// Selections of Test/testResynth.py
+static const TBenchmarkRect select1 = { 100, 90, 100, 50 };   // ufo
+static const TBenchmarkRect select2 = { 90, 175, 135, 100 };  // donkey
+static const TBenchmarkRect selectBrick = { 156, 156, 200, 200 };
+static const TBenchmarkRect selectNone = { 0, 0, 0, 0 };
+
+
+typedef enum {
+	BENCHMARK_HEAL,          // imageSynth(): heal the selection from the rest of the image
+	BENCHMARK_UNCROP,        // imageSynth(): enlarge the image by a fifth on each side, and fill the border
+	BENCHMARK_RENDER_TEXTURE // engine(): synthesize a new, empty image (targetSize square) from the whole corpus
+} TBenchmarkKind;
+
+
+typedef struct {
+	const char* name;
+	TBenchmarkKind kind;
+	const char* fileName;     // in the images directory, without extension
+	TBenchmarkRect select;    // target, for BENCHMARK_HEAL
+	unsigned int targetSize;  // for BENCHMARK_RENDER_TEXTURE
+	int matchContextType;
+	unsigned int patchSize;   // zero for default
+	unsigned int maxProbeCount;
+	unsigned int localityBlockSize;
+	int matchMetric;          // IMAGE_SYNTH_METRIC_CAUCHY for default
+	int isCorpusTiled;        // FALSE for default
+} TBenchmarkCase;
+
+
+static const TBenchmarkCase cases[] = {
+	// Healing, as the Heal Selection plugin, in each image format
+	{ "heal-ufo", BENCHMARK_HEAL, "ufo-input", select1, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "heal-donkey", BENCHMARK_HEAL, "donkey_original", select2, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "heal-alpha", BENCHMARK_HEAL, "ufo-input-w-alpha", select1, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "heal-gray", BENCHMARK_HEAL, "wander", select1, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "heal-gray-alpha", BENCHMARK_HEAL, "ufo-input-w-alpha-gray", select1, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	// As the resynthesizer with parameters of testResynth.py
+	{ "heal-ufo-16-500", BENCHMARK_HEAL, "ufo-input", select1, 0, 1, 16, 500, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	// Metrics (parameter matchMetric)
+	{ "metric-sad", BENCHMARK_HEAL, "ufo-input", select1, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_SAD, FALSE },
+	{ "metric-ssd", BENCHMARK_HEAL, "ufo-input", select1, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_SSD, FALSE },
+	// Corpus matched from tiles (parameter isCorpusTiled.)  Compare with order-random and render-brick
+	{ "corpus-tiles-heal", BENCHMARK_HEAL, "brick", selectBrick, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, TRUE },
+	{ "corpus-tiles-render", BENCHMARK_RENDER_TEXTURE, "brick", selectNone, 256, 0, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, TRUE },
+	// Orders of synthesis (parameters matchContextType and localityBlockSize)
+	{ "order-random", BENCHMARK_HEAL, "brick", selectBrick, 0, 1, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "order-random-blocks-8", BENCHMARK_HEAL, "brick", selectBrick, 0, 1, 0, 0, 8, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "order-random-blocks-16", BENCHMARK_HEAL, "brick", selectBrick, 0, 1, 0, 0, 16, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "order-random-blocks-32", BENCHMARK_HEAL, "brick", selectBrick, 0, 1, 0, 0, 32, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "order-brushfire-inward", BENCHMARK_HEAL, "brick", selectBrick, 0, 2, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "order-horizontal-inward", BENCHMARK_HEAL, "brick", selectBrick, 0, 3, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "order-brushfire-outward", BENCHMARK_HEAL, "brick", selectBrick, 0, 5, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	// As the Uncrop plugin
+	{ "uncrop-ufo-small", BENCHMARK_UNCROP, "ufo-input-small", selectNone, 0, 5, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	// As the Render Texture plugin, through the full engine
+	{ "render-grass", BENCHMARK_RENDER_TEXTURE, "grass-input", selectNone, 256, 0, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+	{ "render-brick", BENCHMARK_RENDER_TEXTURE, "brick", selectNone, 256, 0, 0, 0, 0, IMAGE_SYNTH_METRIC_CAUCHY, FALSE },
+};
+
+
+static void progressCallback(int /*percent*/, void* /*context*/)
+{
+	// Quiet
+}
+
+
+static TImageFormat formatForPixelels(unsigned int pixelelsPerPixel)
+{
+	switch (pixelelsPerPixel)
+	{
+	case 1: return T_Gray;
+	case 2: return T_GrayA;
+	case 3: return T_RGB;
+	default: return T_RGBA;
+	}
+}
+
+
+/*
+ * Load binary PPM (P6) or PGM (P5) with maxval 255.
+ * Returns false if the file doesn't exist or isn't such.
+ */
+static bool loadPNM(const std::string& path, TBenchmarkImage* image)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+
+	char magic[3] = { 0 };
+	unsigned int values[3];
+	unsigned int count = 0;
+	bool isOK = (fread(magic, 1, 2, file) == 2) && magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6');
+	// Header: width, height, maxval, separated by whitespace and comments
+	while (isOK && count < 3)
+	{
+		int c = fgetc(file);
+		if (c == '#')
+			while (c != '\n' && c != EOF) c = fgetc(file);
+		else if (c >= '0' && c <= '9')
+		{
+			ungetc(c, file);
+			isOK = (fscanf(file, "%u", &values[count++]) == 1);
+		}
+		else if (c == EOF)
+			isOK = false;
+	}
+	isOK = isOK && values[2] == 255 && fgetc(file) != EOF;  // single whitespace after maxval
+	if (isOK)
+	{
+		image->width = values[0];
+		image->height = values[1];
+		image->pixelelsPerPixel = (magic[1] == '6') ? 3 : 1;
+		image->format = formatForPixelels(image->pixelelsPerPixel);
+		image->data.resize(image->width * image->height * image->pixelelsPerPixel);
+		isOK = fread(image->data.data(), 1, image->data.size(), file) == image->data.size();
+	}
+	fclose(file);
+	return isOK;
+}
+
+
+#ifndef BENCHMARK_NO_PNG
+/* Load PNG, as 8-bit gray, gray alpha, RGB, or RGBA, whichever is nearest the file. */
+static bool loadPNG(const std::string& path, TBenchmarkImage* image)
+{
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&png, path.c_str()))
+		return false;
+
+	bool isColor = (png.format & PNG_FORMAT_FLAG_COLOR) != 0;
+	bool isAlpha = (png.format & PNG_FORMAT_FLAG_ALPHA) != 0;
+	png.format = isColor ? (isAlpha ? PNG_FORMAT_RGBA : PNG_FORMAT_RGB) : (isAlpha ? PNG_FORMAT_GA : PNG_FORMAT_GRAY);
+
+	image->width = png.width;
+	image->height = png.height;
+	image->pixelelsPerPixel = PNG_IMAGE_PIXEL_CHANNELS(png.format);
+	image->format = formatForPixelels(image->pixelelsPerPixel);
+	image->data.resize(PNG_IMAGE_SIZE(png));
+	if (!png_image_finish_read(&png, NULL, image->data.data(), 0, NULL))
+	{
+		png_image_free(&png);
+		return false;
+	}
+	return true;
+}
+#endif
+
+
+/* Load fileName.ppm, fileName.pgm, or fileName.png */
+static bool loadImage(const std::string& directory, const char* fileName, TBenchmarkImage* image)
+{
+	std::string base = directory + "/" + fileName;
+	if (loadPNM(base + ".ppm", image) || loadPNM(base + ".pgm", image))
+		return true;
+#ifndef BENCHMARK_NO_PNG
+	if (loadPNG(base + ".png", image))
+		return true;
+#endif
+	return false;
+}
+
+
+/* FNV-1a, 64 bit */
+static unsigned long long checksum(const unsigned char* data, size_t size)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	size_t i;
+	for (i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+/* Peak resident set size of the process so far, in kilobytes (Linux units of ru_maxrss.) */
+static long peakRSSKilobytes()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+
+/*
+ * Internal pixmap of an image for the full engine: a mask pixelel, then the image's pixelels, then pad to depth.
+ * Every pixel has the given mask value.
+ */
+static void mapOfImage(const TBenchmarkImage* image, Pixelel maskValue, guint depth, Map* map)
+{
+	guint i;
+	new_pixmap(map, image->width, image->height, depth);
+	for (i = 0; i < image->width * image->height; i++)
+	{
+		Pixelel* pixel = &map->data[i * depth];
+		pixel[0] = maskValue;
+		memcpy(&pixel[1], &image->data[i * image->pixelelsPerPixel], image->pixelelsPerPixel);
+	}
+}
+
+
+typedef struct {
+	double wallMilliseconds;
+	double cpuMilliseconds;
+	unsigned int targetPixels;  // Count of pixels in the target
+	TImageSynthStats stats;
+	unsigned long long checksum;
+} TBenchmarkResult;
+
+
+static unsigned long long totalProbes(const TImageSynthStats* stats)
+{
+	unsigned long long probes = 0;
+	unsigned int pass;
+	for (pass = 0; pass < stats->passCount; pass++)
+		probes += stats->passes[pass].probes;
+	return probes;
+}
+
+
+static unsigned long long totalTargetsSynthesized(const TImageSynthStats* stats)
+{
+	unsigned long long count = 0;
+	unsigned int pass;
+	for (pass = 0; pass < stats->passCount; pass++)
+		count += stats->passes[pass].targetCount;
+	return count;
+}
+
+
+static void setCaseParameters(const TBenchmarkCase* benchmarkCase, TImageSynthParameters* parameters)
+{
+	setDefaultParams(parameters);
+	parameters->matchContextType = benchmarkCase->matchContextType;
+	parameters->localityBlockSize = benchmarkCase->localityBlockSize;
+	parameters->matchMetric = benchmarkCase->matchMetric;
+	parameters->isCorpusTiled = benchmarkCase->isCorpusTiled;
+	if (benchmarkCase->patchSize)
+		parameters->patchSize = benchmarkCase->patchSize;
+	if (benchmarkCase->maxProbeCount)
+		parameters->maxProbeCount = benchmarkCase->maxProbeCount;
+}
+
+
+/*
+ * Image and mask for the simple API: the input image with the selection,
+ * or for uncrop, the input centered in a larger image with the border selected.
+ */
+static void prepareSimpleCase(
+	const TBenchmarkCase* benchmarkCase,
+	const TBenchmarkImage* input,
+	TBenchmarkImage* image,          // OUT
+	std::vector<unsigned char>* mask // OUT
+	)
+{
+	unsigned int x;
+	unsigned int y;
+
+	if (benchmarkCase->kind == BENCHMARK_UNCROP)
+	{
+		unsigned int borderX = input->width / 5;
+		unsigned int borderY = input->height / 5;
+		unsigned int bytesPerPixel = input->pixelelsPerPixel;
+
+		image->width = input->width + 2 * borderX;
+		image->height = input->height + 2 * borderY;
+		image->format = input->format;
+		image->pixelelsPerPixel = bytesPerPixel;
+		image->data.assign(image->width * image->height * bytesPerPixel, 0);
+		mask->assign(image->width * image->height, 0xFF);
+		for (y = 0; y < input->height; y++)
+		{
+			memcpy(&image->data[((y + borderY) * image->width + borderX) * bytesPerPixel],
+				&input->data[y * input->width * bytesPerPixel],
+				input->width * bytesPerPixel);
+			memset(&(*mask)[(y + borderY) * image->width + borderX], 0, input->width);
+		}
+	}
+	else
+	{
+		const TBenchmarkRect* select = &benchmarkCase->select;
+		*image = *input;
+		mask->assign(image->width * image->height, 0);
+		for (y = select->y; y < select->y + select->height && y < image->height; y++)
+			for (x = select->x; x < select->x + select->width && x < image->width; x++)
+				(*mask)[y * image->width + x] = 0xFF;
+	}
+}
+
+
+static int runSimpleCase(const TBenchmarkCase* benchmarkCase, const TBenchmarkImage* input, TBenchmarkResult* result)
+{
+	TBenchmarkImage image;
+	std::vector<unsigned char> mask;
+	TImageSynthParameters parameters;
+	TImageSynthExtras extras = {};
+	int cancelFlag = 0;
+	unsigned int i;
+
+	prepareSimpleCase(benchmarkCase, input, &image, &mask);
+	setCaseParameters(benchmarkCase, &parameters);
+	extras.stats = &result->stats;
+	result->targetPixels = 0;
+	for (i = 0; i < mask.size(); i++)
+		result->targetPixels += (mask[i] != 0);
+
+	ImageBuffer imageBuffer = { image.data.data(), image.width, image.height, image.width * image.pixelelsPerPixel };
+	ImageBuffer maskBuffer = { mask.data(), image.width, image.height, image.width };
+
+	std::clock_t cpuStart = std::clock();
+	std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+	int error = imageSynthWithExtras(&imageBuffer, &maskBuffer, image.format, &parameters,
+		progressCallback, NULL, &cancelFlag, &extras);
+	result->wallMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+	result->cpuMilliseconds = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+	result->checksum = checksum(image.data.data(), image.data.size());
+	return error;
+}
+
+
+static int runEngineCase(const TBenchmarkCase* benchmarkCase, const TBenchmarkImage* corpus, TBenchmarkResult* result)
+{
+	TBenchmarkImage target;
+	TImageSynthParameters parameters;
+	TImageSynthExtras extras = {};
+	TFormatIndices indices;
+	Map targetMap;
+	Map corpusMap;
+	int cancelFlag = 0;
+	int error;
+
+	// Empty (black, opaque) target, wholly selected; whole corpus selected
+	target.width = benchmarkCase->targetSize;
+	target.height = benchmarkCase->targetSize;
+	target.format = corpus->format;
+	target.pixelelsPerPixel = corpus->pixelelsPerPixel;
+	target.data.assign(target.width * target.height * target.pixelelsPerPixel, 0);
+	if (target.format == T_RGBA || target.format == T_GrayA)
+		for (size_t i = target.pixelelsPerPixel - 1; i < target.data.size(); i += target.pixelelsPerPixel)
+			target.data[i] = 0xFF;
+
+	setCaseParameters(benchmarkCase, &parameters);
+	extras.stats = &result->stats;
+	result->targetPixels = target.width * target.height;
+
+	error = prepareImageFormatIndicesFromFormatType(&indices, target.format);
+	if (error) return error;
+
+	std::clock_t cpuStart = std::clock();
+	std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+	// Adapting is part of the time, as it is for the simple API
+	mapOfImage(&target, MASK_TOTALLY_SELECTED, indices.total_bpp, &targetMap);
+	mapOfImage(corpus, MASK_TOTALLY_SELECTED, indices.total_bpp, &corpusMap);
+	error = engine(parameters, &indices, &targetMap, &corpusMap, progressCallback, NULL, &cancelFlag, &extras);
+	result->wallMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+	result->cpuMilliseconds = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+	result->checksum = checksum(targetMap.data, targetMap.width * targetMap.height * targetMap.depth);
+	free_map(&targetMap);
+	free_map(&corpusMap);
+	return error;
+}
+
+
+static const char* kindName(TBenchmarkKind kind)
+{
+	switch (kind)
+	{
+	case BENCHMARK_HEAL: return "imageSynth";
+	case BENCHMARK_UNCROP: return "imageSynth";
+	default: return "engine";
+	}
+}
+
+
+static void printResult(const TBenchmarkCase* benchmarkCase, const TBenchmarkImage* input,
+	const TBenchmarkResult* result, bool isFirst)
+{
+	unsigned int pass;
+	double seconds = result->wallMilliseconds / 1000.0;
+	const TImageSynthStats* stats = &result->stats;
+
+	printf("%s    {\n", isFirst ? "" : ",\n");
+	printf("      \"name\": \"%s\",\n", benchmarkCase->name);
+	printf("      \"api\": \"%s\",\n", kindName(benchmarkCase->kind));
+	printf("      \"image\": \"%s\",\n", benchmarkCase->fileName);
+	printf("      \"width\": %u,\n", input->width);
+	printf("      \"height\": %u,\n", input->height);
+	printf("      \"pixelelsPerPixel\": %u,\n", input->pixelelsPerPixel);
+	printf("      \"targetPixels\": %u,\n", result->targetPixels);
+	printf("      \"wallMilliseconds\": %.3f,\n", result->wallMilliseconds);
+	printf("      \"cpuMilliseconds\": %.3f,\n", result->cpuMilliseconds);
+	printf("      \"pixelsPerSecond\": %.1f,\n", seconds > 0 ? totalTargetsSynthesized(stats) / seconds : 0);
+	printf("      \"probesPerSecond\": %.1f,\n", seconds > 0 ? totalProbes(stats) / seconds : 0);
+	printf("      \"peakRSSKilobytes\": %ld,\n", peakRSSKilobytes());
+	printf("      \"termination\": %d,\n", stats->termination);
+	printf("      \"prepareMilliseconds\": %.3f,\n", stats->prepareMilliseconds);
+	printf("      \"passes\": [");
+	for (pass = 0; pass < stats->passCount; pass++)
+	{
+		const TImageSynthPassStats* passStats = &stats->passes[pass];
+		printf("%s\n        { \"targets\": %u, \"betters\": %u, \"bettersByNeighborsSource\": %u, \"bettersByRandom\": %u,"
+			" \"perfectMatches\": %u, \"probes\": %llu, \"earlyOuts\": %llu, \"energy\": %llu, \"milliseconds\": %.3f }",
+			pass ? "," : "", passStats->targetCount, passStats->betters, passStats->bettersByNeighborsSource,
+			passStats->bettersByRandom, passStats->perfectMatches, passStats->probes, passStats->earlyOutCount,
+			passStats->energy, passStats->milliseconds);
+	}
+	printf("\n      ],\n");
+	printf("      \"checksum\": \"%016llx\"\n", result->checksum);
+	printf("    }");
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::string directory = (argc > 1) ? argv[1] : "../Test/in_images";
+	unsigned int repetitions = (argc > 2) ? atoi(argv[2]) : 1;
+	const char* filter = (argc > 3) ? argv[3] : "";
+	unsigned int i;
+	unsigned int repetition;
+	bool isFirst = true;
+	int status = 0;
+
+	if (repetitions < 1) repetitions = 1;
+
+	printf("{\n");
+	printf("  \"threadLimit\": %d,\n", THREAD_LIMIT);
+	printf("  \"repetitions\": %u,\n", repetitions);
+	printf("  \"cases\": [\n");
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		const TBenchmarkCase* benchmarkCase = &cases[i];
+		TBenchmarkImage input;
+		TBenchmarkResult best = {};
+
+		if (!strstr(benchmarkCase->name, filter))
+			continue;
+		if (!loadImage(directory, benchmarkCase->fileName, &input))
+		{
+			fprintf(stderr, "Can't load image %s/%s\n", directory.c_str(), benchmarkCase->fileName);
+			status = 1;
+			continue;
+		}
+
+		for (repetition = 0; repetition < repetitions; repetition++)
+		{
+			TBenchmarkResult result;
+			int error = (benchmarkCase->kind == BENCHMARK_RENDER_TEXTURE)
+				? runEngineCase(benchmarkCase, &input, &result)
+				: runSimpleCase(benchmarkCase, &input, &result);
+			if (error)
+			{
+				fprintf(stderr, "Case %s: engine returned error: %d\n", benchmarkCase->name, error);
+				status = 1;
+				break;
+			}
+			if (repetition == 0 || result.wallMilliseconds < best.wallMilliseconds)
+				best = result;
+		}
+		if (repetition == repetitions)
+		{
+			printResult(benchmarkCase, &input, &best, isFirst);
+			isFirst = false;
+			fflush(stdout);
+		}
+	}
+	printf("\n  ]\n}\n");
+	return status;
+}
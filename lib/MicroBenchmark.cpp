@@ -0,0 +1,508 @@
+/*
+ * Micro benchmark of the innermost routines of the engine, on synthetic pixmaps.
+ *
+ * Times, in isolation:
+ * computeBestFit()          ns per candidate and per neighbor compared, at several early out rates, per metric,
+ *                           and on a large corpus, from the row major pixmap versus tiles (parameter isCorpusTiled)
+ * prepare_neighbors()       ns per patch and per neighbor gathered
+ * clippedOrMaskedCorpus()   ns per call
+ * randomCorpusPoint()       ns per call
+ * synthesize()              ns per target point and per probe, for a fill pass and a refinement pass
+ * for each pixel format (T_RGB, T_RGBA, T_Gray, T_GrayA), without and with a (gray) map,
+ * and patch sizes up to IMAGE_SYNTH_MAX_NEIGHBORS.
+ *
+ * The early out rate is set by the best patch difference a candidate must beat.
+ * Thresholds are calibrated so that on average a candidate compares a given fraction of its neighbors
+ * before it early outs; the fraction actually measured is reported.
+ *
+ * This includes engine.cpp, for its static routines, so build it instead of engine.cpp, e.g.:
+ *   g++ -O2 -pthread MicroBenchmark.cpp engineParams.cpp imageFormat.cpp imageSynthArena.cpp glibProxy.cpp -o microbenchmark
+ * Usage:
+ *   microbenchmark
+ */
+#include <functional>  // std::function, before engine.cpp, which uses it
+
+#include "engine.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+// Side of synthetic target and corpus pixmaps
+#define MICRO_MAP_SIZE 256
+// Side of a corpus much larger than cache, and count of candidates, whose patches also exceed cache
+#define MICRO_LARGE_MAP_SIZE 2048
+#define MICRO_LARGE_CANDIDATE_COUNT 65536
+// Least time of a measurement
+#define MICRO_MIN_NANOSECONDS 20000000.0
+// Count of patches, and of candidates, that computeBestFit() cycles through
+#define MICRO_PATCH_COUNT 64
+#define MICRO_CANDIDATE_COUNT 4096
+// Count of (patch, candidate) pairs to calibrate early out thresholds
+#define MICRO_CALIBRATION_COUNT 256
+
+
+static const char* metricNames[IMAGE_SYNTH_METRIC_COUNT] = { "cauchy", "sad", "ssd" };
+
+// Keeps results alive, so the compiler doesn't elide the work measured
+static volatile guint64 sink;
+
+
+/*
+ * Time body(count), which does count items of work, growing count until the time is significant.
+ * Returns nanoseconds per item.
+ */
+template<typename Body>
+static double nanosecondsPerItem(Body body)
+{
+	guint count = 256;
+	for (;;)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		body(count);
+		double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		if (nanoseconds >= MICRO_MIN_NANOSECONDS || count >= (1u << 30))
+			return nanoseconds / count;
+		count *= 4;
+	}
+}
+
+
+typedef struct {
+	const char* name;
+	TImageFormat format;
+	guint colorChannels;
+	gboolean isAlpha;
+	guint mapChannels;
+} TMicroFormat;
+
+
+static const TMicroFormat formats[] = {
+	{ "RGB", T_RGB, 3, FALSE, 0 },
+	{ "RGBA", T_RGBA, 3, TRUE, 0 },
+	{ "Gray", T_Gray, 1, FALSE, 0 },
+	{ "GrayA", T_GrayA, 1, TRUE, 0 },
+	{ "RGB+map", T_RGB, 3, FALSE, 1 },
+	{ "RGBA+map", T_RGBA, 3, TRUE, 1 },
+	{ "Gray+map", T_Gray, 1, FALSE, 1 },
+	{ "GrayA+map", T_GrayA, 1, TRUE, 1 },
+};
+
+static const guint patchSizes[] = { 9, 25, 49, IMAGE_SYNTH_MAX_NEIGHBORS };
+
+// Mean fraction of a patch compared before early out.  1.0 means no early out.
+static const double visitFractions[] = { 1.0, 0.5, 0.25, 0.1 };
+
+
+// Corpus of a computeBestFit() benchmark
+typedef struct {
+	const char* name;
+	guint size;            // Side of the corpus
+	guint candidateCount;
+	gboolean isTiled;      // Match from a TCorpusTiles
+} TMicroCorpus;
+
+static const TMicroCorpus smallCorpus = { "rows", MICRO_MAP_SIZE, MICRO_CANDIDATE_COUNT, FALSE };
+static const TMicroCorpus largeCorpora[] = {
+	{ "rows", MICRO_LARGE_MAP_SIZE, MICRO_LARGE_CANDIDATE_COUNT, FALSE },
+	{ "tiles", MICRO_LARGE_MAP_SIZE, MICRO_LARGE_CANDIDATE_COUNT, TRUE },
+};
+static const guint largeCorpusPatchSizes[] = { 9, 25, 49 };
+
+
+/*
+ * Engine state for a format: a target (MICRO_MAP_SIZE square) and a corpus (corpusSize square) of random pixels,
+ * every target pixel has a value and a source (as in a refinement pass.)
+ * An eighth of the corpus rows are masked.
+ */
+typedef struct {
+	TImageSynthParameters parameters;
+	TFormatIndices indices;
+	Map targetMap;
+	Map corpusMap;
+	Map hasValueMap;
+	Map sourceOfMap;
+	PointVector corpusPoints;
+	PointVector sortedOffsets;
+	TPixelelMetricFunc corpusTargetMetric;
+	TMapPixelelMetricFunc mapMetric;
+	GRand* prng;
+	TCorpusTiles corpusTiles;  // Only if prepared
+	TImageSynthArena* arena;   // Of the engine's state, as a run's own
+} TMicroFixture;
+
+
+static void fillRandomPixmap(Map* map, Pixelel maskValue)
+{
+	guint i;
+	for (i = 0; i < map->width * map->height * map->depth; i++)
+		map->data[i] = static_cast<Pixelel>(rand());
+	for (i = 0; i < map->width * map->height; i++)
+		map->data[i * map->depth + MASK_PIXELEL_INDEX] = maskValue;
+}
+
+
+static void prepareFixture(TMicroFixture* fixture, const TMicroFormat* format, guint patchSize, guint corpusSize)
+{
+	guint x;
+	guint y;
+
+	setDefaultParams(&fixture->parameters);
+	fixture->parameters.patchSize = patchSize;
+	prepareImageFormatIndices(&fixture->indices, format->colorChannels, format->mapChannels,
+		format->isAlpha, format->isAlpha, format->mapChannels > 0);
+
+	fixture->prng = g_rand_new_with_seed(1198472);
+	fixture->arena = newImageSynthArena(TRUE);
+	new_pixmap(&fixture->targetMap, MICRO_MAP_SIZE, MICRO_MAP_SIZE, fixture->indices.total_bpp);
+	new_pixmap(&fixture->corpusMap, corpusSize, corpusSize, fixture->indices.total_bpp);
+	fillRandomPixmap(&fixture->targetMap, MASK_UNSELECTED);
+	fillRandomPixmap(&fixture->corpusMap, MASK_TOTALLY_SELECTED);
+	for (y = 0; y < corpusSize; y += 8)
+		for (x = 0; x < corpusSize; x++)
+		{
+			Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+			pixmap_index(&fixture->corpusMap, coords)[MASK_PIXELEL_INDEX] = MASK_UNSELECTED;
+		}
+	// Opaque, so nothing is excluded for transparency
+	if (format->isAlpha)
+	{
+		for (y = 0; y < MICRO_MAP_SIZE; y++)
+			for (x = 0; x < MICRO_MAP_SIZE; x++)
+			{
+				Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+				pixmap_index(&fixture->targetMap, coords)[fixture->indices.alpha_bip] = 0xFF;
+			}
+		for (y = 0; y < corpusSize; y++)
+			for (x = 0; x < corpusSize; x++)
+			{
+				Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+				pixmap_index(&fixture->corpusMap, coords)[fixture->indices.alpha_bip] = 0xFF;
+			}
+	}
+
+	prepareHasValue(&fixture->targetMap, &fixture->hasValueMap, fixture->arena);
+	set_bytemap(&fixture->hasValueMap, TRUE);
+	prepare_target_sources(&fixture->targetMap, &fixture->sourceOfMap, fixture->arena);
+	prepareCorpusPoints(&fixture->indices, &fixture->corpusMap, &fixture->corpusPoints, fixture->arena);
+	for (y = 0; y < MICRO_MAP_SIZE; y++)
+		for (x = 0; x < MICRO_MAP_SIZE; x++)
+		{
+			Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+			setSourceOf(coords, randomCorpusPoint(fixture->corpusPoints, fixture->prng), &fixture->sourceOfMap);
+		}
+	prepareSortedOffsets(&fixture->targetMap, &fixture->corpusMap, 0, &fixture->sortedOffsets, fixture->arena);
+	quantizeMetricFuncs(static_cast<float>(fixture->parameters.sensitivityToOutliers),
+		static_cast<float>(fixture->parameters.mapWeight), fixture->corpusTargetMetric, fixture->mapMetric);
+}
+
+
+static void freeFixture(TMicroFixture* fixture)
+{
+	free_map(&fixture->targetMap);
+	free_map(&fixture->corpusMap);
+	freeImageSynthArena(fixture->arena);
+}
+
+
+/* A point far enough inside the target that its patch is not clipped. */
+static Coordinates interiorPoint()
+{
+	Coordinates point = { 16 + rand() % (MICRO_MAP_SIZE - 32), 16 + rand() % (MICRO_MAP_SIZE - 32) };
+	return point;
+}
+
+
+/* Sum of the patch difference over the first countNeighbors, without early out. */
+static guint partialPatchDiff(TMicroFixture* fixture, Coordinates candidate, guint countNeighbors, const TNeighbor* neighbors,
+	Bounds patchBounds, TImageSynthMatchMetric metric, gboolean isTiled)
+{
+	guint sum = G_MAXUINT;
+	Coordinates best;
+	ImprovementType kind = NO_BETTERMENT;
+	TPassTally tally;
+	resetPassTally(&tally);
+	selectBestFit(&fixture->indices, metric, isTiled)(candidate, &fixture->indices, &fixture->corpusMap,
+		isTiled ? &fixture->corpusTiles : NULL, &sum, &best,
+		countNeighbors, neighbors, patchBounds, &kind, RANDOM_CORPUS, fixture->corpusTargetMetric, fixture->mapMetric, &tally);
+	return sum;
+}
+
+
+static void benchComputeBestFit(const TMicroFormat* format, guint patchSize, TImageSynthMatchMetric metric,
+	const TMicroCorpus* corpus)
+{
+	TMicroFixture fixture;
+	TBestFitFunc bestFit;
+	const TCorpusTiles* corpusTiles = NULL;
+	guint i;
+	guint k;
+
+	prepareFixture(&fixture, format, patchSize, corpus->size);
+	if (corpus->isTiled)
+	{
+		prepareCorpusTiles(&fixture.corpusTiles, &fixture.indices, &fixture.corpusMap);
+		corpusTiles = &fixture.corpusTiles;
+	}
+	bestFit = selectBestFit(&fixture.indices, metric, corpus->isTiled);
+
+	std::vector<TNeighbor> patches(MICRO_PATCH_COUNT * IMAGE_SYNTH_MAX_NEIGHBORS);
+	std::vector<guint> countNeighbors(MICRO_PATCH_COUNT);
+	std::vector<Bounds> patchBounds(MICRO_PATCH_COUNT);
+	std::vector<Coordinates> candidates(corpus->candidateCount);
+	for (i = 0; i < MICRO_PATCH_COUNT; i++)
+		countNeighbors[i] = prepare_neighbors(interiorPoint(), &fixture.parameters, &fixture.indices,
+			&fixture.targetMap, &fixture.corpusMap, &fixture.hasValueMap, &fixture.sourceOfMap, fixture.sortedOffsets,
+			&patches[i * IMAGE_SYNTH_MAX_NEIGHBORS], &patchBounds[i]);
+	for (i = 0; i < corpus->candidateCount; i++)
+		candidates[i] = randomCorpusPoint(fixture.corpusPoints, fixture.prng);
+
+	// Calibrate: partial sums of a sample of (patch, candidate) pairs
+	std::vector<guint> partialSums(MICRO_CALIBRATION_COUNT * (patchSize + 1));
+	for (i = 0; i < MICRO_CALIBRATION_COUNT; i++)
+		for (k = 1; k <= countNeighbors[i % MICRO_PATCH_COUNT]; k++)
+			partialSums[i * (patchSize + 1) + k] = partialPatchDiff(&fixture, candidates[i], k,
+				&patches[(i % MICRO_PATCH_COUNT) * IMAGE_SYNTH_MAX_NEIGHBORS], patchBounds[i % MICRO_PATCH_COUNT], metric,
+				corpus->isTiled);
+
+	for (double visitFraction : visitFractions)
+	{
+		guint threshold = G_MAXUINT;
+		if (visitFraction < 1.0)
+		{
+			// Mean partial sum at the fraction of the patch
+			guint64 total = 0;
+			guint position = MAX(1u, static_cast<guint>(visitFraction * patchSize + 0.5));
+			for (i = 0; i < MICRO_CALIBRATION_COUNT; i++)
+				total += partialSums[i * (patchSize + 1) + MIN(position, countNeighbors[i % MICRO_PATCH_COUNT])];
+			threshold = static_cast<guint>(total / MICRO_CALIBRATION_COUNT);
+		}
+
+		// Mean neighbors compared per candidate, at the threshold: the first at which the sum reaches it
+		guint64 visited = 0;
+		for (i = 0; i < MICRO_CALIBRATION_COUNT; i++)
+		{
+			guint count = countNeighbors[i % MICRO_PATCH_COUNT];
+			for (k = 1; k < count && partialSums[i * (patchSize + 1) + k] < threshold; k++)
+				;
+			visited += k;
+		}
+		double meanVisited = static_cast<double>(visited) / MICRO_CALIBRATION_COUNT;
+
+		guint64 earlyOuts = 0;
+		guint64 candidatesTimed = 0;
+		TPassTally tally;
+		double nanoseconds = nanosecondsPerItem([&](guint count) {
+			guint j;
+			resetPassTally(&tally);
+			earlyOuts = 0;
+			candidatesTimed = count;
+			for (j = 0; j < count; j++)
+			{
+				guint patch = j % MICRO_PATCH_COUNT;
+				guint best = threshold;
+				Coordinates bestPoint;
+				ImprovementType kind = NO_BETTERMENT;
+				bestFit(candidates[j % corpus->candidateCount], &fixture.indices, &fixture.corpusMap, corpusTiles,
+					&best, &bestPoint, countNeighbors[patch], &patches[patch * IMAGE_SYNTH_MAX_NEIGHBORS], patchBounds[patch],
+					&kind, RANDOM_CORPUS, fixture.corpusTargetMetric, fixture.mapMetric, &tally);
+			}
+			for (j = 0; j < IMAGE_SYNTH_MAX_NEIGHBORS; j++)
+				earlyOuts += tally.earlyOuts[j];
+			sink += earlyOuts;
+		});
+
+		printf("%-10s %-7s %-6s %6u %8.2f %10.1f %10.2f %12.2f %10.2f\n", format->name, metricNames[metric], corpus->name,
+			patchSize, visitFraction,
+			meanVisited, static_cast<double>(earlyOuts) / candidatesTimed, nanoseconds, nanoseconds / meanVisited);
+	}
+	freeFixture(&fixture);
+}
+
+
+static void benchPrepareNeighbors(const TMicroFormat* format, guint patchSize, double hasValueFraction)
+{
+	TMicroFixture fixture;
+	TNeighbor neighbors[IMAGE_SYNTH_MAX_NEIGHBORS];
+	Bounds patchBounds;
+	std::vector<Coordinates> positions(MICRO_CANDIDATE_COUNT);
+	guint i;
+	guint x;
+	guint y;
+
+	prepareFixture(&fixture, format, patchSize, MICRO_MAP_SIZE);
+	for (y = 0; y < MICRO_MAP_SIZE; y++)
+		for (x = 0; x < MICRO_MAP_SIZE; x++)
+		{
+			Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+			setHasValue(&coords, (rand() < hasValueFraction * RAND_MAX), &fixture.hasValueMap);
+		}
+	for (i = 0; i < MICRO_CANDIDATE_COUNT; i++)
+		positions[i] = interiorPoint();
+
+	guint64 neighborsGathered = 0;
+	double nanoseconds = nanosecondsPerItem([&](guint count) {
+		guint j;
+		neighborsGathered = 0;
+		for (j = 0; j < count; j++)
+			neighborsGathered += prepare_neighbors(positions[j % MICRO_CANDIDATE_COUNT], &fixture.parameters, &fixture.indices,
+				&fixture.targetMap, &fixture.corpusMap, &fixture.hasValueMap, &fixture.sourceOfMap, fixture.sortedOffsets,
+				neighbors, &patchBounds);
+		sink += neighborsGathered;
+		neighborsGathered /= count;
+	});
+
+	printf("%-10s %6u %8.2f %10llu %12.2f %10.2f\n", format->name, patchSize, hasValueFraction,
+		static_cast<unsigned long long>(neighborsGathered), nanoseconds, neighborsGathered ? nanoseconds / neighborsGathered : 0);
+	freeFixture(&fixture);
+}
+
+
+static void benchCorpusPoints(const TMicroFormat* format)
+{
+	TMicroFixture fixture;
+	std::vector<Coordinates> points(MICRO_CANDIDATE_COUNT);
+	guint i;
+
+	prepareFixture(&fixture, format, 9, MICRO_MAP_SIZE);
+	// Some clipped, some masked
+	for (i = 0; i < MICRO_CANDIDATE_COUNT; i++)
+	{
+		points[i].x = rand() % (MICRO_MAP_SIZE + 32) - 16;
+		points[i].y = rand() % (MICRO_MAP_SIZE + 32) - 16;
+	}
+
+	double clippedNanoseconds = nanosecondsPerItem([&](guint count) {
+		guint j;
+		guint64 clipped = 0;
+		for (j = 0; j < count; j++)
+			clipped += clippedOrMaskedCorpus(points[j % MICRO_CANDIDATE_COUNT], &fixture.corpusMap);
+		sink += clipped;
+	});
+
+	double randomNanoseconds = nanosecondsPerItem([&](guint count) {
+		guint j;
+		guint64 total = 0;
+		for (j = 0; j < count; j++)
+			total += randomCorpusPoint(fixture.corpusPoints, fixture.prng).x;
+		sink += total;
+	});
+
+	printf("%-10s %22.2f %22.2f\n", format->name, clippedNanoseconds, randomNanoseconds);
+	freeFixture(&fixture);
+}
+
+
+/*
+ * One fill pass, then one refinement pass, of synthesize() over a hole (a quarter of the side)
+ * in a random target, with default parameters.
+ * Every thread's slice in turn, on this thread.
+ */
+static void benchSynthesize(const TMicroFormat* format)
+{
+	TMicroFixture fixture;
+	TTargetCount targetCount;
+	TProbeRandom orderRandom;
+	PointVector targetPoints;
+	Map recentProberMap;
+	guint x;
+	guint y;
+	guint pass;
+	int cancelFlag = 0;
+	std::function<void()> deepProgressCallback = []() -> void {};
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	prepareFixture(&fixture, format, 30, MICRO_MAP_SIZE);
+	for (y = MICRO_MAP_SIZE * 3 / 8; y < MICRO_MAP_SIZE * 5 / 8; y++)
+		for (x = MICRO_MAP_SIZE * 3 / 8; x < MICRO_MAP_SIZE * 5 / 8; x++)
+		{
+			Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+			pixmap_index(&fixture.targetMap, coords)[MASK_PIXELEL_INDEX] = MASK_TOTALLY_SELECTED;
+		}
+	// As the engine does, from the start (the fixture's maps stay in its arena)
+	countTargetPoints(&fixture.targetMap, &targetCount);
+	prepareTargetPoints(fixture.parameters.matchContextType, &fixture.indices, &fixture.targetMap, &targetCount,
+		&fixture.hasValueMap, &targetPoints, fixture.arena);
+	prepare_target_sources(&fixture.targetMap, &fixture.sourceOfMap, fixture.arena);
+	prepareProbeRandom(&orderRandom, fixture.prng);
+	orderTargetPoints(&fixture.parameters, targetPoints, &fixture.hasValueMap, &orderRandom);
+	prepareRecentProber(&fixture.corpusMap, &recentProberMap, fixture.arena);
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		TPassSchedule schedule;
+		TPassTally passTally;
+		guint threadIndex;
+
+		resetPassTally(&passTally);
+		preparePassSchedule(&schedule, &fixture.parameters, pass, startTime);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (threadIndex = 0; threadIndex < THREAD_LIMIT; threadIndex++)
+		{
+			TPassTally tally;
+			synthesize(&fixture.parameters, &schedule, threadIndex, 0, targetPoints->len,
+				&fixture.indices, &fixture.targetMap, &fixture.corpusMap, &recentProberMap,
+				&fixture.hasValueMap, &fixture.sourceOfMap, targetPoints, fixture.corpusPoints, fixture.sortedOffsets,
+				fixture.prng, fixture.corpusTargetMetric, fixture.mapMetric,
+				selectBestFit(&fixture.indices, IMAGE_SYNTH_METRIC_CAUCHY, FALSE), NULL, NULL, deepProgressCallback, &cancelFlag, &tally);
+			addPassTally(&passTally, &tally);
+		}
+		double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		printf("%-10s %6s %8u %12llu %14.1f %12.2f\n", format->name, pass ? "refine" : "fill", passTally.targetCount,
+			static_cast<unsigned long long>(passTally.probes),
+			nanoseconds / passTally.targetCount, passTally.probes ? nanoseconds / passTally.probes : 0);
+	}
+
+	freeFixture(&fixture);
+}
+
+
+int main()
+{
+	const guint formatCount = sizeof(formats) / sizeof(formats[0]);
+	guint i;
+
+	printf("computeBestFit, %d patches x %d candidates\n", MICRO_PATCH_COUNT, MICRO_CANDIDATE_COUNT);
+	printf("%-10s %-7s %-6s %6s %8s %10s %10s %12s %10s\n", "format", "metric", "corpus", "patch", "target",
+		"neighbors", "earlyouts", "ns/candidate", "ns/neighbor");
+	for (i = 0; i < formatCount; i++)
+		for (guint patchSize : patchSizes)
+			for (int metric = 0; metric < IMAGE_SYNTH_METRIC_COUNT; metric++)
+				benchComputeBestFit(&formats[i], patchSize, (TImageSynthMatchMetric)metric, &smallCorpus);
+
+	printf("\ncomputeBestFit, corpus %d square, %d patches x %d candidates\n",
+		MICRO_LARGE_MAP_SIZE, MICRO_PATCH_COUNT, MICRO_LARGE_CANDIDATE_COUNT);
+	printf("%-10s %-7s %-6s %6s %8s %10s %10s %12s %10s\n", "format", "metric", "corpus", "patch", "target",
+		"neighbors", "earlyouts", "ns/candidate", "ns/neighbor");
+	for (i = 0; i < formatCount; i++)
+		for (guint patchSize : largeCorpusPatchSizes)
+			for (const TMicroCorpus& corpus : largeCorpora)
+				benchComputeBestFit(&formats[i], patchSize, IMAGE_SYNTH_METRIC_CAUCHY, &corpus);
+
+	printf("\nprepare_neighbors\n");
+	printf("%-10s %6s %8s %10s %12s %10s\n", "format", "patch", "hasValue", "neighbors", "ns/patch", "ns/neighbor");
+	for (i = 0; i < formatCount; i++)
+		for (guint patchSize : patchSizes)
+		{
+			benchPrepareNeighbors(&formats[i], patchSize, 1.0);
+			benchPrepareNeighbors(&formats[i], patchSize, 0.1);
+		}
+
+	printf("\nclippedOrMaskedCorpus, randomCorpusPoint\n");
+	printf("%-10s %22s %22s\n", "format", "ns/clippedOrMasked", "ns/randomCorpusPoint");
+	for (i = 0; i < formatCount; i++)
+		benchCorpusPoints(&formats[i]);
+
+	{
+		TImageSynthParameters parameters;
+		setDefaultParams(&parameters);
+		printf("\nsynthesize, one pass, patch 30, %u probes\n", parameters.maxProbeCount);
+	}
+	printf("%-10s %6s %8s %12s %14s %12s\n", "format", "pass", "targets", "probes", "ns/target", "ns/probe");
+	for (i = 0; i < formatCount; i++)
+		benchSynthesize(&formats[i]);
+
+	return 0;
+}
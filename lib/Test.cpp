@@ -1,10 +1,13 @@
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 
 #include "glibProxy.h"  
 #include "engineParams.h"
 #include "imageSynth.h"
+#include "imageSynthCache.h"
+#include "imageSynthApply.h"
 #include "map.h" 
  
 
@@ -38,7 +41,7 @@ static void dumpImage(unsigned int count, Map targetMap)
 	for (i = 0; i<count; i++)
 	{
 		// hh is char, x is hex notation, O is left pad with zeroes, 2 is field width
-		printf("%02hhx ", static_cast<char>(targetMap.data->data[i]));
+		printf("%02hhx ", static_cast<char>(targetMap.data[i]));
 		if (i % 5 == 4)
 		{
 			printf("\n");	// spaces after every 5 pixelels, ie after a pixel
@@ -94,6 +97,1072 @@ static void test(const char * description,
 }
 
 
+/**
+ * \brief Fill a noisy test image, and its mask selecting holes
+ *
+ * The image is gray, or (isColor) color, RGB or (pixelelCount 4) RGBA and opaque.
+ * Pixels in the holes are painted (isMagenta) magenta, a color not in the corpus.
+ */
+static void fillNoisyImage(unsigned char* image, unsigned char* mask,
+	unsigned int width, unsigned int height, unsigned int pixelelCount, gboolean isColor,
+	const TImageSynthMaskBounds* holes, unsigned int holeCount, gboolean isMagenta)
+{
+	unsigned int x;
+	unsigned int y;
+	unsigned int i;
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+		{
+			unsigned char* pixel = &image[(y * width + x) * pixelelCount];
+			unsigned char value = static_cast<unsigned char>(((x * 7 + y * 13) * 31 + (x * y) % 17) % 200);
+			gboolean isTarget = FALSE;
+
+			for (i = 0; i < holeCount; i++)
+				if (x >= holes[i].x && x < holes[i].x + holes[i].width && y >= holes[i].y && y < holes[i].y + holes[i].height)
+					isTarget = TRUE;
+			if (isTarget && isMagenta)
+			{
+				pixel[0] = 255;
+				pixel[1] = 0;
+				pixel[2] = 255;
+			}
+			else
+			{
+				pixel[0] = value;
+				pixel[1] = isColor ? static_cast<unsigned char>(value / 2) : value;
+				pixel[2] = isColor ? static_cast<unsigned char>(255 - value) : value;
+			}
+			if (pixelelCount == 4)
+				pixel[3] = 0xFF;
+			mask[y * width + x] = isTarget ? 0xFF : 0;
+		}
+}
+
+
+/**
+ * \brief Test statistics and energy termination on a larger, generated image
+ *
+ * A 32x32 RGB noisy checkerboard of 4x4 squares, healing an 8x8 hole in the center.
+ * Expect consistent counts.
+ * The energy of the target per matched neighbor can rise, since a new source changes the patches of its neighbors.
+ * With energyTerminateFraction set, expect termination by energy (2) only after a pass that decreased it
+ * by less than the fraction, and not sooner.
+ */
+static void testStats(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 32;
+	unsigned char image[size * size * 3];
+	unsigned char mask[size * size];
+	unsigned int x;
+	unsigned int y;
+	unsigned int pass;
+	double priorEnergy = 0;
+	int isEnergyTermination = 1;  // terminated by energy at, and only at, the first small decrease
+	int cancelFlag = 0;
+
+	for (y = 0; y < size; y++)
+		for (x = 0; x < size; x++)
+		{
+			// Pseudo random noise, so matches are not perfect
+			unsigned char value = ((((x / 4) + (y / 4)) % 2) ? 200 : 50) + ((x * 7 + y * 13) * 31) % 23;
+			image[(y * size + x) * 3] = value;
+			image[(y * size + x) * 3 + 1] = value;
+			image[(y * size + x) * 3 + 2] = value;
+			mask[y * size + x] = (x >= 12 && x < 20 && y >= 12 && y < 20) ? 0xFF : 0;
+		}
+
+	ImageBuffer testImage = { (unsigned char*)&image, size, size, size * 3 };
+	ImageBuffer testMask = { (unsigned char*)&mask, size, size, size };
+
+	TImageSynthStats stats;
+	TImageSynthExtras extras = {};
+	extras.stats = &stats;
+
+	printf("\nTest stats, energy termination fraction %f\n", parameters->energyTerminateFraction);
+	int error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+		return;
+	}
+
+	for (pass = 0; pass < stats.passCount; pass++)
+	{
+		const TImageSynthPassStats* passStats = &stats.passes[pass];
+		unsigned long long earlyOuts = 0;
+		unsigned int i;
+		double energy = passStats->targetNeighbors ? (double)passStats->targetEnergy / passStats->targetNeighbors : 0.0;
+		int isSmallDecrease = pass >= 2 && energy <= priorEnergy
+			&& (priorEnergy <= 0 || (priorEnergy - energy) / priorEnergy < parameters->energyTerminateFraction);
+
+		for (i = 0; i < IMAGE_SYNTH_MAX_NEIGHBORS; i++)
+			earlyOuts += passStats->earlyOuts[i];
+		printf("Pass %u targets %u betters %u mean energy %f target energy per neighbor %f\n", pass,
+			passStats->targetCount, passStats->betters,
+			passStats->targetCount ? (double)passStats->energy / passStats->targetCount : 0.0,
+			energy);
+		printf("  by neighbors source %u by random %u perfect %u probes %llu early outs %llu\n",
+			passStats->bettersByNeighborsSource, passStats->bettersByRandom, passStats->perfectMatches,
+			passStats->probes, passStats->earlyOutCount);
+		// Expect: betters split by kind, and early outs by neighbor sum to their count
+		if (passStats->bettersByNeighborsSource + passStats->bettersByRandom != passStats->betters
+			|| earlyOuts != passStats->earlyOutCount || earlyOuts > passStats->probes)
+			printf("Error: inconsistent stats of pass %u\n", pass);
+		if (pass + 1 == stats.passCount && stats.termination == IMAGE_SYNTH_TERMINATION_ENERGY)
+			isEnergyTermination &= isSmallDecrease;
+		else if (parameters->energyTerminateFraction > 0)
+			isEnergyTermination &= !isSmallDecrease;
+		priorEnergy = energy;
+	}
+	printf("Termination %d prepare milliseconds %f\n", stats.termination, stats.prepareMilliseconds);
+	printf("Expected: energy termination on a small decrease 1\n");
+	printf("Result: energy termination on a small decrease %d\n", isEnergyTermination);
+}
+
+
+/* Counts of spans of a trace, by kind. */
+typedef struct {
+	unsigned int preparations;
+	unsigned int passes;
+	unsigned int slices;
+	unsigned int negative;  // spans starting before the engine, or of negative duration
+} TTraceCounts;
+
+
+static void countTraceSpan(const TImageSynthTraceSpan* span, void* traceContext)
+{
+	TTraceCounts* counts = (TTraceCounts*)traceContext;
+
+	if (span->pass < 0)
+		counts->preparations++;
+	else if (strcmp(span->name, "pass") == 0)
+		counts->passes++;
+	else
+		counts->slices++;
+	if (span->startMicroseconds < 0 || span->durationMicroseconds < 0)
+		counts->negative++;
+}
+
+
+/**
+ * \brief Test the trace of phases, by callback and to a file
+ *
+ * A 32x32 gray noisy image, healing an 8x8 hole.
+ * Expect a span for each of six preparations, and a span per pass with at least one thread slice per pass.
+ */
+static void testTrace(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 32;
+	const TImageSynthMaskBounds hole = { 12, 12, 8, 8 };
+	unsigned char image[size * size * 3];
+	unsigned char mask[size * size];
+	int cancelFlag = 0;
+	const char* filePath = "testTrace.json";
+
+	fillNoisyImage(image, mask, size, size, 3, FALSE, &hole, 1, FALSE);
+
+	ImageBuffer testImage = { (unsigned char*)&image, size, size, size * 3 };
+	ImageBuffer testMask = { (unsigned char*)&mask, size, size, size };
+
+	TImageSynthStats stats;
+	TTraceCounts counts = {};
+	TImageSynthExtras extras = {};
+	extras.stats = &stats;
+	extras.traceCallback = countTraceSpan;
+	extras.traceContext = &counts;
+	extras.traceFilePath = filePath;
+
+	printf("\nTest trace\n");
+	remove(filePath);
+	int error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+		return;
+	}
+
+	char head[32] = "";
+	FILE* file = fopen(filePath, "r");
+	if (file)
+	{
+		if (!fgets(head, sizeof(head), file)) head[0] = 0;
+		fclose(file);
+		remove(filePath);
+	}
+	printf("Expected: preparations 6 passes %u slices >= passes, none negative, file {\"displayTimeUnit\"\n", stats.passCount);
+	printf("Result: preparations %u passes %u slices %u, negative %u, file %.18s\n",
+		counts.preparations, counts.passes, counts.slices, counts.negative, head);
+}
+
+
+/* FNV-1a hash of a buffer, to compare results. */
+static unsigned long long hashBytes(const unsigned char* bytes, size_t count)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+
+/**
+ * \brief Test deterministic synthesis: repeated runs give identical results
+ *
+ * A 96x96 gray noisy image, healing a 40x40 hole, three times, the last with another seed.
+ * Expect the first two results identical, and the third different.
+ */
+static void testDeterministic(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 96;
+	const TImageSynthMaskBounds hole = { 28, 28, 40, 40 };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	unsigned long long hashes[3];
+	unsigned int run;
+	int cancelFlag = 0;
+
+	parameters->isDeterministic = TRUE;
+	printf("\nTest deterministic\n");
+	for (run = 0; run < 3; run++)
+	{
+		fillNoisyImage(image, mask, size, size, 3, TRUE, &hole, 1, FALSE);
+
+		ImageBuffer testImage = { image, size, size, size * 3 };
+		ImageBuffer testMask = { mask, size, size, size };
+
+		if (run == 2) parameters->seed += 1;
+		int error = imageSynth(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag);
+		if (error)
+			printf("Error: ImageSynth returned error: %d\n", error);
+		hashes[run] = hashBytes(image, size * size * 3);
+	}
+	parameters->seed -= 1;
+	parameters->isDeterministic = FALSE;
+
+	printf("Expected: repeated identical 1, other seed identical 0\n");
+	printf("Result: repeated identical %d, other seed identical %d\n", hashes[0] == hashes[1], hashes[0] == hashes[2]);
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test the cache of results
+ *
+ * The image of testDeterministic, healed deterministically twice through a cache, then not deterministically.
+ * Expect a miss then a hit with the same result, then a miss since not repeatable.
+ */
+static void testCache(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 96;
+	const TImageSynthMaskBounds hole = { 28, 28, 40, 40 };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	unsigned long long hashes[3];
+	int hits[3];
+	unsigned int run;
+	int cancelFlag = 0;
+	TImageSynthCache* cache = newImageSynthCache(1 << 20, NULL);
+
+	printf("\nTest cache\n");
+	for (run = 0; run < 3; run++)
+	{
+		fillNoisyImage(image, mask, size, size, 3, TRUE, &hole, 1, FALSE);
+
+		ImageBuffer testImage = { image, size, size, size * 3 };
+		ImageBuffer testMask = { mask, size, size, size };
+
+		parameters->isDeterministic = (run < 2);
+		int error = imageSynthCached(cache, &testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &hits[run]);
+		if (error)
+			printf("Error: ImageSynth returned error: %d\n", error);
+		hashes[run] = hashBytes(image, size * size * 3);
+	}
+	parameters->isDeterministic = FALSE;
+	freeImageSynthCache(cache);
+
+	printf("Expected: hits 0 1 0, identical 1\n");
+	printf("Result: hits %d %d %d, identical %d\n", hits[0], hits[1], hits[2], hashes[0] == hashes[1]);
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test applying a correspondence to a master of higher resolution and bit depth
+ *
+ * The image of testCorrespondence is the proxy, healed exporting the correspondence.
+ * The master is the proxy at twice the resolution and 16 bits per channel.
+ * Expect the master, rendered through the correspondence, to be the result of the proxy, scaled.
+ */
+static void testApplyCorrespondence(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 48;
+	const TImageSynthMaskBounds hole = { 16, 16, 16, 16 };
+	const unsigned int scale = 2;
+	const unsigned int masterSize = size * scale;
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	uint16_t* master = new uint16_t[masterSize * masterSize * 3];
+	int32_t* sourceIndices = new int32_t[size * size];
+	unsigned int x;
+	unsigned int y;
+	unsigned int c;
+	unsigned int mismatches = 0;
+	int cancelFlag = 0;
+
+	fillNoisyImage(image, mask, size, size, 3, TRUE, &hole, 1, FALSE);
+	for (y = 0; y < masterSize; y++)
+		for (x = 0; x < masterSize; x++)
+			for (c = 0; c < 3; c++)
+				master[(y * masterSize + x) * 3 + c] = static_cast<uint16_t>(image[((y / scale) * size + x / scale) * 3 + c] * 257);
+
+	ImageBuffer testImage = { image, size, size, size * 3 };
+	ImageBuffer testMask = { mask, size, size, size };
+	ImageBuffer masterImage = { reinterpret_cast<unsigned char*>(master), masterSize, masterSize, masterSize * 3 * sizeof(uint16_t) };
+
+	TImageSynthExtras extras = {};
+	extras.sourceIndices = sourceIndices;
+
+	printf("\nTest apply correspondence\n");
+	int error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	if (!error)
+		error = imageSynthApplyCorrespondence(sourceIndices, size, size, size, scale, &masterImage, &masterImage, 3 * sizeof(uint16_t));
+	if (error)
+	{
+		printf("Error: returned error: %d\n", error);
+	}
+	else
+	{
+		for (y = 0; y < masterSize; y++)
+			for (x = 0; x < masterSize; x++)
+				for (c = 0; c < 3; c++)
+					if (master[(y * masterSize + x) * 3 + c] != image[((y / scale) * size + x / scale) * 3 + c] * 257)
+						mismatches++;
+		printf("Expected: mismatches 0, mismatched dimensions error %d\n", IMAGE_SYNTH_ERROR_CORRESPONDENCE_MISMATCH);
+		printf("Result: mismatches %u, mismatched dimensions error %d\n", mismatches,
+			imageSynthApplyCorrespondence(sourceIndices, size, size, size, 3, &masterImage, &masterImage, 3 * sizeof(uint16_t)));
+	}
+	delete[] image;
+	delete[] mask;
+	delete[] master;
+	delete[] sourceIndices;
+}
+
+
+static int isInBounds(const TImageSynthMaskBounds* bounds, unsigned int x, unsigned int y)
+{
+	return x >= bounds->x && x < bounds->x + bounds->width && y >= bounds->y && y < bounds->y + bounds->height;
+}
+
+
+/*
+Whether a pixel is within radius (the engine's, see affectedRadius in TImageSynthStats) of a change by the edit
+of testIncremental: a pixel of the edit, or a target pixel whose prior source the edit covered.
+So it may be resynthesized.
+Within a square: the engine's chamfer distance is never less than the distance along an axis.
+*/
+static int isNearEdit(const int32_t* priorSourceIndices, unsigned int size, const TImageSynthMaskBounds* edit,
+	unsigned int radius, unsigned int x, unsigned int y)
+{
+	int dx;
+	int dy;
+
+	for (dy = -(int)radius; dy <= (int)radius; dy++)
+		for (dx = -(int)radius; dx <= (int)radius; dx++)
+		{
+			int nearX = static_cast<int>(x) + dx;
+			int nearY = static_cast<int>(y) + dy;
+			int32_t source;
+
+			if (nearX < 0 || nearY < 0 || nearX >= (int)size || nearY >= (int)size)
+				continue;
+			source = priorSourceIndices[nearY * size + nearX];
+			if (isInBounds(edit, nearX, nearY) || (source >= 0 && isInBounds(edit, source % size, source / size)))
+				return 1;
+		}
+	return 0;
+}
+
+
+/**
+ * \brief Test incremental resynthesis after an edit of the mask
+ *
+ * A 64x64 gray noisy image, healing a 20x20 hole painted magenta, exporting the correspondence.
+ * Then the mask is edited, adding an 8x8 hole adjoining it on the right, and the result healed again from the prior correspondence.
+ * Expect some target pixels kept, every pixel unchanged except near the edit or near pixels whose source the edit covered,
+ * and no magenta left.
+ */
+static void testIncremental(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 64;
+	const TImageSynthMaskBounds hole = { 12, 12, 20, 20 };
+	const TImageSynthMaskBounds edit = { hole.x + hole.width, hole.y + hole.height / 2 - 2, 8, 8 };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* firstImage = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	int32_t* sourceIndices = new int32_t[size * size];
+	int32_t* priorSourceIndices = new int32_t[size * size];
+	unsigned int x;
+	unsigned int y;
+	unsigned int unfilled = 0;
+	unsigned int changed = 0;
+	int cancelFlag = 0;
+
+	fillNoisyImage(image, mask, size, size, 3, FALSE, &hole, 1, TRUE);
+
+	ImageBuffer testImage = { image, size, size, size * 3 };
+	ImageBuffer testMask = { mask, size, size, size };
+
+	TImageSynthStats stats;
+	TImageSynthExtras extras = {};
+	extras.stats = &stats;
+	extras.sourceIndices = sourceIndices;
+
+	printf("\nTest incremental\n");
+	int error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	if (!error)
+	{
+		memcpy(firstImage, image, size * size * 3);
+		memcpy(priorSourceIndices, sourceIndices, size * size * sizeof(int32_t));
+
+		// The edit
+		for (y = edit.y; y < edit.y + edit.height; y++)
+			for (x = edit.x; x < edit.x + edit.width; x++)
+			{
+				unsigned char* pixel = &image[(y * size + x) * 3];
+				pixel[0] = 255;
+				pixel[1] = 0;
+				pixel[2] = 255;
+				mask[y * size + x] = 0xFF;
+			}
+		extras.priorSourceIndices = priorSourceIndices;
+		extras.blendBand = 2;
+		error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	}
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+	}
+	else
+	{
+		for (y = 0; y < size; y++)
+			for (x = 0; x < size; x++)
+			{
+				unsigned char* pixel = &image[(y * size + x) * 3];
+				if (pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 255)
+					unfilled++;
+				if (!isNearEdit(priorSourceIndices, size, &edit, stats.affectedRadius, x, y)
+					&& memcmp(pixel, &firstImage[(y * size + x) * 3], 3))
+					changed++;
+			}
+		printf("Expected: kept some 1, unaffected changed 0, unfilled 0\n");
+		printf("Result: kept some %d, unaffected changed %u, unfilled %u, affected radius %u\n",
+			stats.keptCount > 0 && stats.keptCount < hole.width * hole.height, changed, unfilled, stats.affectedRadius);
+	}
+	delete[] image;
+	delete[] firstImage;
+	delete[] mask;
+	delete[] sourceIndices;
+	delete[] priorSourceIndices;
+}
+
+
+/**
+ * \brief Test export of the correspondence
+ *
+ * A 48x48 color noisy image, healing a 16x16 hole, exporting both forms of the correspondence.
+ * Expect the forms to agree, -1 outside the target,
+ * and gathering the original image through the correspondence to give the result.
+ */
+static void testCorrespondence(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 48;
+	const TImageSynthMaskBounds hole = { 16, 16, 16, 16 };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* original = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	int32_t* sourceIndices = new int32_t[size * size];
+	int32_t* sourceCoordinates = new int32_t[size * size * 2];
+	unsigned int x;
+	unsigned int y;
+	int isConsistent = 1;
+	int isGathered = 1;
+	int cancelFlag = 0;
+
+	fillNoisyImage(image, mask, size, size, 3, TRUE, &hole, 1, FALSE);
+	memcpy(original, image, size * size * 3);
+
+	ImageBuffer testImage = { image, size, size, size * 3 };
+	ImageBuffer testMask = { mask, size, size, size };
+
+	TImageSynthExtras extras = {};
+	extras.sourceIndices = sourceIndices;
+	extras.sourceCoordinates = sourceCoordinates;
+
+	printf("\nTest correspondence\n");
+	int error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+	}
+	else
+	{
+		for (y = 0; y < size; y++)
+			for (x = 0; x < size; x++)
+			{
+				unsigned int i = y * size + x;
+				int32_t sourceX = sourceCoordinates[2 * i];
+				int32_t sourceY = sourceCoordinates[2 * i + 1];
+
+				if (!mask[i])
+				{
+					if (sourceIndices[i] != -1 || sourceX != -1 || sourceY != -1)
+						isConsistent = 0;
+				}
+				else if (sourceX < 0 || sourceIndices[i] != sourceY * (int32_t)size + sourceX)
+					isConsistent = 0;
+				else if (memcmp(&image[i * 3], &original[sourceIndices[i] * 3], 3))
+					isGathered = 0;
+			}
+		printf("Expected: consistent 1, gathered 1\n");
+		printf("Result: consistent %d, gathered %d\n", isConsistent, isGathered);
+	}
+	delete[] image;
+	delete[] original;
+	delete[] mask;
+	delete[] sourceIndices;
+	delete[] sourceCoordinates;
+}
+
+
+typedef struct previewCountsStruct {
+	unsigned int count;
+	unsigned int firstPass;
+	unsigned int firstUnfilled;     // magenta pixels in the first preview
+	int isChangedInTarget;          // every preview's changed bounds lie in the target
+} TPreviewCounts;
+
+
+static void countPreview(const TImageSynthPreview* preview, void* context)
+{
+	TPreviewCounts* counts = static_cast<TPreviewCounts*>(context);
+	unsigned int i;
+
+	if (counts->count == 0)
+	{
+		counts->firstPass = preview->pass;
+		for (i = 0; i < preview->width * preview->height; i++)
+		{
+			const unsigned char* color = &preview->pixels[i * preview->bytesPerPixel + preview->colorStart];
+			if (color[0] == 255 && color[1] == 0 && color[2] == 255)
+				counts->firstUnfilled++;
+		}
+	}
+	if (preview->isAnyChanged
+		&& (preview->changedLeft < 16 || preview->changedRight >= 48 || preview->changedTop < 16 || preview->changedBottom >= 48))
+		counts->isChangedInTarget = 0;
+	counts->count++;
+}
+
+
+/**
+ * \brief Test progressive previews
+ *
+ * A 64x64 gray noisy image, healing a 32x32 hole painted magenta, previewing after every pass.
+ * Expect a preview per pass, the first after the first pass with the hole filled,
+ * and changes only within the hole.
+ */
+static void testPreview(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 64;
+	const TImageSynthMaskBounds hole = { 16, 16, 32, 32 };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	int cancelFlag = 0;
+	TPreviewCounts counts = { 0, 0, 0, 1 };
+
+	fillNoisyImage(image, mask, size, size, 3, FALSE, &hole, 1, TRUE);
+
+	ImageBuffer testImage = { image, size, size, size * 3 };
+	ImageBuffer testMask = { mask, size, size, size };
+
+	TImageSynthStats stats;
+	TImageSynthExtras extras = {};
+	extras.stats = &stats;
+	extras.previewCallback = countPreview;
+	extras.previewContext = &counts;
+
+	printf("\nTest preview\n");
+	int error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+	}
+	else
+	{
+		printf("Expected: previews per pass 1, first pass 0, first unfilled 0, changed in target 1\n");
+		printf("Result: previews per pass %d, first pass %u, first unfilled %u, changed in target %d\n",
+			counts.count == stats.passCount, counts.firstPass, counts.firstUnfilled, counts.isChangedInTarget);
+	}
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test anytime synthesis: a tight time budget still fills the whole target
+ *
+ * A 256x256 gray noisy image, healing a 128x128 hole painted magenta (a color not in the corpus.)
+ * Expect no magenta left, even if the budget is spent during the first pass,
+ * and the engine to return within the budget plus the overrun documented for parameter maxMilliseconds:
+ * preparations, a microsecond per target pixel for the fill without search,
+ * and a few milliseconds for the searches in progress and the threads to rejoin.
+ */
+static void testAnytime(TImageSynthParameters* parameters, unsigned int maxMilliseconds)
+{
+	const unsigned int size = 256;
+	const TImageSynthMaskBounds hole = { 64, 64, 128, 128 };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	unsigned int x;
+	unsigned int y;
+	unsigned int unfilled = 0;
+	int cancelFlag = 0;
+	const double overrunMilliseconds = hole.width * hole.height / 1000.0 + 5;
+
+	fillNoisyImage(image, mask, size, size, 3, FALSE, &hole, 1, TRUE);
+
+	ImageBuffer testImage = { image, size, size, size * 3 };
+	ImageBuffer testMask = { mask, size, size, size };
+
+	TImageSynthStats stats;
+	TImageSynthExtras extras = {};
+	extras.stats = &stats;
+	parameters->maxMilliseconds = maxMilliseconds;
+
+	printf("\nTest anytime, budget %u milliseconds\n", maxMilliseconds);
+	int error = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+	parameters->maxMilliseconds = 0;
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+	}
+	else
+	{
+		for (y = 0; y < size; y++)
+			for (x = 0; x < size; x++)
+			{
+				unsigned char* pixel = &image[(y * size + x) * 3];
+				if (pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 255)
+					unfilled++;
+			}
+		printf("Expected: unfilled 0, within budget 1\n");
+		printf("Result: unfilled %u, within budget %d, passes %u, termination %d, milliseconds %f, prepare milliseconds %f\n",
+			unfilled, stats.milliseconds <= maxMilliseconds + stats.prepareMilliseconds + overrunMilliseconds,
+			stats.passCount, stats.termination, stats.milliseconds, stats.prepareMilliseconds);
+	}
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test brushfire orders of the target fill a non-convex target
+ *
+ * A 64x64 gray noisy image, healing an L shaped hole painted magenta,
+ * or (isUncrop) a 16 pixel band around the border.
+ * Expect no magenta left.
+ */
+static void testBrushfire(TImageSynthParameters* parameters, int matchContextType, gboolean isUncrop)
+{
+	const unsigned int size = 64;
+	const TImageSynthMaskBounds lHoles[] = { { 16, 16, 32, 12 }, { 16, 16, 12, 32 } };
+	const TImageSynthMaskBounds borderHoles[] = { { 0, 0, 64, 16 }, { 0, 48, 64, 16 }, { 0, 16, 16, 32 }, { 48, 16, 16, 32 } };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	unsigned int x;
+	unsigned int y;
+	unsigned int unfilled = 0;
+	int cancelFlag = 0;
+
+	if (isUncrop)
+		fillNoisyImage(image, mask, size, size, 3, FALSE, borderHoles, 4, TRUE);
+	else
+		fillNoisyImage(image, mask, size, size, 3, FALSE, lHoles, 2, TRUE);
+
+	ImageBuffer testImage = { image, size, size, size * 3 };
+	ImageBuffer testMask = { mask, size, size, size };
+
+	int priorMatchContextType = parameters->matchContextType;
+	parameters->matchContextType = matchContextType;
+	printf("\nTest brushfire, match context type %d, %s\n", matchContextType, isUncrop ? "uncrop" : "L shaped hole");
+	int error = imageSynth(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag);
+	parameters->matchContextType = priorMatchContextType;
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+	}
+	else
+	{
+		for (y = 0; y < size; y++)
+			for (x = 0; x < size; x++)
+			{
+				unsigned char* pixel = &image[(y * size + x) * 3];
+				if (pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 255)
+					unfilled++;
+			}
+		printf("Expected: unfilled 0\n");
+		printf("Result: unfilled %u\n", unfilled);
+	}
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test a metric of patch difference
+ *
+ * A 64x64 color noisy image, healing a 16x16 hole painted magenta.
+ * Expect no magenta left, and an invalid metric to be an error.
+ */
+static void testMetric(TImageSynthParameters* parameters, int matchMetric)
+{
+	const unsigned int size = 64;
+	const TImageSynthMaskBounds hole = { 24, 24, 16, 16 };
+	unsigned char* image = new unsigned char[size * size * 3];
+	unsigned char* mask = new unsigned char[size * size];
+	unsigned int x;
+	unsigned int y;
+	unsigned int unfilled = 0;
+	int cancelFlag = 0;
+
+	fillNoisyImage(image, mask, size, size, 3, TRUE, &hole, 1, TRUE);
+
+	ImageBuffer testImage = { image, size, size, size * 3 };
+	ImageBuffer testMask = { mask, size, size, size };
+
+	printf("\nTest metric %d\n", matchMetric);
+	parameters->matchMetric = IMAGE_SYNTH_METRIC_COUNT;
+	int invalidError = imageSynth(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag);
+	parameters->matchMetric = matchMetric;
+	int error = imageSynth(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag);
+	parameters->matchMetric = IMAGE_SYNTH_METRIC_CAUCHY;
+	if (error)
+	{
+		printf("Error: ImageSynth returned error: %d\n", error);
+	}
+	else
+	{
+		for (y = 0; y < size; y++)
+			for (x = 0; x < size; x++)
+			{
+				unsigned char* pixel = &image[(y * size + x) * 3];
+				if (pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 255)
+					unfilled++;
+			}
+		printf("Expected: unfilled 0, invalid metric error %d\n", IMAGE_SYNTH_ERROR_MATCH_METRIC_RANGE);
+		printf("Result: unfilled %u, invalid metric error %d\n", unfilled, invalidError);
+	}
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test matching from a tiled copy of the corpus
+ *
+ * A 100x70 color noisy image (not whole tiles), healing a 30x20 hole, deterministically,
+ * matching from the corpus pixmap, then from tiles.
+ * Expect identical results.
+ */
+static void testCorpusTiles(TImageSynthParameters* parameters)
+{
+	const unsigned int width = 100;
+	const unsigned int height = 70;
+	const TImageSynthMaskBounds hole = { 60, 40, 30, 20 };
+	unsigned char* image = new unsigned char[width * height * 3];
+	unsigned char* mask = new unsigned char[width * height];
+	unsigned long long hashes[2];
+	unsigned int run;
+	int cancelFlag = 0;
+	int error = 0;
+
+	printf("\nTest corpus tiles\n");
+	parameters->isDeterministic = TRUE;
+	for (run = 0; run < 2; run++)
+	{
+		fillNoisyImage(image, mask, width, height, 3, TRUE, &hole, 1, FALSE);
+
+		ImageBuffer testImage = { image, width, height, width * 3 };
+		ImageBuffer testMask = { mask, width, height, width };
+
+		parameters->isCorpusTiled = (run == 1);
+		error |= imageSynth(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag);
+		hashes[run] = hashBytes(image, width * height * 3);
+	}
+	parameters->isCorpusTiled = FALSE;
+	parameters->isDeterministic = FALSE;
+
+	if (error)
+		printf("Error: ImageSynth returned error: %d\n", error);
+	printf("Expected: identical 1\n");
+	printf("Result: identical %d\n", hashes[0] == hashes[1]);
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test an arena passed to consecutive runs
+ *
+ * A deterministic heal, without an arena, then twice with the same arena.
+ * Expect identical results, and the second run to reuse the memory of the first, not grow it.
+ */
+static void testArena(TImageSynthParameters* parameters)
+{
+	const unsigned int width = 100;
+	const unsigned int height = 70;
+	const TImageSynthMaskBounds hole = { 20, 20, 30, 25 };
+	unsigned char* image = new unsigned char[width * height * 3];
+	unsigned char* mask = new unsigned char[width * height];
+	unsigned long long hashes[3];
+	size_t capacities[3];
+	unsigned int run;
+	int cancelFlag = 0;
+	int error = 0;
+	TImageSynthArena* arena = newImageSynthArena(1);
+
+	printf("\nTest arena\n");
+	parameters->isDeterministic = TRUE;
+	for (run = 0; run < 3; run++)
+	{
+		TImageSynthExtras extras = {};
+		extras.arena = (run == 0) ? NULL : arena;
+
+		fillNoisyImage(image, mask, width, height, 3, TRUE, &hole, 1, FALSE);
+
+		ImageBuffer testImage = { image, width, height, width * 3 };
+		ImageBuffer testMask = { mask, width, height, width };
+
+		error |= imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+		hashes[run] = hashBytes(image, width * height * 3);
+		capacities[run] = imageSynthArenaCapacity(arena);
+	}
+	parameters->isDeterministic = FALSE;
+
+	if (error)
+		printf("Error: ImageSynth returned error: %d\n", error);
+	printf("Expected: identical 1, reused 1\n");
+	printf("Result: identical %d, reused %d\n", hashes[0] == hashes[1] && hashes[1] == hashes[2],
+		capacities[0] == 0 && capacities[1] > 0 && capacities[2] == capacities[1]);
+	freeImageSynthArena(arena);
+	delete[] image;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test preparations in bands, on an image large enough for several bands
+ *
+ * A 640x480 RGBA noisy image, healing magenta holes, one across the boundary of bands,
+ * beside a strip of totally transparent gray, which is neither context nor corpus.
+ * Expect no magenta left, no gray in the holes, and the context unchanged.
+ */
+static void testBands(TImageSynthParameters* parameters)
+{
+	const unsigned int width = 640;
+	const unsigned int height = 480;
+	const TImageSynthMaskBounds holes[] = {
+		{ 100, 114, 12, 12 },  // Across rows 120, a boundary of 4 bands
+		{ 280, 300, 16, 16 },
+		{ 600, 470, 10, 10 } };
+	unsigned char* image = new unsigned char[width * height * 4];
+	unsigned char* before = new unsigned char[width * height * 4];
+	unsigned char* mask = new unsigned char[width * height];
+	unsigned int x;
+	unsigned int y;
+	unsigned int unfilled = 0;
+	unsigned int transparent = 0;
+	int isContextUnchanged = 1;
+	int cancelFlag = 0;
+
+	fillNoisyImage(image, mask, width, height, 4, TRUE, holes, 3, TRUE);
+	// The transparent strip, beside but not overlapping the holes
+	for (y = 0; y < height; y++)
+		for (x = 300; x < 340; x++)
+		{
+			memset(&image[(y * width + x) * 4], 0x11, 3);
+			image[(y * width + x) * 4 + 3] = 0;
+		}
+	memcpy(before, image, width * height * 4);
+
+	ImageBuffer testImage = { image, width, height, width * 4 };
+	ImageBuffer testMask = { mask, width, height, width };
+
+	printf("\nTest bands\n");
+	int error = imageSynth(&testImage, &testMask, T_RGBA, parameters, progressCallback, (void*)0, &cancelFlag);
+	if (error)
+		printf("Error: ImageSynth returned error: %d\n", error);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+		{
+			const unsigned char* pixel = &image[(y * width + x) * 4];
+			if (mask[y * width + x])
+			{
+				unfilled += (pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 255);
+				transparent += (pixel[0] == 0x11 && pixel[1] == 0x11 && pixel[2] == 0x11);
+			}
+			else if (memcmp(pixel, &before[(y * width + x) * 4], 4) != 0)
+				isContextUnchanged = 0;
+		}
+	printf("Expected: unfilled 0, transparent sources 0, context unchanged 1\n");
+	printf("Result: unfilled %u, transparent sources %u, context unchanged %d\n", unfilled, transparent, isContextUnchanged);
+	delete[] image;
+	delete[] before;
+	delete[] mask;
+}
+
+
+/**
+ * \brief Test the memory estimate and the budget maxMemoryBytes
+ *
+ * A 320x240 RGB image with a hole.
+ * Expect the run within the estimate for the hole's bounds,
+ * under half the estimate a radius of offsets and no hole left, and under 1 MiB the error.
+ */
+static void testMemory(TImageSynthParameters* parameters)
+{
+	const unsigned int width = 320;
+	const unsigned int height = 240;
+	const TImageSynthMaskBounds bounds = { 100, 100, 40, 30 };
+	unsigned char* image = new unsigned char[width * height * 3];
+	unsigned char* mask = new unsigned char[width * height];
+	size_t estimate = 0;
+	size_t capacity;
+	unsigned int run;
+	unsigned int unfilled = 0;
+	int isWithin = 0;
+	int isRadius = 0;
+	int limitError = 0;
+	int cancelFlag = 0;
+	int error;
+	TImageSynthArena* arena = newImageSynthArena(1);
+
+	printf("\nTest memory\n");
+	error = imageSynthEstimateMemory(width, height, T_RGB, &bounds, parameters, &estimate);
+	for (run = 0; run < 3; run++)
+	{
+		unsigned int x;
+		unsigned int y;
+		TImageSynthStats stats;
+		TImageSynthExtras extras = {};
+		extras.stats = &stats;
+		extras.arena = arena;
+
+		fillNoisyImage(image, mask, width, height, 3, TRUE, &bounds, 1, TRUE);
+
+		ImageBuffer testImage = { image, width, height, width * 3 };
+		ImageBuffer testMask = { mask, width, height, width };
+
+		// No budget, half the estimate, then too little for anything
+		parameters->maxMemoryBytes = (run == 0) ? 0 : (run == 1) ? estimate / 2 : (1 << 20);
+		int runError = imageSynthWithExtras(&testImage, &testMask, T_RGB, parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+		capacity = imageSynthArenaCapacity(arena);
+		if (run == 0)
+			isWithin = !runError && capacity <= estimate && stats.memoryBytes <= estimate;
+		else if (run == 1)
+		{
+			error |= runError;
+			isRadius = stats.offsetsRadius > 0 && capacity <= estimate;
+			for (y = bounds.y; y < bounds.y + bounds.height; y++)
+				for (x = bounds.x; x < bounds.x + bounds.width; x++)
+					unfilled += (image[(y * width + x) * 3] == 255 && image[(y * width + x) * 3 + 1] == 0);
+		}
+		else
+			limitError = runError;
+	}
+	parameters->maxMemoryBytes = 0;
+
+	if (error)
+		printf("Error: ImageSynth returned error: %d\n", error);
+	printf("Expected: within estimate 1, budget radius 1, unfilled 0, tiny budget error 9\n");
+	printf("Result: within estimate %d, budget radius %d, unfilled %u, tiny budget error %d, estimate %zu\n",
+		isWithin, isRadius, unfilled, limitError, estimate);
+	freeImageSynthArena(arena);
+	delete[] image;
+	delete[] mask;
+}
+
+
+typedef struct {
+	unsigned int bytesPerPixel;
+	int isAligned;
+} TPixelFormatView;
+
+
+static void viewPixelFormat(const TImageSynthPreview* preview, void* context)
+{
+	TPixelFormatView* view = static_cast<TPixelFormatView*>(context);
+
+	view->bytesPerPixel = preview->bytesPerPixel;
+	view->isAligned = (reinterpret_cast<size_t>(preview->pixels) % 64) == 0;
+}
+
+
+/**
+ * \brief Test the engine's internal pixel format is padded and aligned
+ *
+ * For each image format, heal a small hole, previewing to see the internal pixmap.
+ * Expect a mask pixelel plus the image's pixelels, padded to a power of two, and the pixmap aligned on a cache line.
+ */
+static void testPixelFormat(TImageSynthParameters* parameters)
+{
+	const unsigned int size = 32;
+	const TImageFormat formats[] = { T_RGB, T_RGBA, T_Gray, T_GrayA };
+	const unsigned int pixelelCounts[] = { 3, 4, 1, 2 };
+	unsigned char* image = new unsigned char[size * size * 4];
+	unsigned char* mask = new unsigned char[size * size];
+	unsigned int formatIndex;
+	int cancelFlag = 0;
+	int isAligned = 1;
+	int error = 0;
+
+	printf("\nTest pixel format\n");
+	printf("Expected: bytes per pixel 4 8 2 4, aligned 1\n");
+	printf("Result: bytes per pixel");
+	for (formatIndex = 0; formatIndex < 4; formatIndex++)
+	{
+		unsigned int pixelels = pixelelCounts[formatIndex];
+		unsigned int i;
+		TPixelFormatView view = { 0, 0 };
+		TImageSynthExtras extras = {};
+		extras.previewCallback = viewPixelFormat;
+		extras.previewContext = &view;
+
+		for (i = 0; i < size * size * pixelels; i++)
+			image[i] = static_cast<unsigned char>((i * 31) % 251);
+		for (i = 0; i < size * size; i++)
+			mask[i] = (i % size >= 8 && i % size < 24 && i / size >= 8 && i / size < 24) ? 0xFF : 0;
+
+		ImageBuffer testImage = { image, size, size, size * pixelels };
+		ImageBuffer testMask = { mask, size, size, size };
+
+		error |= imageSynthWithExtras(&testImage, &testMask, formats[formatIndex], parameters, progressCallback, (void*)0, &cancelFlag, &extras);
+		isAligned &= view.isAligned;
+		printf(" %u", view.bytesPerPixel);
+	}
+	printf(", aligned %d\n", isAligned);
+	if (error)
+		printf("Error: ImageSynth returned error: %d\n", error);
+	delete[] image;
+	delete[] mask;
+}
+
+
 // Test harness, small images
 // !!! Here Alpha FF is total opacity.  Alpha 0 is total transparency.
 int main()
@@ -205,6 +1274,36 @@ int main()
 	test("Test Gray w/o alpha", &testImageGray, &testMask2, T_Gray, 1,
 		"80  01  01", (TImageSynthParameters*)NULL);
 
+	testStats(&parameters);
+	parameters.energyTerminateFraction = 0.05;
+	testStats(&parameters);
+	parameters.energyTerminateFraction = 0;
+
+	testTrace(&parameters);
+	testDeterministic(&parameters);
+	testCache(&parameters);
+	testCorrespondence(&parameters);
+	testApplyCorrespondence(&parameters);
+	testIncremental(&parameters);
+	testPreview(&parameters);
+
+	testAnytime(&parameters, 1);
+	testAnytime(&parameters, 100);
+
+	testBrushfire(&parameters, 2, FALSE);
+	testBrushfire(&parameters, 5, FALSE);
+	testBrushfire(&parameters, 5, TRUE);
+	testBrushfire(&parameters, 8, FALSE);
+
+	testMetric(&parameters, IMAGE_SYNTH_METRIC_SAD);
+	testMetric(&parameters, IMAGE_SYNTH_METRIC_SSD);
+
+	testCorpusTiles(&parameters);
+	testPixelFormat(&parameters);
+	testArena(&parameters);
+	testBands(&parameters);
+	testMemory(&parameters);
+
     std::cout << std::endl << __FUNCTION__ << ": DONE. Press any key to exit..." << std::endl;
     std::cin.get();
 
@@ -34,6 +34,7 @@ will not use static global vars so it is reentrant.
 */
 
 #include <stdlib.h>
+#include <string.h>  // memcpy
 
 /*
 Adapt pixmap that is row padded to pixmap:
@@ -41,8 +42,9 @@ Adapt pixmap that is row padded to pixmap:
 - optionally offset color pixelels beyond 0th byte (an interleaved mask byte)
 Convert between slightly different pixmap types.
 
-!!!! This is not fully general.  Strides should be passed in.
-It just happens to work for now: when we are moving all pixels of the source.
+The destination pixel stride is the pixmap's depth, which may include pad pixelels.
+In bands of rows, in parallel (see rowBands.h.)
+!!!! This is not fully general: it just happens to work for now, when we are moving all pixels of the source.
 */
 static void adaptImage(
 	ImageBuffer * image,              // IN image: target or corpus drawable
@@ -51,13 +53,6 @@ static void adaptImage(
 	guint        pixelel_count        // IN count pixelels to move
 	)
 {
-	guint row;
-	guint col;
-	guint pixelel;
-
-	guint srcPixel;
-	guint destPixel;
-
 	/*
 	Copy SOME of the pixels from img sequence to our pixmap (optionally exclude alpha).
 	Allow for row padding in source.
@@ -68,30 +63,38 @@ static void adaptImage(
 	src: row padded: row stride greater than pixels*pixelelsperpixel
 	dest: not row padded
 	*/
-	destPixel = offset; // dest pixel index starts at offset
-	guint srcPixelStride = pixelel_count;
-	guint destPixelStride = pixelel_count + offset; // dest is offset
-
-	for (row = 0; row < image->height; row++)
-	{
-		srcPixel = row * image->rowBytes; // srcPixel index computed for START of each row
-		// dest pixel index continues at next byte
-		for (col = 0; col < image->width; col++)
+	const guint srcPixelStride = pixelel_count;
+	const guint destPixelStride = pixmap->depth; // dest is offset, and maybe padded
+
+	forEachRowBand(rowBandCount(image->width, image->height), image->height,
+		[image, pixmap, offset, pixelel_count, srcPixelStride, destPixelStride](guint /*band*/, guint startRow, guint endRow)
 		{
-			for (pixelel = 0; pixelel < pixelel_count; pixelel++)
-				// Copy one pixelel, but possibly offset in destination
-				g_array_index(
-					pixmap->data,
-					Pixelel,
-					destPixel + pixelel
-					)
-				=
-				image->data[srcPixel + pixelel];  // src data is array of uchar
-
-			srcPixel += srcPixelStride;
-			destPixel += destPixelStride;
-		}
-	}
+			guint row;
+
+			for (row = startRow; row < endRow; row++)
+			{
+				// src computed for START of each row, dest rows are contiguous
+				const guchar * __restrict src = &image->data[(size_t)row * image->rowBytes];
+				Pixelel * __restrict dest = &pixmap->data[(size_t)row * image->width * destPixelStride + offset];
+				guint col;
+				guint pixelel;
+
+				if (srcPixelStride == destPixelStride)  // e.g. a mask to a bytemap: a row is contiguous
+				{
+					memcpy(dest, src, (size_t)image->width * srcPixelStride);
+					continue;
+				}
+				for (col = 0; col < image->width; col++)
+				{
+					for (pixelel = 0; pixelel < pixelel_count; pixelel++)
+						// Copy one pixelel, but possibly offset in destination
+						dest[pixelel] = src[pixelel];  // src data is array of uchar
+
+					src += srcPixelStride;
+					dest += destPixelStride;
+				}
+			}
+		});
 }
 
 
@@ -104,7 +107,8 @@ This is used:
 - for the test harness from a GIMP plugin on Linux
 - in the final simpleAPI to write results back to the passed in ImageBuffer->data
 
-!!! This is not fully general, the strides are hard coded below.
+!!! This is not fully general: the source pixel stride is the pixmap's depth.
+Like adaptImage(), in bands of rows.
 */
 static void antiAdaptImage(
 	ImageBuffer*  imageBuffer,      // OUT image: target or corpus drawable
@@ -114,14 +118,6 @@ static void antiAdaptImage(
 		  // !!! Not size of pixel in src or dest since we omit alpha
 	)
 {
-	guint row;
-	guint col;
-	guint pixelel;
-
-	// Indexes that move by pixel strides, but might point offset inside a pixel
-	guint srcPixel;
-	guint destPixel;
-
 	/*
 	Copy ALL of the pixels from our pixmap to buffer(including alpha which is unaltered.)
 	Row pad destination.
@@ -138,31 +134,34 @@ static void antiAdaptImage(
 	The data can be unitialized, or valid image data to be overwritten here.
 	*/
 
-	srcPixel = offset;
-	// source stride is offset plus pixels moved
-	guint srcPixelStride = pixelel_count + offset;
-	guint destPixelStride = pixelel_count;
+	// source stride is the whole internal pixel: offset, pixels moved, alpha, and pad
+	const guint srcPixelStride = pixmap->depth;
+	const guint destPixelStride = pixelel_count;
 
-	for (row = 0; row < imageBuffer->height; row++)
-	{
-		destPixel = row * imageBuffer->rowBytes; // destPixel index computed for START of each row
-		// dest pixel index continues at next byte
-		for (col = 0; col < imageBuffer->width; col++)
+	forEachRowBand(rowBandCount(imageBuffer->width, imageBuffer->height), imageBuffer->height,
+		[imageBuffer, pixmap, offset, pixelel_count, srcPixelStride, destPixelStride](guint /*band*/, guint startRow, guint endRow)
 		{
-			for (pixelel = 0; pixelel < pixelel_count; pixelel++)
-				// Copy one pixelel, but offset in src
-				imageBuffer->data[destPixel + pixelel]
-				=
-				g_array_index(
-					pixmap->data,
-					Pixelel,
-					srcPixel + pixelel
-					);
-
-			srcPixel += srcPixelStride;
-			destPixel += destPixelStride;
-		}
-	}
+			guint row;
+
+			for (row = startRow; row < endRow; row++)
+			{
+				// dest computed for START of each row, src rows are contiguous
+				const Pixelel * __restrict src = &pixmap->data[(size_t)row * imageBuffer->width * srcPixelStride + offset];
+				guchar * __restrict dest = &imageBuffer->data[(size_t)row * imageBuffer->rowBytes];
+				guint col;
+				guint pixelel;
+
+				for (col = 0; col < imageBuffer->width; col++)
+				{
+					for (pixelel = 0; pixelel < pixelel_count; pixelel++)
+						// Copy one pixelel, but offset in src
+						dest[pixelel] = src[pixelel];
+
+					src += srcPixelStride;
+					dest += destPixelStride;
+				}
+			}
+		});
 }
 
 /*
@@ -224,14 +223,16 @@ void adaptImageAndMask(
 	ImageBuffer *   mask,   // IN 
 	Map *imagePixmap,       // OUT our color pixmap of drawable, w/ interleaved mask
 	Map *maskPixmap,        // OUT our selection bytemap (only one channel ie pixelel ie byte ie depth)
-	guint pixelelPerPixel    // IN pixelels in the image e.g. 4 for RGBA
+	guint pixelelPerPixel,   // IN pixelels in the image e.g. 4 for RGBA
+	guint pixelDepth         // IN pixelels in our internal pixel, total_bpp, see prepareImageFormatIndices()
 	)
 {
-	// Note our internal map includes mask pixelel so +1
+	// Note our internal map includes mask pixelel, and is padded, so pixelDepth >= pixelelPerPixel + 1
+	g_assert(pixelDepth >= pixelelPerPixel + 1);
 
 	// Both OUT pixmaps same 2D dimensions.  
 	// imagePixmap includes a mask byte.
-	new_pixmap(imagePixmap, image->width, image->height, pixelelPerPixel + 1);
+	new_pixmap(imagePixmap, image->width, image->height, pixelDepth);
 
 	// Get color, alpha channels.  Offset them past mask byte. 4 bytes of RGBA.
 	adaptImage(image, imagePixmap, FIRST_PIXELEL_INDEX, pixelelPerPixel);
@@ -258,7 +259,8 @@ void adaptSimpleAPI(
 	ImageBuffer * maskBuffer,
 	Map * targetMap,
 	Map * corpusMap,
-	guint pixelelPerPixel // In imageBuffer
+	guint pixelelPerPixel, // In imageBuffer
+	guint pixelDepth       // In our internal pixel
 	)
 {
 	// Assert image and mask are same size, not need to initialize empty mask with a value
@@ -271,7 +273,8 @@ void adaptSimpleAPI(
 		maskBuffer,
 		targetMap,
 		&targetMaskMap,
-		pixelelPerPixel
+		pixelelPerPixel,
+		pixelDepth
 		);
 
 	// For performance (cache memory locality), interleave mask into pixmap.
@@ -287,7 +290,8 @@ void adaptSimpleAPI(
 		maskBuffer,
 		corpusMap,
 		&corpusMaskMap,
-		pixelelPerPixel
+		pixelelPerPixel,
+		pixelDepth
 		);
 
 	// !!!! 
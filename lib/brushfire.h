@@ -1,22 +1,19 @@
 /*
 Order target points for (thinning) brushfire order of synthesis.
-Order by proportional distance from center to edge along rays.
+Order by distance from the context, i.e. from the pixels surrounding the target that have values.
 
 Ordering by distance from center makes synthesis proceed circularly.
 This ordering proceeds as a brushfire, uniformly from or toward edges.
 
-Formerly this was spread out in orderTarget.h and engineTypes.h.
-See also changes there.
-
-This change was made to eliminate the static variable max_cartesian_along_ray,
-which caused a bug during threaded execution.
-
-It is complicated by the fact that qsort compare funcs only take two parameters.
-So we create a struct having thing to be sorted (a target point coordinate)
-and having the associated value to be sorted by (proportional distance),
-and pass that to the compare func which sorts on the latter.
-
+Formerly this ordered by the proportional distance from the center of the target's bounds to its edge,
+along 401 rays, sorted with qsort.
+That is only a brushfire for convex targets centered on their bounds.
+Here the distance is a true distance transform, so non-convex targets (e.g. an L shaped hole)
+and targets with context on several sides (e.g. a donut) burn from every edge.
 
+The distance transform is a two pass chamfer (3-4) transform, linear in the size of the target's bounds.
+The sort is a radix sort on the integer distance (see sortPoints.h), also linear, and stable,
+so target points at equal distance stay in row major order, and the ordering is deterministic.
 
   Copyright (C) 2010, 2011  Lloyd Konneker
 
@@ -38,91 +35,167 @@ and pass that to the compare func which sorts on the latter.
 #ifndef RESYNTH_BRUSHFIRE_H_
 #define RESYNTH_BRUSHFIRE_H_
 
+#include <vector>
+#include "sortPoints.h"
+
+// Chamfer weights approximating 3 times the Euclidean distance to orthogonal and diagonal neighbors.
+#define CHAMFER_ORTHOGONAL 3
+#define CHAMFER_DIAGONAL   4
+// Distance not yet known.  Room to add a weight without overflow.
+#define CHAMFER_INFINITY   (G_MAXUINT / 2)
+
+
+/*
+ * Grid of distances over the bounds of the target, plus a margin of one pixel all around,
+ * so that the context adjacent to the target is in the grid.
+ */
+typedef struct {
+	guint width;
+	guint height;
+	Coordinates origin;       // image coordinates of grid (0,0)
+	std::vector<guint> distance;
+} TDistanceGrid;
+
 
-/** The grad (radial from 0..400) or angle of this vector (point) */
-static guint grad(Coordinates a)
+static inline guint* distanceAt(TDistanceGrid* grid, guint x, guint y)
 {
-	/* !!! x and y order in atan2 */
-	return (guint)(atan2((gfloat)a.y, (gfloat)a.x) * 200 / G_PI + 200);
+	return &grid->distance[x + y * grid->width];
 }
 
 
-
-/** Array of computed maximum distances over all points along a ray (radius) */
-static void prepare_max_cartesian_along_ray(PointVector targetPoints, guint* max_cartesian_along_ray)
+static inline guint* distanceAtPoint(TDistanceGrid* grid, Coordinates point)
 {
-	guint i;
+	return distanceAt(grid, point.x - grid->origin.x, point.y - grid->origin.y);
+}
 
-	for (i = 0; i < 401; i++)
-	{
-		max_cartesian_along_ray[i] = 0;
-	}
 
-	for (i = 0; i < targetPoints->len; i++)
-	{
-		Coordinates point = g_array_index(targetPoints, Coordinates, i);
-		// Assert point is an offset from center
-		guint cartesian = point.x * point.x + point.y * point.y;
-		guint ray = grad(point);
-		if (cartesian > max_cartesian_along_ray[ray])
-			max_cartesian_along_ray[ray] = cartesian;
-	}
+static inline void relaxDistance(guint* distance, guint neighborDistance, guint weight)
+{
+	if (neighborDistance + weight < *distance)
+		*distance = neighborDistance + weight;
 }
 
 
 /*
- * Ratio of this offset's distance from center to max distance of any point along
- * the radial through this offset.
- * Float in range (0,1] or NaN
- * Note a is an offset, i.e. a vector from center, not from the origin.
+ * Two pass chamfer distance transform.
+ * Forward pass from upper left using neighbors above and left,
+ * backward pass from lower right using neighbors below and right.
  */
-static gfloat proportion_inward(const Coordinates *a, guint* max_cartesian_along_ray)
+static void chamferDistanceTransform(TDistanceGrid* grid)
 {
-	guint ray = grad(*a);
-	/*
-	 * Note that max_cartesian_along_ray[ray] MAY equal zero, for a target having only one pixel, etc.
-	 * Floating division yields NaN which always compares FALSE.
-	 */
-	return (gfloat)((a->y * a->y) + (a->x * a->x)) / max_cartesian_along_ray[ray];
+	guint x;
+	guint y;
+	guint width = grid->width;
+	guint height = grid->height;
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+		{
+			guint* distance = distanceAt(grid, x, y);
+			if (x > 0)
+				relaxDistance(distance, *distanceAt(grid, x - 1, y), CHAMFER_ORTHOGONAL);
+			if (y > 0)
+			{
+				relaxDistance(distance, *distanceAt(grid, x, y - 1), CHAMFER_ORTHOGONAL);
+				if (x > 0)
+					relaxDistance(distance, *distanceAt(grid, x - 1, y - 1), CHAMFER_DIAGONAL);
+				if (x + 1 < width)
+					relaxDistance(distance, *distanceAt(grid, x + 1, y - 1), CHAMFER_DIAGONAL);
+			}
+		}
+
+	for (y = height; y-- > 0; )
+		for (x = width; x-- > 0; )
+		{
+			guint* distance = distanceAt(grid, x, y);
+			if (x + 1 < width)
+				relaxDistance(distance, *distanceAt(grid, x + 1, y), CHAMFER_ORTHOGONAL);
+			if (y + 1 < height)
+			{
+				relaxDistance(distance, *distanceAt(grid, x, y + 1), CHAMFER_ORTHOGONAL);
+				if (x + 1 < width)
+					relaxDistance(distance, *distanceAt(grid, x + 1, y + 1), CHAMFER_DIAGONAL);
+				if (x > 0)
+					relaxDistance(distance, *distanceAt(grid, x - 1, y + 1), CHAMFER_DIAGONAL);
+			}
+		}
 }
 
 
 /*
- * Copy targetPoint coordinates to sorting struct.
- * Precompute another field to sort on: proportional distance from center.
+ * Distance of every point in the target's bounds from the context.
+ *
+ * Context is what hasValueMap says before synthesis: not target, not transparent (and matchContextType.)
+ * Other pixels (transparent, or outside the image) are neither: the fire burns across them, but they don't ignite it.
+ *
+ * If there is no context in the grid (e.g. the target is the whole image, or the context is transparent)
+ * the margin around the target's bounds is the context, i.e. the fire burns inward from the bounds.
  */
-static GArray* targetPointsToSortArray(PointVector targetPoints)
+static void prepareDistanceGrid(
+	TDistanceGrid* grid,  // OUT
+	PointVector targetPoints,
+	Map* hasValueMap)
 {
-	GArray* sortArray = g_array_sized_new(FALSE, TRUE, sizeof(TSortElementStruct), targetPoints->len);
-
-	guint max_cartesian_along_ray[401];
-	prepare_max_cartesian_along_ray(targetPoints, max_cartesian_along_ray);
-
-	guint i;
-	TSortElementStruct sortElement;
-	Coordinates point;
-	for (i = 0; i < targetPoints->len; i++)
+	Bounds bounds = get_bounds(targetPoints, targetPoints->len);
+	guint x;
+	guint y;
+	gboolean isAnyContext = FALSE;
+
+	grid->origin.x = bounds.ulx - 1;
+	grid->origin.y = bounds.uly - 1;
+	grid->width = bounds.lrx - bounds.ulx + 3;
+	grid->height = bounds.lry - bounds.uly + 3;
+	grid->distance.assign(grid->width * grid->height, CHAMFER_INFINITY);
+
+	for (y = 0; y < grid->height; y++)
+		for (x = 0; x < grid->width; x++)
+		{
+			Coordinates imagePoint = { grid->origin.x + static_cast<gint>(x), grid->origin.y + static_cast<gint>(y) };
+			if (imagePoint.x >= 0 && imagePoint.y >= 0
+				&& imagePoint.x < (gint)hasValueMap->width && imagePoint.y < (gint)hasValueMap->height
+				&& *bytemap_index(hasValueMap, imagePoint))
+			{
+				*distanceAt(grid, x, y) = 0;
+				isAnyContext = TRUE;
+			}
+		}
+
+	if (!isAnyContext)
 	{
-		point = g_array_index(targetPoints, Coordinates, i); // Allocates, but len is zero: no elements
-		sortElement.targetPoint = point;
-		sortElement.proportionToCenter = proportion_inward(&point, max_cartesian_along_ray);
-		g_array_append_val(sortArray, sortElement);
-		// g_printf("%d %d %d\n", sortElement.targetPoint.x, sortElement.targetPoint.y, sortElement.proportionToCenter );
+		for (x = 0; x < grid->width; x++)
+		{
+			*distanceAt(grid, x, 0) = 0;
+			*distanceAt(grid, x, grid->height - 1) = 0;
+		}
+		for (y = 0; y < grid->height; y++)
+		{
+			*distanceAt(grid, 0, y) = 0;
+			*distanceAt(grid, grid->width - 1, y) = 0;
+		}
 	}
-	return sortArray;
+
+	chamferDistanceTransform(grid);
 }
 
 
-/** Extract coordinates from sort array, and free the sort array */
-static void targetPointsFromSortArray(PointVector targetPoints,	GArray* sortArray)
+/*
+ * Sort target points by distance, ascending or descending.
+ * Distances are small integers, so the radix sort is one pass, i.e. a counting sort.
+ */
+static void sortTargetPointsByDistance(
+	PointVector targetPoints,
+	TDistanceGrid* grid,
+	gboolean isDescending)
 {
 	guint i;
+	TSortKeys keys(targetPoints->len);
+
 	for (i = 0; i < targetPoints->len; i++)
-	{
-		g_array_index(targetPoints, Coordinates, i) = g_array_index(sortArray, TSortElementStruct, i).targetPoint;
-	}
-	g_array_free(sortArray, TRUE);
+		keys[i] = *distanceAtPoint(grid, targetPoints->data[i]);
+	if (isDescending)
+		invertSortKeys(keys);
+	sortPointsByKey(targetPoints, keys);
 }
 
 
-#endif /* RESYNTH_BRUSHFIRE_H_ */
\ No newline at end of file
+#endif /* RESYNTH_BRUSHFIRE_H_ */
@@ -14,6 +14,9 @@ There are three configurations:
 	(This is for testing using a gimp plugin harness to the gimp independent engine and glibProxy)
 3) libsynth.a (inner engine) uses glibProxy, not gimp or glib.  (platform independent engine.)
 
+In every configuration, the engine's containers (Map, PointVector, see map.h and engineTypes.h) are its own,
+typed and aligned, not GArray: from glib or glibProxy the engine takes only the basic types, the PRNG, and asserts.
+
   Copyright (C) 2010, 2011  Lloyd Konneker
 
   This program is free software; you can redistribute it and/or modify
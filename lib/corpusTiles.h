@@ -0,0 +1,118 @@
+/*
+Tiled copy of the corpus, for matching patches (parameter isCorpusTiled.)
+
+The corpus pixmap is row major, its pixels interleaving all pixelels: mask, colors, alpha, maps.
+A patch of a candidate spans as many rows of the pixmap as the patch,
+each row on a different cache line, most of whose bytes are pixels outside the patch, or pixelels not matched.
+For a corpus much larger than cache, the lines of a random candidate are all misses.
+
+The tiled copy packs only the matched pixelels of a pixel, colors then maps,
+in square tiles of CORPUS_TILE_SIDE pixels, each tile contiguous and row major within.
+So a patch touches few lines (and pages): mostly those of one to four tiles.
+The mask is a separate bytemap in the same order, so masked neighbors don't load pixels.
+
+Only matching (computeBestFit()) reads the tiles: the corpus pixmap is still the source of colors.
+The patch differences are the same as from the pixmap, so the result is the same.
+The copy costs memory: a byte per pixel plus the matched pixelels, padded to whole tiles.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_CORPUS_TILES_H_
+#define RESYNTH_CORPUS_TILES_H_
+
+#include <vector>
+
+#define CORPUS_TILE_SHIFT 3
+#define CORPUS_TILE_SIDE (1 << CORPUS_TILE_SHIFT)  // 8 pixels
+#define CORPUS_TILE_MASK (CORPUS_TILE_SIDE - 1)
+
+
+typedef struct corpusTilesStruct {
+	guint width;        // Of the corpus, in pixels
+	guint height;
+	guint tilesPerRow;
+	guint depth;        // Matched pixelels per pixel: colors, then maps
+	std::vector<Pixelel> pixels;  // Tile after tile, each row major
+	std::vector<Pixelel> mask;    // Same order, one pixelel per pixel
+} TCorpusTiles;
+
+
+/* Index of a pixel in tile order.  Coordinates must be in the corpus. */
+static inline guint corpusTileIndex(
+	const TCorpusTiles * const tiles,
+	const Coordinates point)
+{
+	guint tile = (static_cast<guint>(point.y) >> CORPUS_TILE_SHIFT) * tiles->tilesPerRow
+		+ (static_cast<guint>(point.x) >> CORPUS_TILE_SHIFT);
+	return (tile << (2 * CORPUS_TILE_SHIFT))
+		+ ((point.y & CORPUS_TILE_MASK) << CORPUS_TILE_SHIFT)
+		+ (point.x & CORPUS_TILE_MASK);
+}
+
+
+/* Whether a point is outside the corpus: clipped, but not tested for mask. */
+static inline gboolean isClippedCorpusTiles(
+	const TCorpusTiles * const tiles,
+	const Coordinates point)
+{
+	return point.x < 0
+		|| point.y < 0
+		|| point.x >= (gint)tiles->width
+		|| point.y >= (gint)tiles->height;
+}
+
+
+/*
+Copy the corpus into tiles.
+Pixels that pad the last row and column of tiles are masked.
+*/
+static void prepareCorpusTiles(
+	TCorpusTiles* tiles,  // OUT
+	TFormatIndices* indices,
+	Map* corpusMap)
+{
+	guint tileRows = (corpusMap->height + CORPUS_TILE_MASK) >> CORPUS_TILE_SHIFT;
+	guint x;
+	guint y;
+
+	tiles->width = corpusMap->width;
+	tiles->height = corpusMap->height;
+	tiles->tilesPerRow = (corpusMap->width + CORPUS_TILE_MASK) >> CORPUS_TILE_SHIFT;
+	tiles->depth = indices->img_match_bpp + indices->map_match_bpp;
+	tiles->mask.assign(tiles->tilesPerRow * tileRows * CORPUS_TILE_SIDE * CORPUS_TILE_SIDE, MASK_UNSELECTED);
+	tiles->pixels.assign(tiles->mask.size() * tiles->depth, 0);
+
+	for (y = 0; y < corpusMap->height; y++)
+		for (x = 0; x < corpusMap->width; x++)
+		{
+			Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+			const Pixelel * corpus_pixel = pixmap_index(corpusMap, coords);
+			guint index = corpusTileIndex(tiles, coords);
+			Pixelel * packed = &tiles->pixels[index * tiles->depth];
+			TPixelelIndex j;
+
+			tiles->mask[index] = corpus_pixel[MASK_PIXELEL_INDEX];
+			for (j = FIRST_PIXELEL_INDEX; j < indices->colorEndBip; j++)
+				*packed++ = corpus_pixel[j];
+			for (j = indices->map_start_bip; j < indices->map_end_bip; j++)
+				*packed++ = corpus_pixel[j];
+		}
+}
+
+
+#endif /* RESYNTH_CORPUS_TILES_H_ */
@@ -0,0 +1,79 @@
+/*
+Export of the correspondence: for each target pixel, the corpus pixel its color came from.
+
+After synthesis, sourceOfMap holds the correspondence, then the engine frees it.
+A caller can ask for it (TImageSynthExtras sourceIndices or sourceCoordinates) to:
+- apply the same mapping to other layers of the image (normal maps, depth, masters of higher bit depth)
+  by one cheap gather, instead of searching again per layer
+- resynthesize incrementally after an edit of the mask (see incremental.h.)
+
+Two forms, either or both:
+- linear index into the corpus, y * corpus width + x, or -1
+- (x, y) pairs of corpus coordinates, or (-1, -1)
+for each pixel of the target image, row major; -1 where not in the target,
+or not synthesized (canceled before the first pass finished.)
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_CORRESPONDENCE_H_
+#define RESYNTH_CORRESPONDENCE_H_
+
+
+/* Source of a pixel of the target image, or (-1, -1). */
+static inline Coordinates exportedSourceOf(
+	Coordinates coords,
+	Map* targetMap,
+	Map* sourceOfMap)
+{
+	Coordinates none = { -1, -1 };
+	Coordinates source = getSourceOf(coords, sourceOfMap);
+	return (isSelectedTarget(coords, targetMap) && source.x != -1) ? source : none;
+}
+
+
+static void exportCorrespondence(
+	gint32* sourceIndices,		// OUT target width * height, or NULL
+	gint32* sourceCoordinates,	// OUT target width * height * 2, or NULL
+	Map* targetMap,
+	Map* corpusMap,
+	Map* sourceOfMap)
+{
+	guint x;
+	guint y;
+
+	for (y = 0; y < targetMap->height; y++)
+		for (x = 0; x < targetMap->width; x++)
+		{
+			Coordinates coords = { static_cast<gint>(x), static_cast<gint>(y) };
+			Coordinates source = exportedSourceOf(coords, targetMap, sourceOfMap);
+			guint index = y * targetMap->width + x;
+
+			if (sourceIndices)
+				sourceIndices[index] = (source.x != -1)
+					? static_cast<gint32>(source.y * corpusMap->width + source.x)
+					: -1;
+			if (sourceCoordinates)
+			{
+				sourceCoordinates[2 * index] = source.x;
+				sourceCoordinates[2 * index + 1] = source.y;
+			}
+		}
+}
+
+
+#endif /* RESYNTH_CORRESPONDENCE_H_ */
@@ -0,0 +1,103 @@
+/*
+Counter based pseudo random numbers, for deterministic synthesis (parameter isDeterministic.)
+
+The PRNG (GRand, or rand() in glibProxy) is one sequence shared by all threads:
+which thread draws which number depends on timing.
+A counter based generator instead computes the n'th number of a stream directly, by hashing (seed, stream, n).
+Each target point has its own stream per pass,
+so its random probes are the same whichever thread synthesizes it, and in whatever order.
+Ordering the target (see orderTarget.h) has a stream of its own.
+
+The hash is the finalizer of SplitMix64: fast, and good enough to pick corpus points.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_COUNTER_RANDOM_H_
+#define RESYNTH_COUNTER_RANDOM_H_
+
+#define COUNTER_RANDOM_GOLDEN 0x9E3779B97F4A7C15ull
+
+
+static inline guint64 mixBits64(guint64 x)
+{
+	x += COUNTER_RANDOM_GOLDEN;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+
+// Pass of the stream of ordering the target, not a pass of synthesis
+#define COUNTER_RANDOM_ORDER_PASS G_MAXUINT
+
+
+/* Key of the stream of random numbers of a target point in a pass. */
+static inline guint64 counterRandomStream(guint seed, guint pass, guint targetIndex)
+{
+	return mixBits64(mixBits64(seed) ^ ((static_cast<guint64>(pass) << 32) | targetIndex));
+}
+
+
+/* The counter'th random number of a stream, in [0, range).  By multiply and shift, not modulo. */
+static inline guint counterRandomRange(guint64 stream, guint counter, guint range)
+{
+	guint64 bits = mixBits64(stream + counter * COUNTER_RANDOM_GOLDEN) >> 32;
+	return static_cast<guint>((bits * range) >> 32);
+}
+
+
+/*
+Source of random probes of synthesize(), or of ordering the target: the shared PRNG, or a counter based stream.
+*/
+typedef struct probeRandomStruct {
+	GRand* prng;          // If not counter based
+	gboolean isCounterBased;
+	guint64 stream;       // Of the target point being synthesized
+	guint counter;        // Count of numbers drawn from the stream
+} TProbeRandom;
+
+
+static inline void prepareProbeRandom(TProbeRandom* random, GRand* prng)
+{
+	random->prng = prng;
+	random->isCounterBased = FALSE;
+	random->stream = 0;
+	random->counter = 0;
+}
+
+
+/* Start the stream of a target point. */
+static inline void startCounterProbeRandom(TProbeRandom* random, guint seed, guint pass, guint targetIndex)
+{
+	random->prng = NULL;
+	random->isCounterBased = TRUE;
+	random->stream = counterRandomStream(seed, pass, targetIndex);
+	random->counter = 0;
+}
+
+
+/* A random number in [0, range), from the source. */
+static inline guint drawRandomRange(TProbeRandom* random, guint range)
+{
+	if (!random->isCounterBased)
+		return g_rand_int_range(random->prng, 0, range);
+	return counterRandomRange(random->stream, random->counter++, range);
+}
+
+
+#endif /* RESYNTH_COUNTER_RANDOM_H_ */
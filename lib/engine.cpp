@@ -97,6 +97,8 @@
 #define g_rand_int_range(r,u,l) s_rand_int_range(r,u,l)
 #endif
 
+#include <cstring>  // memset
+
  /* Shared with resynth-gui, engine plugin, and engine */
 #include "imageSynthConstants.h"
 
@@ -115,20 +117,12 @@ Also, some functions are inlined.
 
 #include "engineTypes.h"
 #include "mapIndex.h" // inlined, used in innermost loop
+#include "rowBands.h"
+#include "maskScan.h"
 #include "mapOps.h"   // definitions for map.h
 #include "matchWeighting.h"
-#include "orderTarget.h"
-
-
-#ifdef STATS
-/* For development */
-guint countSourceTries = 0;
-guint countTargetTries = 0;
-guint total_targets = 0;  /* Total target attempts over all passes, barring short circuit. */
-
-// remember the most recent kind of corpus point that bettered the previous best
-guint bettermentStats[MAX_BETTERMENT_KIND];
-#endif
+#include "counterRandom.h"
+#include "orderTarget.h"  // requires counterRandom.h
 
 
 /*
@@ -163,9 +157,9 @@ getHasValue(Coordinates coords, Map* hasValueMap)
 }
 
 static inline void
-prepareHasValue(Map* targetMap, Map* hasValueMap)
+prepareHasValue(Map* targetMap, Map* hasValueMap, TImageSynthArena* arena)
 {
-	new_bytemap(hasValueMap, targetMap->width, targetMap->height);
+	new_arena_map(hasValueMap, targetMap->width, targetMap->height, 1, arena);
 }
 
 
@@ -204,24 +198,36 @@ getSourceOf(
 }
 
 
+/*
+Fill a map, every byte of every element, in bands.
+For the maps whose initial element is all ones: -1 coordinates, or -1 unsigned.
+*/
+static void
+fillMapBytes(
+	Map* map,
+	guchar value)
+{
+	const size_t rowBytes = (size_t)map->width * map->depth;
+
+	forEachRowBand(rowBandCount(map->width, map->height), map->height,
+		[map, rowBytes, value](guint /*band*/, guint startRow, guint endRow)
+		{
+			memset(map->data + startRow * rowBytes, value, (endRow - startRow) * rowBytes);
+		});
+}
+
+
 /* Initially, no target points have source in corpus, i.e. none synthesized. */
 static void
 prepare_target_sources(
 	Map* targetMap,
-	Map* sourceOfMap)
+	Map* sourceOfMap,
+	TImageSynthArena* arena)
 {
-	guint x;
-	guint y;
-	Coordinates null_coords = { -1, -1 };
+	new_arena_map(sourceOfMap, targetMap->width, targetMap->height, sizeof(Coordinates), arena);
 
-	new_coordmap(sourceOfMap, targetMap->width, targetMap->height);
-
-	for (y = 0; y < targetMap->height; y++)
-		for (x = 0; x < targetMap->width; x++)
-		{
-			Coordinates coords = { static_cast<int>(x), static_cast<int>(y) };
-			setSourceOf(coords, null_coords, sourceOfMap);
-		}
+	// Every source the null coordinates { -1, -1 }, all bits set
+	fillMapBytes(sourceOfMap, 0xFF);
 }
 
 static inline gboolean
@@ -301,11 +307,6 @@ not_transparent_corpus(
 }
 
 
-/* Included here because it depends on some routines above. */
-// If STATS is not defined, it redefines stat function calls to nil
-#include "stats.h"
-
-
 /*
 Array of index of most recent target point that probed this corpus point
 (recentProberMap[corpus x,y] = target)
@@ -313,18 +314,72 @@ Array of index of most recent target point that probed this corpus point
 !!! Note recentProberMap is unsigned, -1 == 0xFFFFFF should not match any target index.
 */
 static void
-prepareRecentProber(Map* corpusMap, Map* recentProberMap)
+prepareRecentProber(Map* corpusMap, Map* recentProberMap, TImageSynthArena* arena)
 {
-	guint x;
-	guint y;
+	new_arena_map(recentProberMap, corpusMap->width, corpusMap->height, sizeof(guint), arena);
+	fillMapBytes(recentProberMap, 0xFF);  // Every element -1, all bits set
+}
+
+
+/*
+Count of the selected pixels of the target image, in bands of rows (see rowBands.h),
+and the rows they span: for sizing, before preparing anything (see prepareTargetPoints().)
+*/
+typedef struct {
+	guint bandCount;
+	std::vector<guint> bandStart;  // Index in targetPoints of the first point of each band, then the total
+	guint firstRow;                // Rows having target points, [firstRow, endRow)
+	guint endRow;
+} TTargetCount;
 
-	new_intmap(recentProberMap, corpusMap->width, corpusMap->height);
-	for (y = 0; y < (guint)corpusMap->height; y++)
-		for (x = 0; x < (guint)corpusMap->width; x++)
+
+static guint
+countTargetPoints(
+	Map* targetMap,
+	TTargetCount* count  // OUT
+	)
+{
+	TMaskScan selectedScan;  // isSelectedTarget()
+	std::vector<guint> bandFirstRow;
+	std::vector<guint> bandEndRow;
+	guint i;
+
+	prepareMaskScan(&selectedScan, targetMap->depth, MASK_UNSELECTED, FALSE, 0);
+	count->bandCount = rowBandCount(targetMap->width, targetMap->height);
+	count->bandStart.assign(count->bandCount + 1, 0);
+	bandFirstRow.assign(count->bandCount, targetMap->height);
+	bandEndRow.assign(count->bandCount, 0);
+
+	/* Count selected pixels in the image, for sizing a vector */
+	forEachRowBand(count->bandCount, targetMap->height,
+		[&](guint band, guint startRow, guint endRow)
 		{
-			Coordinates coords = { static_cast<int>(x), static_cast<int>(y) };
-			*intmap_index(recentProberMap, coords) = -1;
-		}
+			guint bandPoints = 0;
+			guint y;
+
+			for (y = startRow; y < endRow; y++)
+			{
+				Coordinates rowStart = { 0, static_cast<int>(y) };
+				guint rowPoints = countMaskScanRow(pixmap_index(targetMap, rowStart), targetMap->width, &selectedScan);
+
+				if (rowPoints)
+				{
+					if (bandFirstRow[band] > y) bandFirstRow[band] = y;
+					bandEndRow[band] = y + 1;
+				}
+				bandPoints += rowPoints;
+			}
+			count->bandStart[band + 1] = bandPoints;
+		});
+	count->firstRow = targetMap->height;
+	count->endRow = 0;
+	for (i = 0; i < count->bandCount; i++)
+	{
+		count->bandStart[i + 1] += count->bandStart[i];
+		count->firstRow = MIN(count->firstRow, bandFirstRow[i]);
+		count->endRow = MAX(count->endRow, bandEndRow[i]);
+	}
+	return count->bandStart[count->bandCount];
 }
 
 
@@ -335,60 +390,76 @@ and the context (the surroundings.)
 Both come from the target image.  But the *target* is not *target image*.
 Prepare a vector of target points.
 Initialize hasValueMap for all target points.
+
+In bands of rows (see rowBands.h), scanning the mask (see maskScan.h):
+the count (countTargetPoints()) sizes the vector and places each band's points in it,
+then each band writes its points, in row major order as from a single scan.
 */
 static void
 prepareTargetPoints(
 	gboolean is_use_context,
 	TFormatIndices* indices,
 	Map* targetMap,
+	const TTargetCount* count,
 	Map* hasValueMap,
-	PointVector* targetPoints
+	PointVector* targetPoints,
+	TImageSynthArena* arena
 	)
 {
-	guint x;
-	guint y;
+	const guint bandCount = count->bandCount;
+	const std::vector<guint>& bandStart = count->bandStart;
+	TMaskScan selectedScan;  // isSelectedTarget()
+	TMaskScan contextScan;   // Not selected, and not_transparent_image()
 
-	/* Count selected pixels in the image, for sizing a vector */
-	guint size = 0;
-	for (y = 0; y < targetMap->height; y++)
-		for (x = 0; x < targetMap->width; x++)
-		{
-			Coordinates coords = { static_cast<int>(x), static_cast<int>(y) };
-			if (isSelectedTarget(coords, targetMap))
-				size++;
-		}
+	prepareMaskScan(&selectedScan, targetMap->depth, MASK_UNSELECTED, FALSE, 0);
+	prepareMaskScan(&contextScan, targetMap->depth, MASK_UNSELECTED, TRUE,
+		indices->isAlphaTarget ? indices->alpha_bip : 0);
 
-	*targetPoints = g_array_sized_new(FALSE, TRUE, sizeof(Coordinates), size); /* reserve */
+	*targetPoints = new_point_vector(arena, bandStart[bandCount]); /* reserve */
+	(*targetPoints)->len = bandStart[bandCount];  /* set below, by bands */
 
-	prepareHasValue(targetMap, hasValueMap);  /* reserve, initialize to value: unknown */
+	prepareHasValue(targetMap, hasValueMap, arena);  /* reserve, set below for every point */
 
-	for (y = 0; y < targetMap->height; y++)
-		for (x = 0; x < targetMap->width; x++)
+	forEachRowBand(bandCount, targetMap->height,
+		[&](guint band, guint startRow, guint endRow)
 		{
-			Coordinates coords = { static_cast<int>(x), static_cast<int>(y) };
-
-			/*
-			Remember whether use this image point for matching target neighbors.
-			Initially, no target points have value, and some context points will have value.
-			Later, synthesized target points will have values also.
-			*/
-			setHasValue(&coords,
-				(
-					is_use_context // ie use_border ie match image neighbors outside the selection (the context)
-					&& !isSelectedTarget(coords, targetMap)  // outside the target
-					/* !!! and if the point is not transparent (e.g. background layer) which is arbitrarily black !!! */
-					&& not_transparent_image(coords, indices, targetMap)
-					),
-				hasValueMap);
-
-			/*
-			Make vector targetPoints
-			!!! Note we do NOT exclude transparent.  Will synthesize color (but not alpha)
-			for all selected pixels in target, regardless of transparency.
-			*/
-			if (isSelectedTarget(coords, targetMap))
-				g_array_append_val(*targetPoints, coords);
-		}
+			Coordinates* point = &(*targetPoints)->data[bandStart[band]];
+			guint y;
+
+			for (y = startRow; y < endRow; y++)
+			{
+				Coordinates rowStart = { 0, static_cast<int>(y) };
+				const Pixelel* row = pixmap_index(targetMap, rowStart);
+				guchar* hasValueRow = bytemap_index(hasValueMap, rowStart);
+
+				/*
+				Remember whether use this image point for matching target neighbors.
+				Initially, no target points have value, and some context points will have value.
+				Later, synthesized target points will have values also.
+				Has value if:
+				is_use_context // ie use_border ie match image neighbors outside the selection (the context)
+				&& outside the target
+				&& !!! the point is not transparent (e.g. background layer) which is arbitrarily black !!!
+				*/
+				if (is_use_context)
+					writeMaskScanRow(row, targetMap->width, &contextScan, hasValueRow);
+				else
+					memset(hasValueRow, FALSE, targetMap->width);
+
+				/*
+				Make vector targetPoints
+				!!! Note we do NOT exclude transparent.  Will synthesize color (but not alpha)
+				for all selected pixels in target, regardless of transparency.
+				*/
+				forEachMaskScanRow(row, targetMap->width, &selectedScan,
+					[&point, y](guint x)
+					{
+						point->x = static_cast<int>(x);
+						point->y = static_cast<int>(y);
+						point++;
+					});
+			}
+		});
 }
 
 
@@ -397,36 +468,59 @@ prepareTargetPoints(
 /*
 Scan corpus pixmap for selected && nottransparent pixels, create vector of coords.
 Used to sample corpus.
+In bands of rows, scanning the mask (see prepareTargetPoints()), but in one scan:
+each band writes its points from the index of its first pixel, then the bands are moved together.
 */
 void
 prepareCorpusPoints(
 	TFormatIndices* indices,
 	Map* corpusMap,
-	PointVector* corpusPoints
+	PointVector* corpusPoints,
+	TImageSynthArena* arena
 	)
 {
+	const guint bandCount = rowBandCount(corpusMap->width, corpusMap->height);
+	std::vector<guint> bandLength(bandCount, 0);
+	TMaskScan corpusScan;
+	guint i;
+
+	/* In prior versions, the user's mask was inverted to establish the corpus,
+	I.E. this was "not is_selected"
+	*/
+	// isSelectedCorpus() && not_transparent_corpus(): exclude transparent from corpus
+	prepareMaskScan(&corpusScan, corpusMap->depth, MASK_TOTALLY_SELECTED, TRUE,
+		indices->isAlphaSource ? indices->alpha_bip : 0);
+
 	/* Reserve size of pixmap, but excess, includes unselected. */
-	*corpusPoints = g_array_sized_new(FALSE, TRUE, sizeof(Coordinates),
-		corpusMap->height*corpusMap->width);
+	*corpusPoints = new_point_vector(arena, corpusMap->height*corpusMap->width);
 
-	{
-		guint x;
-		guint y;
+	forEachRowBand(bandCount, corpusMap->height,
+		[&](guint band, guint startRow, guint endRow)
+		{
+			Coordinates* bandPoints = &(*corpusPoints)->data[(size_t)startRow * corpusMap->width];
+			Coordinates* point = bandPoints;
+			guint y;
 
-		for (y = 0; y < corpusMap->height; y++)
-			for (x = 0; x < corpusMap->width; x++)
+			for (y = startRow; y < endRow; y++)
 			{
-				Coordinates coords = { static_cast<int>(x), static_cast<int>(y) };
-				/* In prior versions, the user's mask was inverted to establish the corpus,
-				I.E. this was "not is_selected"
-				*/
-				if (isSelectedCorpus(coords, corpusMap)
-					&& not_transparent_corpus(coords, indices, corpusMap) /* Exclude transparent from corpus */
-					)
-				{
-					g_array_append_val(*corpusPoints, coords);
-				}
+				Coordinates rowStart = { 0, static_cast<int>(y) };
+				forEachMaskScanRow(pixmap_index(corpusMap, rowStart), corpusMap->width, &corpusScan,
+					[&point, y](guint x)
+					{
+						point->x = static_cast<int>(x);
+						point->y = static_cast<int>(y);
+						point++;
+					});
 			}
+			bandLength[band] = static_cast<guint>(point - bandPoints);
+		});
+
+	// The first band is in place, move the others down after it, in order
+	for (i = 0; i < bandCount; i++)
+	{
+		const Coordinates* bandPoints = &(*corpusPoints)->data[(size_t)rowBandStart(i, bandCount, corpusMap->height) * corpusMap->width];
+		memmove(&(*corpusPoints)->data[(*corpusPoints)->len], bandPoints, bandLength[i] * sizeof(Coordinates));
+		(*corpusPoints)->len += bandLength[i];
 	}
 	// Size is checked by caller. 
 }
@@ -440,7 +534,21 @@ randomCorpusPoint(
 {
 	/* Was rand()%corpusPoints_size but thats not uniform. */
 	gint index = g_rand_int_range(prng, 0, corpusPoints->len);
-	return g_array_index(corpusPoints, Coordinates, index);
+	return corpusPoints->data[index];
+}
+
+
+/* Same, from a source of probes: the PRNG or a counter based stream. */
+static inline Coordinates
+probeRandomCorpusPoint(
+	PointVector corpusPoints,
+	TProbeRandom* random
+	)
+{
+	if (!random->isCounterBased)
+		return randomCorpusPoint(corpusPoints, random->prng);
+	guint index = counterRandomRange(random->stream, random->counter++, corpusPoints->len);
+	return corpusPoints->data[index];
 }
 
 
@@ -451,7 +559,7 @@ Vector of offsets to surrounding points of a point, i.e. to a patch around a poi
 Used as candidates to compute neighbors vector (nearby points that are selected and with values.)
 Which is used in two places: 1) neighbor heuristic 2) try_point.
 
-Sorted ascending on distance from (0,0) (see the < operator for class Coordinates).
+Sorted ascending on distance from (0,0), ties in row major order (see sortPoints.h).
 
 !!! Note that offset 0,0 included, is the first element in sorted vector.
 That makes a point it's own neighbor, i.e. part of the patch for (surrounding) a point.
@@ -462,20 +570,46 @@ Why?  So from one corner, the offsets will reach fully across.
 TODO, for uncropping, where the target surrounds the corpus,
 this might be vastly many more offsets than are needed for good synthesis.
 But at worst, if not used they get paged out from virtual memory.
+Under a memory budget, the offsets may span only a radius (see memoryPlan.h):
+a target point whose nearest neighbors with values are farther has fewer neighbors.
 */
+static guint
+countSortedOffsets(
+	guint targetWidth,
+	guint targetHeight,
+	guint corpusWidth,
+	guint corpusHeight,
+	guint radius,     // Zero for all
+	gint* width,      // OUT offsets are in (-width, width)
+	gint* height)     // OUT
+{
+	// Minimum().  Use smaller dimension of corpus and target.
+	*width = static_cast<gint>(MIN(corpusWidth, targetWidth));
+	*height = static_cast<gint>(MIN(corpusHeight, targetHeight));
+	if (radius)
+	{
+		*width = MIN(*width, static_cast<gint>(radius) + 1);
+		*height = MIN(*height, static_cast<gint>(radius) + 1);
+	}
+	return (2 * *width - 1)*(2 * *height - 1);   // eg for width==3, [-2,-1,0,1,2], size==5
+}
+
+
 static void
 prepareSortedOffsets(
 	Map* targetMap,
 	Map* corpusMap,
-	PointVector* sortedOffsets
+	guint radius,     // Zero for all
+	PointVector* sortedOffsets,
+	TImageSynthArena* arena
 	)
 {
-	// Minimum().  Use smaller dimension of corpus and target.
-	gint width = (corpusMap->width < targetMap->width ? corpusMap->width : targetMap->width);
-	gint height = (corpusMap->height < targetMap->height ? corpusMap->height : targetMap->height);
-	guint allocatedSize = (2 * width - 1)*(2 * height - 1);   // eg for width==3, [-2,-1,0,1,2], size==5
+	gint width;
+	gint height;
+	guint allocatedSize = countSortedOffsets(targetMap->width, targetMap->height, corpusMap->width, corpusMap->height,
+		radius, &width, &height);
 
-	*sortedOffsets = g_array_sized_new(FALSE, TRUE, sizeof(Coordinates), allocatedSize); //Reserve
+	*sortedOffsets = new_point_vector(arena, allocatedSize); //Reserve
 
 	{
 		gint x; // !!! Signed offsets
@@ -485,11 +619,18 @@ prepareSortedOffsets(
 			for (x = -width + 1; x < width; x++)
 			{
 				Coordinates coords = { x,y };
-				g_array_append_val(*sortedOffsets, coords);
+				append_point(*sortedOffsets, coords);
 			}
 	}
 	g_assert((*sortedOffsets)->len == allocatedSize);  // Completely filled
-	g_array_sort(*sortedOffsets, (gint(*)(const void*, const void*)) lessCartesian);
+	{
+		// Key computed once per offset.  Stable: offsets of equal distance stay in row major order.
+		TSortKeys keys(allocatedSize);
+		guint i;
+		for (i = 0; i < allocatedSize; i++)
+			keys[i] = cartesianKey((*sortedOffsets)->data[i]);
+		sortPointsByKey(*sortedOffsets, keys);
+	}
 
 	/* lkk An experiment to sort the offsets in row major order for better memory
 	locality didn't help performance.
@@ -522,7 +663,14 @@ clippedOrMaskedCorpus(
 // Descending levels of the engine
 // imageSynth()->engine()->refiner()->synthesize
 #include "passes.h"
+#include "trace.h"
+#include "preview.h"
+#include "corpusTiles.h"
 #include "synthesize.h"
+#include "phasedSynthesis.h"
+#include "correspondence.h"
+#include "incremental.h"
+#include "memoryPlan.h"
 // Both files define the same function refiner()
 #ifdef SYNTH_THREADED
 #include "refinerThreaded.h"
@@ -530,6 +678,17 @@ clippedOrMaskedCorpus(
 #include "refiner.h"
 #endif
 
+/* End a run: release its state in the arena, freeing the arena if it is the run's own. */
+static void
+releaseArena(TImageSynthArena* arena, TImageSynthArena* ownArena)
+{
+	if (ownArena)
+		freeImageSynthArena(ownArena);
+	else
+		imageSynthArenaReset(arena);
+}
+
+
 /*
 The engine.
 Independent of platform, calling app, and graphics libraries.
@@ -544,9 +703,12 @@ engine(
 	Map* corpusMap,
 	void(*progressCallback)(int, void*),
 	void *contextInfo,
-	int *cancelFlag
+	int *cancelFlag,
+	TImageSynthExtras* extras
 	)
 {
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
 	// Engine private data. On stack (and heap), not global, so engine is reentrant.
 
 	/*
@@ -587,100 +749,196 @@ engine(
 	TPixelelMetricFunc corpusTargetMetric;
 	TMapPixelelMetricFunc mapMetric;
 
+	TImageSynthStats* stats = (extras ? extras->stats : NULL);
+	if (stats)
+	{
+		memset(stats, 0, sizeof(TImageSynthStats));
+		stats->termination = IMAGE_SYNTH_TERMINATION_ALL_PASSES;
+	}
+
+	TTracer tracer;
+	prepareTracer(&tracer, extras, startTime);
+	std::chrono::steady_clock::time_point phaseStartTime = startTime;
+
 	// check parameters in range
 	if (parameters.patchSize > IMAGE_SYNTH_MAX_NEIGHBORS)
 		return IMAGE_SYNTH_ERROR_PATCH_SIZE_EXCEEDED;
+	if (parameters.matchMetric < 0 || parameters.matchMetric >= IMAGE_SYNTH_METRIC_COUNT)
+		return IMAGE_SYNTH_ERROR_MATCH_METRIC_RANGE;
+	// The pixmaps are in the internal format of indices, padded, see prepareImageFormatIndices()
+	g_assert(targetMap->depth == indices->total_bpp && corpusMap->depth == indices->total_bpp);
 
-	// target prep
-	prepareTargetPoints(parameters.matchContextType, indices, targetMap,
-		&hasValueMap,
-		&targetPoints);
-#ifdef ANIMATE
-	clear_target_pixels(indices->color_end_bip);  // For debugging, blacken so new colors sparkle
-#endif
+	// Count the target first: for the memory plan, before allocating
+	TTargetCount targetCount;
 /*
 Rare user error: no target selected (mask empty.)
 This error NOT occur in GIMP if selection does not intersect, since then we use the whole drawable.
 */
-	if (!targetPoints->len)
-	{
-		g_array_free(targetPoints, TRUE);
-		free_map(&hasValueMap);
+	if (!countTargetPoints(targetMap, &targetCount))
 		return IMAGE_SYNTH_ERROR_EMPTY_TARGET;
+
+	// Strategies under the memory budget, see memoryPlan.h
+	TEngineMemoryShape memoryShape = {
+		targetMap->width, targetMap->height,
+		corpusMap->width, corpusMap->height,
+		indices->total_bpp,
+		static_cast<guint>(indices->img_match_bpp + indices->map_match_bpp),
+		targetCount.bandStart[targetCount.bandCount],
+		targetMap->width,  // Columns are not counted, a bound
+		targetCount.endRow - targetCount.firstRow
+	};
+	TMemoryPlan memoryPlan;
+	if (!planMemory(&memoryPlan, &parameters, &memoryShape))
+		return IMAGE_SYNTH_ERROR_MEMORY_LIMIT;
+	parameters.isCorpusTiled = memoryPlan.isCorpusTiled;
+	if (stats)
+	{
+		stats->memoryBytes = memoryPlan.peakBytes;
+		stats->offsetsRadius = memoryPlan.offsetsRadius;
+		stats->isCorpusTiled = memoryPlan.isCorpusTiled;
 	}
-	prepare_target_sources(targetMap, &sourceOfMap);
+
+	/*
+	The maps and vectors above are in an arena: the caller's, kept between runs, else the run's own.
+	Reset first: a prior run that failed may not have.
+	Then reserve all the run allocates in it, so it is one block.
+	*/
+	TImageSynthArena* ownArena = (extras && extras->arena) ? NULL : newImageSynthArena(TRUE);
+	TImageSynthArena* arena = ownArena ? ownArena : extras->arena;
+	imageSynthArenaReset(arena);
+	imageSynthArenaReserve(arena, memoryPlan.arenaBytes);
+
+	// target prep
+	prepareTargetPoints(parameters.matchContextType, indices, targetMap, &targetCount,
+		&hasValueMap,
+		&targetPoints,
+		arena);
+	phaseStartTime = traceSpan(&tracer, "prepareTargetPoints", phaseStartTime);
+	prepare_target_sources(targetMap, &sourceOfMap, arena);
 
 
 	// source prep
-	prepareCorpusPoints(indices, corpusMap, &corpusPoints);
+	phaseStartTime = std::chrono::steady_clock::now();
+	prepareCorpusPoints(indices, corpusMap, &corpusPoints, arena);
+	phaseStartTime = traceSpan(&tracer, "prepareCorpusPoints", phaseStartTime);
 	/*
 	Rare user error: all corpus pixels transparent or not selected (mask empty.) Which means we can't synthesize.
 	This error NOT occur in GIMP if selection does not intersect, since then we use the whole drawable.
 	*/
 	if (!corpusPoints->len)
 	{
-		g_array_free(targetPoints, TRUE);
-		free_map(&hasValueMap);
-		free_map(&sourceOfMap);
-		g_array_free(corpusPoints, TRUE);
+		releaseArena(arena, ownArena);
 		return IMAGE_SYNTH_ERROR_EMPTY_CORPUS;
 	}
 
 	// prep things not images
-	prepareSortedOffsets(targetMap, corpusMap, &sortedOffsets); // Depends on image size
+	prepareSortedOffsets(targetMap, corpusMap, memoryPlan.offsetsRadius, &sortedOffsets, arena); // Depends on image size
+	phaseStartTime = traceSpan(&tracer, "prepareSortedOffsets", phaseStartTime);
 	quantizeMetricFuncs(static_cast<float>(parameters.sensitivityToOutliers), static_cast<float>(parameters.mapWeight), corpusTargetMetric, mapMetric);
+	phaseStartTime = traceSpan(&tracer, "quantizeMetricFuncs", phaseStartTime);
+
+	// Incremental: keep prior sources of target points the edit of the mask does not affect
+	if (extras && extras->priorSourceIndices)
+	{
+		guint keptCount = keepPriorSources(&parameters, extras->priorSourceIndices, extras->blendBand,
+			indices, targetMap, corpusMap, &hasValueMap, &sourceOfMap, targetPoints, sortedOffsets);
+		if (stats)
+		{
+			stats->keptCount = keptCount;
+			stats->affectedRadius = affectedRadius(&parameters, sortedOffsets, extras->blendBand);
+		}
+		phaseStartTime = traceSpan(&tracer, "keepPriorSources", phaseStartTime);
+	}
 
 	// Now we need a prng, before order_targetPoints
 	/* Originally: srand(time(0));   But then testing is non-repeatable.
-	TODO the seed should be a hash of the input or a user parameter.
-	Then it would be repeatable, but changeable by the user.
+	The seed is a parameter: repeatable, but changeable by the user.
 	*/
-	prng = g_rand_new_with_seed(1198472);
+	prng = g_rand_new_with_seed(parameters.seed);
+
+	// Incremental resynthesis may have kept every target point: nothing to order or refine
+	if (targetPoints->len)
+	{
+		// Deterministic: not from the PRNG, rand() shared by the process
+		TProbeRandom orderRandom;
+		if (parameters.isDeterministic)
+			startCounterProbeRandom(&orderRandom, parameters.seed, COUNTER_RANDOM_ORDER_PASS, 0);
+		else
+			prepareProbeRandom(&orderRandom, prng);
+		int error = orderTargetPoints(&parameters, targetPoints, &hasValueMap, &orderRandom);
+		// A programming error, but release the run's state as the normal exit does
+		if (error)
+		{
+			releaseArena(arena, ownArena);
+#ifdef SYNTH_USE_GLIB
+			g_rand_free(prng);
+#endif
+			return error;
+		}
+	}
+	phaseStartTime = traceSpan(&tracer, "orderTargetPoints", phaseStartTime);
 
-	int error = orderTargetPoints(&parameters, targetPoints, prng);
-	// A programming error that we don't clean up.
-	if (error) return error;
+	prepareRecentProber(corpusMap, &recentProberMap, arena);  // Must follow prepare_corpus
+	phaseStartTime = traceSpan(&tracer, "prepareRecentProber", phaseStartTime);
 
-	prepareRecentProber(corpusMap, &recentProberMap);  // Must follow prepare_corpus
+	// Optional copy of the corpus for matching.  Freed with this frame.
+	TCorpusTiles corpusTiles;
+	if (parameters.isCorpusTiled)
+	{
+		prepareCorpusTiles(&corpusTiles, indices, corpusMap);
+		traceSpan(&tracer, "prepareCorpusTiles", phaseStartTime);
+	}
 
 	// Preparations done, begin actual synthesis
-	print_processor_time();
+	if (stats) stats->prepareMilliseconds = millisecondsSince(startTime);
 
 	// progress(_("Resynthesizer: synthesizing"));
     
-	refiner(
-		parameters,
-		indices,
-		targetMap,
-		corpusMap,
-		&recentProberMap,
-		&hasValueMap,
-		&sourceOfMap,
-		targetPoints,
-		corpusPoints,
-		sortedOffsets,
-		prng,
-		corpusTargetMetric,
-		mapMetric,
-		progressCallback,
-		contextInfo,
-		cancelFlag
-		);
+	TPreviewer previewer;
+	preparePreviewer(&previewer, extras, indices, targetMap, startTime);
 
-	// Free internal mallocs.
-	// Caller must free the IN pixmaps since the targetMap holds synthesis results
-	free_map(&recentProberMap);
-	free_map(&hasValueMap);
-	free_map(&sourceOfMap);
+	if (targetPoints->len)
+	{
+		refiner(
+			parameters,
+			indices,
+			targetMap,
+			corpusMap,
+			&recentProberMap,
+			&hasValueMap,
+			&sourceOfMap,
+			targetPoints,
+			corpusPoints,
+			sortedOffsets,
+			prng,
+			corpusTargetMetric,
+			mapMetric,
+			selectBestFit(indices, (TImageSynthMatchMetric)parameters.matchMetric, parameters.isCorpusTiled),
+			parameters.isCorpusTiled ? &corpusTiles : NULL,
+			progressCallback,
+			contextInfo,
+			cancelFlag,
+			startTime,
+			stats,
+			&tracer,
+			&previewer
+			);
+	}
 
-	g_array_free(targetPoints, TRUE);
-	g_array_free(corpusPoints, TRUE);
-	g_array_free(sortedOffsets, TRUE);
+	if (extras && (extras->sourceIndices || extras->sourceCoordinates))
+		exportCorrespondence(extras->sourceIndices, extras->sourceCoordinates, targetMap, corpusMap, &sourceOfMap);
+
+	// Free internal mallocs, all in the arena.
+	// Caller must free the IN pixmaps since the targetMap holds synthesis results
+	releaseArena(arena, ownArena);
 
 #ifdef SYNTH_USE_GLIB
 	g_rand_free(prng);
 #endif
 
+	if (stats) stats->milliseconds = millisecondsSince(startTime);
+	finishTracer(&tracer);  // A trace that can't be written is not an error of synthesis
+
 	return 0; // Success, even if canceled
 }
 
@@ -1,4 +1,4 @@
-
+#include "engineExtras.h"
 
 extern int
 engine(
@@ -8,5 +8,33 @@ engine(
   Map* corpusMap,
   void (*progressCallback)(int, void*),   // int percentDone, void *contextInfo
   void *contextInfo,
-  int * cancelFlag
+  int * cancelFlag,
+  TImageSynthExtras* extras               // optional IN/OUT, or NULL
+  );
+
+
+/*
+Shape of a run of the engine, for estimating its memory without allocating.  See memoryPlan.h.
+*/
+typedef struct {
+  guint targetWidth;        // Of the target map (target and context)
+  guint targetHeight;
+  guint corpusWidth;
+  guint corpusHeight;
+  guint depth;              // Of a pixel of the maps, total_bpp
+  guint matchDepth;         // Pixelels matched, img_match_bpp + map_match_bpp
+  guint targetCount;        // Of target points, or a bound
+  guint targetBoundsWidth;  // Of the bounds of the target points, or a bound
+  guint targetBoundsHeight;
+} TEngineMemoryShape;
+
+/*
+Peak bytes the engine allocates for a run of a shape, with the strategies it picks under parameters->maxMemoryBytes.
+Returns IMAGE_SYNTH_ERROR_MEMORY_LIMIT if none fits (and the peak of the least), else IMAGE_SYNTH_SUCCESS.
+*/
+extern int
+engineEstimateMemory(
+  const TImageSynthParameters* parameters,
+  const TEngineMemoryShape* shape,
+  size_t* peakBytes                       // OUT
   );
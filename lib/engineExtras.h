@@ -0,0 +1,208 @@
+/*
+ * Optional inputs and outputs of the engine, beyond the images and the parameters.
+ *
+ * Parameters (engineParams.h) say how to synthesize.
+ * Extras are channels between the caller and a single run of the engine, e.g. statistics.
+ * A caller that wants none passes NULL.
+ * Otherwise, zero the struct and set only the fields wanted.
+ *
+ * Copyright (C) 2010, 2011  Lloyd Konneker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#pragma once
+#ifndef RESYNTH_ENGINE_EXTRAS_H_
+#define RESYNTH_ENGINE_EXTRAS_H_
+
+#include <stdint.h>
+
+#include "imageSynthConstants.h"
+#include "imageSynthArena.h"
+
+
+/* Why the engine stopped making passes over the target. */
+typedef enum ImageSynthTermination
+{
+	IMAGE_SYNTH_TERMINATION_ALL_PASSES,   // Made every pass
+	IMAGE_SYNTH_TERMINATION_FEW_BETTERS,  // Few target pixels got a better source, see IMAGE_SYNTH_TERMINATE_FRACTION
+	IMAGE_SYNTH_TERMINATION_ENERGY,       // Energy decreased little, see parameter energyTerminateFraction
+	IMAGE_SYNTH_TERMINATION_TIME,         // Budget spent, see parameter maxMilliseconds
+	IMAGE_SYNTH_TERMINATION_CANCELED      // Caller set the cancel flag
+} TImageSynthTermination;
+
+
+/*
+ * Statistics of one pass over the target.
+ * Always collected: each thread counts privately and the counts are summed at the end of the pass.
+ */
+typedef struct ImageSynthPassStatsStruct
+{
+	unsigned int targetCount;   // Count of target pixels synthesized
+	unsigned int betters;       // Count of target pixels given a new source
+	/*
+	 * Of betters, by which probe the new source was found:
+	 * heuristic 1 (a neighbor's source, offset) or a random corpus point.
+	 */
+	unsigned int bettersByNeighborsSource;
+	unsigned int bettersByRandom;
+	unsigned int perfectMatches;  // Count of target pixels whose probing ended on a zero patch difference
+	/*
+	 * Sum over target pixels synthesized of their best patch difference.
+	 * Lower is better.  Comparable between passes as a mean per target pixel,
+	 * since later passes synthesize fewer target pixels.
+	 */
+	unsigned long long energy;
+	/*
+	 * After the pass, sum over all target pixels of their latest best patch difference,
+	 * including those not synthesized in the pass,
+	 * and sum of the count of neighbors each difference is over.
+	 * energyTerminateFraction compares their quotient, the energy per matched neighbor.
+	 */
+	unsigned long long targetEnergy;
+	unsigned long long targetNeighbors;
+	unsigned long long probes;  // Count of corpus patches compared with target patches
+	/*
+	 * Probes that quit early, exceeding the best difference so far, by index of the neighbor where they quit.
+	 * Neighbors are nearest first, so low indices mean cheap probes.
+	 * Probes not counted here compared the whole patch.
+	 */
+	unsigned long long earlyOutCount;
+	unsigned long long earlyOuts[IMAGE_SYNTH_MAX_NEIGHBORS];
+	double milliseconds;        // Wall time
+} TImageSynthPassStats;
+
+
+/* Statistics of a run of the engine. */
+typedef struct ImageSynthStatsStruct
+{
+	unsigned int passCount;     // Count of valid elements of passes
+	TImageSynthPassStats passes[IMAGE_SYNTH_MAX_PASSES];
+	TImageSynthTermination termination;
+	unsigned int keptCount;     // Count of target pixels that kept their prior source, see priorSourceIndices
+	unsigned int affectedRadius;  // Target pixels within this distance of a change were resynthesized, see priorSourceIndices
+	double prepareMilliseconds; // Wall time of the engine before the first pass
+	double milliseconds;        // Wall time of the engine, including preparation
+	unsigned long long memoryBytes;  // Estimated peak of the engine's allocations, see maxMemoryBytes
+	unsigned int offsetsRadius;      // Of the offsets searched for neighbors, zero for all (less only under maxMemoryBytes)
+	int isCorpusTiled;               // Whether matched against tiles (parameter isCorpusTiled, unless over maxMemoryBytes)
+} TImageSynthStats;
+
+
+/*
+ * A span of wall time of one phase of the engine.
+ * Phases: prepareTargetPoints, prepareCorpusPoints, prepareSortedOffsets, quantizeMetricFuncs,
+ * keepPriorSources (only if incremental),
+ * orderTargetPoints, prepareRecentProber, then for each pass: pass, and threadSlice per thread.
+ */
+typedef struct ImageSynthTraceSpanStruct
+{
+	const char* name;             // Phase
+	int pass;                     // Index of pass, or -1 for preparation
+	unsigned int thread;          // Index of thread of a threadSlice, else 0
+	double startMicroseconds;     // From the start of the engine
+	double durationMicroseconds;
+} TImageSynthTraceSpan;
+
+/* Called by the engine's calling thread, at the end of each span. */
+typedef void (*TImageSynthTraceCallback)(const TImageSynthTraceSpan* span, void* traceContext);
+
+
+/*
+ * A read-only view of the target during synthesis, for a progressive preview.
+ * Not a copy: the engine's own pixmap of the target image, valid only during the callback.
+ * Pixels are row major, rows unpadded, in the engine's internal format:
+ * bytesPerPixel bytes per pixel (including pad bytes, see prepareImageFormatIndices()), of which bytes colorStart up to colorEnd are the color (as in the image.)
+ */
+typedef struct ImageSynthPreviewStruct
+{
+	const unsigned char* pixels;
+	unsigned int width;
+	unsigned int height;
+	unsigned int bytesPerPixel;
+	unsigned int colorStart;
+	unsigned int colorEnd;
+	/*
+	 * Bounds, inclusive, of the pixels changed since the prior preview (or the start of synthesis.)
+	 * Zero if isAnyChanged is false.
+	 */
+	int isAnyChanged;
+	unsigned int changedLeft;
+	unsigned int changedTop;
+	unsigned int changedRight;
+	unsigned int changedBottom;
+	unsigned int pass;            // Index of the pass just completed
+	double milliseconds;          // From the start of the engine
+} TImageSynthPreview;
+
+/* Called by the engine's calling thread, between passes. */
+typedef void (*TImageSynthPreviewCallback)(const TImageSynthPreview* preview, void* previewContext);
+
+
+typedef struct ImageSynthExtrasStruct
+{
+	/* OUT, or NULL.  Statistics of the run. */
+	TImageSynthStats* stats;
+
+	/* IN, or NULL.  Callback for each span of a trace of the run, passed traceContext. */
+	TImageSynthTraceCallback traceCallback;
+	void* traceContext;
+
+	/*
+	 * IN, or NULL.  Path of a file to write the trace to, in Chrome trace event JSON,
+	 * when the engine finishes synthesis.  Overwritten.
+	 */
+	const char* traceFilePath;
+
+	/*
+	 * OUT, or NULL.  Caller allocated, one element per pixel of the target image (width * height.)
+	 * The correspondence (see correspondence.h): for each target pixel, the linear index (y * corpus width + x)
+	 * of the corpus pixel it was synthesized from, or -1 if not in the target.
+	 * Written when the engine succeeds, even if canceled (then -1 for target pixels not yet synthesized.)
+	 */
+	int32_t* sourceIndices;
+
+	/* OUT, or NULL.  Same, as (x, y) pairs of corpus coordinates, two elements per pixel, or (-1, -1). */
+	int32_t* sourceCoordinates;
+
+	/*
+	 * IN, or NULL.  sourceIndices of a prior run on the same image, for incremental resynthesis
+	 * after an edit of the mask (see incremental.h.)
+	 * Target pixels far from the edit keep their prior source; only the rest are synthesized.
+	 * May be the same array as sourceIndices.
+	 */
+	const int32_t* priorSourceIndices;
+
+	/* IN.  With priorSourceIndices, pixels beyond the patch radius from the edit to also resynthesize, blending. */
+	unsigned int blendBand;
+
+	/*
+	 * IN, or NULL.  Callback for a progressive preview, passed previewContext (see preview.h.)
+	 * Called after the first pass, which fills the target,
+	 * then after each later pass that ends at least previewIntervalMilliseconds after the prior preview.
+	 */
+	TImageSynthPreviewCallback previewCallback;
+	void* previewContext;
+	unsigned int previewIntervalMilliseconds;
+
+	/*
+	 * IN, or NULL.  Arena for the run's state (see imageSynthArena.h), kept by the caller between runs,
+	 * so a long-lived process reuses its memory.  If NULL, the run allocates and frees its own.
+	 */
+	TImageSynthArena* arena;
+
+} TImageSynthExtras;
+
+
+#endif /* RESYNTH_ENGINE_EXTRAS_H_ */
@@ -13,5 +13,13 @@ void setDefaultParams(TImageSynthParameters *param)
 	param->sensitivityToOutliers                = 0.117;
 	param->patchSize                            = 30;
 	param->maxProbeCount                        = 200;
+	param->energyTerminateFraction              = 0;  // Terminate on few betters
+	param->maxMilliseconds                      = 0;  // No time budget
+	param->localityBlockSize                    = 0;  // Random over whole target
+	param->seed                                 = 1198472;
+	param->isDeterministic                      = FALSE;
+	param->matchMetric                          = IMAGE_SYNTH_METRIC_CAUCHY;
+	param->isCorpusTiled                        = FALSE;
+	param->maxMemoryBytes                       = 0;  // No memory budget
 }
 
@@ -27,10 +27,29 @@ typedef enum ImageSynthError
 	/// Input data errors, user error in making selection? returned by inner engine
 	IMAGE_SYNTH_ERROR_EMPTY_TARGET,
 	IMAGE_SYNTH_ERROR_EMPTY_CORPUS,
+
+	/// Programmer error, returned by imageSynthApplyCorrespondence
+	IMAGE_SYNTH_ERROR_CORRESPONDENCE_MISMATCH,
+
+	/// Programmer error, parameter error returned by inner engine
+	IMAGE_SYNTH_ERROR_MATCH_METRIC_RANGE,
+
+	/// Resource limit: no strategy fits in maxMemoryBytes.  Returned before the large allocations.
+	IMAGE_SYNTH_ERROR_MEMORY_LIMIT,
 	
 } TImageSynthError;
 
 
+/* Metric of the difference of a target patch and a corpus patch: how pixelel differences are weighted. */
+typedef enum ImageSynthMatchMetric
+{
+	IMAGE_SYNTH_METRIC_CAUCHY,  // Robust to outliers, see sensitivityToOutliers.  The original metric.
+	IMAGE_SYNTH_METRIC_SAD,     // Sum of absolute differences, L1
+	IMAGE_SYNTH_METRIC_SSD,     // Sum of squared differences, L2
+	IMAGE_SYNTH_METRIC_COUNT
+} TImageSynthMatchMetric;
+
+
 typedef struct ImageSynthParametersStruct
 {
 	/*
@@ -87,6 +106,85 @@ typedef struct ImageSynthParametersStruct
 	 */
 	unsigned int maxProbeCount;
 
+	/*
+	 * Termination of refinement by patch energy.
+	 * The energy of the target after a pass is the sum, over all target pixels, of their latest best patch difference,
+	 * per neighbor matched (later passes match more neighbors than the first.)
+	 * If greater than zero, refinement stops when the energy of the target
+	 * decreases by less than this fraction from the prior pass.
+	 * This replaces the default rule, which stops when few target pixels get a better source,
+	 * except after a pass that increased the energy, when the default rule applies.
+	 * Zero means use the default rule.
+	 */
+	double energyTerminateFraction;
+
+	/*
+	 * Budget of wall time in milliseconds, counted from the start of the engine.
+	 * Anytime synthesis: the engine returns its best result so far when the budget is spent.
+	 * The first pass fills the whole target quickly, with fewer probes,
+	 * and is always completed, so the target is never partially unfilled:
+	 * if the budget is spent, the rest of the target is filled without searching, from the sources of near pixels.
+	 * Later passes refine with full probes until the budget is spent, even in the middle of a pass.
+	 * So the engine can overrun the budget by the preparations not done when the budget is spent
+	 * (reading the image, sorting offsets and ordering the target, not interruptible),
+	 * plus the fill without search, under a microsecond per target pixel left unfilled,
+	 * plus the searches in progress, at most IMAGE_SYNTH_DEADLINE_CHECK_COUNT+1 target pixels per thread.
+	 * Zero means no budget.
+	 */
+	unsigned int maxMilliseconds;
+
+	/*
+	 * Side in pixels of square blocks, for a random order of the target that is local in memory.
+	 * Only for random orders, matchContextType 0 and 1.
+	 * The target is synthesized block by block, blocks in a randomized order along a Hilbert curve,
+	 * and randomly within each block, so that reading neighbors of consecutive target pixels hits cache.
+	 * Typically 8 to 32.
+	 * Zero means the original order: random over the whole target.
+	 */
+	unsigned int localityBlockSize;
+
+	/*
+	 * Seed of pseudo random numbers: the order of the target and the random probes of the corpus.
+	 * The same seed and input give the same result only if synthesis is deterministic.
+	 */
+	unsigned int seed;
+
+	/*
+	 * Boolean.  Whether the result must depend only on the input, the parameters and the seed.
+	 * Threaded synthesis otherwise depends on the timing of threads.
+	 * Deterministic synthesis still uses all threads, synthesizing the target in phases,
+	 * and gives the same result whatever the count of threads.  See phasedSynthesis.h.
+	 * The result is slightly different from non-deterministic synthesis.
+	 * If a time budget (maxMilliseconds) is spent, the result depends on timing regardless.
+	 */
+	int isDeterministic;
+
+	/*
+	 * Metric of the difference of color between patches, a TImageSynthMatchMetric.
+	 * Cauchy, the default, tolerates a few very different pixelels in a patch (outliers.)
+	 * SAD and SSD are arithmetic instead of a table lookup per pixelel: faster, for previews and bulk fills.
+	 * All are scaled alike, so mapWeight weighs maps the same, and a clipped neighbor weighs the same.
+	 */
+	int matchMetric;
+
+	/*
+	 * Boolean.  Whether to match patches against a copy of the corpus in small square tiles,
+	 * packing only the pixelels matched.  See corpusTiles.h.
+	 * For a corpus much larger than the processor's cache: faster, at the cost of the copy's memory.
+	 * The result is the same.
+	 */
+	int isCorpusTiled;
+
+	/*
+	 * Budget of memory in bytes, for the peak of what the engine allocates (and imageSynth(), its copies of the image.)
+	 * Over budget, the engine picks strategies of less memory: first without the tiled copy of the corpus,
+	 * then with fewer offsets to search for neighbors (see prepareSortedOffsets()), which can change the result.
+	 * If none fits, it returns IMAGE_SYNTH_ERROR_MEMORY_LIMIT without allocating them.
+	 * See imageSynthEstimateMemory() for the estimate.
+	 * Zero means no budget.
+	 */
+	unsigned long long maxMemoryBytes;
+
 } TImageSynthParameters;
 
 
@@ -24,95 +24,33 @@
 #define RESYNTH_ENGINE_TYPES_H_
 
 
-typedef struct SortElementStruct 
-{
-	Coordinates   targetPoint;
-	gfloat        proportionToCenter;
-} TSortElementStruct;
-
-
 gboolean equal_points(const Coordinates& a, const Coordinates& b)
 {
 	return (a.x == b.x) && (a.y == b.y);
 }
 
 /*
- * Compare funcs for sorting.
- * !!! Note return a gint (-1, 0, 1) rather than a bool as for c++
- * Returns -1 for first arg is less than second arg, 0 for equal, 1 if first arg is greater than second arg
- * Also, for c++ vector sort, take a Coordinates, not a *Coordinates
- */
-typedef gint CompareResult;
-
-
-/*
- * Convert bool to a qsort style compare result required by glib g_array_sort().
- * Note that we never return 0 for equal,
- * but that should not hurt the sort.
+ * Sort keys for offsets, e.g. from the center of the target.  See sortPoints.h.
+ * Formerly qsort compare funcs (lessCartesian, lessHorizontal, ...) that computed the key at every compare.
  */
-static inline CompareResult to_sort_result(gboolean value)
-{
-	return ((value == 1) ? -1 : 1);  // equality not a case
-}
-
-
-/* !!! Note you can't use the not operator (!) on a CompareResult */
-static inline CompareResult to_invert_sort_result(CompareResult value)
-{
-	return ((value == 1) ? -1 : 1);  // equality not a case
-}
-
-
-/*
- * These functions cannot be inline because they are passed to sort.
- * Besides, the sorting is not a bottleneck.
- */
-
-/* less/more 2D distance: from center for offsets: x^2 + y^2 */
-CompareResult lessCartesian(const Coordinates *a, const Coordinates *b)
-{
-	return to_sort_result((a->y * a->y) + (a->x * a->x) < (b->y * b->y) + (b->x * b->x));
-}
-
-CompareResult moreCartesian(const Coordinates *a, const Coordinates *b)
-{
-	return to_invert_sort_result(lessCartesian(a, b));
-}
-
-/*
- * less/more proportional distance along ray to the center
- * !!! Requires a sort element with that value
- */
-CompareResult lessInward(const TSortElementStruct *a, const TSortElementStruct *b)
-{
-	return to_sort_result(a->proportionToCenter < b->proportionToCenter);
-}
-
-CompareResult moreInward(const TSortElementStruct *a, const TSortElementStruct *b)
-{
-	return to_invert_sort_result(lessInward(a, b));
-}
-
-/* less/more horizontal distance: from center for offsets */
-CompareResult lessHorizontal(const Coordinates *a, const Coordinates *b)
-{
-	return to_sort_result((a->x * a->x) < (b->x * b->x));
-}
+typedef guint(*SortKeyFunc)(Coordinates offset);
 
-CompareResult moreHorizontal(const Coordinates *a, const Coordinates *b)
+/* 2D distance (squared): x^2 + y^2 */
+static inline guint cartesianKey(Coordinates offset)
 {
-	return to_invert_sort_result(lessHorizontal(a, b));
+	return static_cast<guint>(offset.x * offset.x) + static_cast<guint>(offset.y * offset.y);
 }
 
-CompareResult lessVertical(const Coordinates *a, const Coordinates *b)
+/* horizontal distance (squared) */
+static inline guint horizontalKey(Coordinates offset)
 {
-	/* less vertical distance: from center for offsets */
-	return to_sort_result((a->y * a->y) < (b->y * b->y));
+	return static_cast<guint>(offset.x * offset.x);
 }
 
-CompareResult moreVertical(const Coordinates *a, const Coordinates *b)
+/* vertical distance (squared) */
+static inline guint verticalKey(Coordinates offset)
 {
-	return to_invert_sort_result(lessVertical(a, b));
+	return static_cast<guint>(offset.y * offset.y);
 }
 
 /*
@@ -143,12 +81,60 @@ typedef struct
 } Bounds;
 
 
+/* Bounds of no points. */
+static inline Bounds emptyBounds()
+{
+	Bounds bounds = { G_MAXINT, G_MAXINT, -1, -1 };
+	return bounds;
+}
+
+
+static inline gboolean isEmptyBounds(Bounds bounds)
+{
+	return bounds.lrx < bounds.ulx;
+}
+
+
+/* Extend bounds to include a point. */
+static inline void extendBounds(Bounds* bounds, Coordinates point)
+{
+	bounds->ulx = MIN(bounds->ulx, point.x);
+	bounds->uly = MIN(bounds->uly, point.y);
+	bounds->lrx = MAX(bounds->lrx, point.x);
+	bounds->lry = MAX(bounds->lry, point.y);
+}
+
+
+static inline Bounds unionBounds(Bounds a, Bounds b)
+{
+	Bounds bounds = { MIN(a.ulx, b.ulx), MIN(a.uly, b.uly), MAX(a.lrx, b.lrx), MAX(a.lry, b.lry) };
+	return bounds;
+}
+
+
 
 
 /*
  * Class 1D array (vector or sequence) of Coordinates.
+ * A direct pointer to the points, whose capacity is fixed when created (see new_point_vector()):
+ * it never reallocates, so pointers to its points stay valid.
  */
-typedef GArray * PointVector;
+typedef struct
+{
+	Coordinates* data;
+	guint len;
+	guint capacity;
+} TPointVectorStruct;
+
+typedef TPointVectorStruct * PointVector;
+
+
+/* Append a point.  The vector must have room: it doesn't grow. */
+static inline void append_point(PointVector vector, Coordinates point)
+{
+	g_assert(vector->len < vector->capacity);
+	vector->data[vector->len++] = point;
+}
 
 
 /** Get bounds of vector of points. */
@@ -160,7 +146,7 @@ Bounds get_bounds(PointVector points, guint size)
 	for (i = 0; i < size; i++)
 	{
 		// c++ coords = points[i];
-		Coordinates coords = g_array_index(points, Coordinates, i);
+		Coordinates coords = points->data[i];
 		bounds.ulx = MIN(bounds.ulx, coords.x);
 		bounds.uly = MIN(bounds.uly, coords.y);
 		bounds.lrx = MAX(bounds.lrx, coords.x);
@@ -191,9 +177,9 @@ inline void swap_vector_elements(PointVector vector, guint size, guint i, guint
 	g_assert(i < size);
 	g_assert(j < size);
 
-	temp = g_array_index(vector, Coordinates, i);
-	g_array_index(vector, Coordinates, i) = g_array_index(vector, Coordinates, j);
-	g_array_index(vector, Coordinates, j) = temp;
+	temp = vector->data[i];
+	vector->data[i] = vector->data[j];
+	vector->data[j] = temp;
 }
 
 
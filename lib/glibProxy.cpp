@@ -17,8 +17,11 @@
 #endif
 
 
-#include <stdlib.h>   // size_t, calloc
-#include <string.h>   // memcpy
+#include <stdlib.h>   // size_t, aligned_alloc
+#include <string.h>   // memcpy, memset
+#ifdef _MSC_VER
+#include <malloc.h>   // _aligned_malloc
+#endif
 #include "glibProxy.h"
 
 /************************************************************************/
@@ -49,13 +52,48 @@ guint s_rand_int_range(GRand * prng, guint lowerBound, guint upperBound)
 /************************************************************************/
 /* GArray Definitions                                                   */
 /************************************************************************/
+
+/*
+The data of an array is aligned on a cache line,
+so the pixels of a pixmap, padded to a power of two, are aligned for vector loads.
+See new_pixmap().
+*/
+#define G_ARRAY_ALIGN 64
+
+static void* alignedCalloc(size_t count, size_t size)
+{
+	// aligned_alloc requires a size that is a nonzero multiple of the alignment
+	size_t bytes = (count * size + G_ARRAY_ALIGN - 1) & ~(size_t)(G_ARRAY_ALIGN - 1);
+	void* data;
+
+	if (!bytes) bytes = G_ARRAY_ALIGN;
+#ifdef _MSC_VER
+	data = _aligned_malloc(bytes, G_ARRAY_ALIGN);
+#else
+	data = aligned_alloc(G_ARRAY_ALIGN, bytes);
+#endif
+	if (data) memset(data, 0, bytes);
+	return data;
+}
+
+
+static void alignedFree(void* data)
+{
+#ifdef _MSC_VER
+	_aligned_free(data);
+#else
+	free(data);
+#endif
+}
+
+
 GArray* GArrayAllocate(gboolean zero_terminated,
 	gboolean clear,
 	guint type_size,
 	guint reserved_size)
 {
 	GRealArray *array = reinterpret_cast<GRealArray*>(calloc(1, sizeof(GRealArray)));
-	array->data = reinterpret_cast<unsigned char*>(calloc(reserved_size, type_size));
+	array->data = reinterpret_cast<unsigned char*>(alignedCalloc(reserved_size, type_size));
 	array->len = 0;
 	array->capacity = reserved_size;
 	array->type_size = type_size;
@@ -69,7 +107,7 @@ void GArrayFree(GArray * array, int cascade)
 	// Ignore cascade: always free both
 	assert(array->data);
 	assert(array);
-	free(array->data);
+	alignedFree(array->data);
 	free(array);  // free GRealArray
 	array = NULL;
 }
@@ -84,13 +122,13 @@ GArray* GArrayAppendVal(GArray *array, ConstVoidPtr data, int len)
 	{
 		guint newCapacity = realArr->capacity * 2;
 		GRealArray *newArray = reinterpret_cast<GRealArray*>(calloc(1, sizeof(GRealArray)));
-		newArray->data = reinterpret_cast<unsigned char*>(calloc(newCapacity, realArr->type_size));
+		newArray->data = reinterpret_cast<unsigned char*>(alignedCalloc(newCapacity, realArr->type_size));
 		newArray->len = realArr->len;
 		newArray->capacity = newCapacity;
 		newArray->type_size = realArr->type_size;
 
 		memcpy(newArray->data, realArr->data, realArr->type_size * realArr->len);
-		free(realArr->data);
+		alignedFree(realArr->data);
 		free(realArr);
 		realArr = newArray;
 		array = (GArray*)realArr;
@@ -15,6 +15,7 @@
 #define gint32 int
 #define gushort short unsigned int
 #define gulong long unsigned int
+#define guint64 unsigned long long
 
 #define gfloat float
 #define gdouble double
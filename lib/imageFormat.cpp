@@ -134,9 +134,10 @@ prepareImageFormatIndices(
   [0]                         mask pixelel
   [1,colorEndBip)           image color pixelels, up to 3 (RGB)
   optional alpha byte         
-  [map_start_bip, total_bpp)  map color pixelels
+  [map_start_bip, map_end_bip)  map color pixelels
   optional map alpha byte     !!! discard
-  [0, total_bpp)              entire pixel
+  [map_end_bip, total_bpp)    pad, zero, never compared
+  [0, total_bpp)              entire pixel, a power of two pixelels
   
   [1, colorEndBip)  color pixelels compared
   [map_start_bip, map_end_bip)      map pixelels compared
@@ -148,14 +149,17 @@ prepareImageFormatIndices(
   2 G                               G                                 G
   3 B                               B                                 B
   4 A alpha_bip, colorEndBip      W colorEndBip, map_start_bip   4  color_end, map_start, map_end, total
-  5 R map_start_bip                5  map_end_bip, total_bpp
-  6 G
-  7 B
-  8   map_end_bip, total_bpp
+  5 R map_start_bip                5  map_end_bip
+  6 G                              6  pad
+  7 B                              7  pad
+  8   map_end_bip, total_bpp       8  total_bpp
   
   !!! alpha_bip is undefined unless is_alpha_corpus or is_alpha_target
   
-  TODO Possibly pad pixel to size 8 for memory alignment, especially if vectorized.
+  The pixel is padded to a power of two pixelels: 2, 4, or 8 (MAX_IMAGE_SYNTH_BPP.)
+  With the alignment of pixmaps (see new_pixmap()) every pixel is then aligned to its size,
+  so vectorized matching loads whole pixels, aligned, without special cases per format.
+  The pad costs memory: e.g. RGBA grows from 5 to 8 pixelels.
   */
 
   /* !!! Not drawable->bpp because it includes other channels. */
@@ -197,7 +201,10 @@ prepareImageFormatIndices(
   //map_end_bip   = map_start_bip + map_match_bpp;
   //total_bpp  = map_end_bip;
   indices->map_end_bip   = indices->map_start_bip + indices->map_match_bpp;
-  indices->total_bpp  = indices->map_end_bip;
+  // Pad to a power of two
+  indices->total_bpp = 2;
+  while (indices->total_bpp < indices->map_end_bip)
+    indices->total_bpp *= 2;
   
   indices->isAlphaTarget = is_alpha_target;
   indices->isAlphaSource = is_alpha_source;
@@ -217,8 +224,8 @@ prepareDefaultFormatIndices(
   For testing.
   
   Engine internal pixel is:
-  MRGBA
-  012345
+  MRGBA...
+  012345  8
   */
 {
 // !!! MASK_PIXELEL_INDEX is a constant (0); mask pixelel is first, always.
@@ -230,7 +237,7 @@ formatIndices->map_match_bpp = 0;  // No map pixelels
 formatIndices->map_start_bip = 5;
 formatIndices->map_end_bip = 5;
 
-formatIndices->total_bpp = 5;
+formatIndices->total_bpp = 8;  // Padded to a power of two
 
 formatIndices->isAlphaTarget = TRUE; // Does target have alpha?
 formatIndices->isAlphaSource = TRUE;
@@ -36,6 +36,8 @@ To make:
 */
 #include <stddef.h>  // size_t
 
+#include "buildSwitches.h"  // THREAD_LIMIT
+
 // Non code defining, true headers: macros, declarations, and static inline functions
 #include "imageBuffer.h"
 #include "imageSynthConstants.h"
@@ -48,30 +50,151 @@ To make:
 #include "imageFormatIndicies.h"
 #include "map.h"  // header for mapOps.h included by engine.c
 #include "engineParams.h" // engineParams.c
+#include "engineExtras.h"
 #include "engine.h" // engine.c
+#include "imageSynth.h"  // TImageSynthMaskBounds
 
 
 // Code defining, could be compiled separately
 #include "mapIndex.h" // inline funcs depending on map.h
-#include "adaptSimple.h"  // requires mapIndex.h
+#include "rowBands.h"
+#include "adaptSimple.h"  // requires mapIndex.h, rowBands.h
+
 
 
 
+/*
+Memory of the simple API: the two adapted pixmaps (target and corpus), then the engine's peak.
+The mask bytemaps while adapting are less than the engine's own maps.
+Given only bounds of the mask, targetCount is their area.
+*/
+static int
+estimateSimpleMemory(
+  guint width,
+  guint height,
+  TFormatIndices* formatIndices,
+  guint targetCount,
+  guint targetRows,
+  const TImageSynthParameters* parameters,
+  size_t* adaptedBytes,  // OUT
+  size_t* peakBytes      // OUT
+  )
+{
+  TImageSynthParameters engineParameters = *parameters;
+  TEngineMemoryShape shape = {
+    width, height,
+    width, height,  // The corpus is the same image
+    formatIndices->total_bpp,
+    static_cast<guint>(formatIndices->img_match_bpp + formatIndices->map_match_bpp),
+    targetCount,
+    width,  // As the engine bounds it, see engine()
+    targetRows
+  };
+  size_t enginePeakBytes;
+  int error;
+
+  // See new_map_data()
+  *adaptedBytes = 2 * (((size_t)width * height * formatIndices->total_bpp + IMAGE_SYNTH_PIXMAP_TAIL_PAD
+    + IMAGE_SYNTH_PIXMAP_ALIGN - 1) & ~(size_t)(IMAGE_SYNTH_PIXMAP_ALIGN - 1));
+  if (engineParameters.maxMemoryBytes)
+  {
+    if (engineParameters.maxMemoryBytes <= *adaptedBytes)
+      engineParameters.maxMemoryBytes = 1;  // Nothing fits
+    else
+      engineParameters.maxMemoryBytes -= *adaptedBytes;
+  }
+  error = engineEstimateMemory(&engineParameters, &shape, &enginePeakBytes);
+  *peakBytes = *adaptedBytes + enginePeakBytes;
+  return error;
+}
+
 
 extern int
-imageSynth(
+imageSynthEstimateMemory(
+  unsigned int width,
+  unsigned int height,
+  TImageFormat imageFormat,
+  const TImageSynthMaskBounds* maskBounds,  // or NULL for the whole image
+  const TImageSynthParameters* parameters,  // or NULL to use defaults
+  size_t* peakBytes                         // OUT
+  )
+{
+  TImageSynthParameters defaultParameters;
+  TFormatIndices formatIndices;
+  size_t adaptedBytes;
+  guint boundsWidth = width;
+  guint boundsHeight = height;
+  int error;
+
+  if (!parameters) {
+    setDefaultParams(&defaultParameters);
+    parameters = &defaultParameters;
+    }
+  error = prepareImageFormatIndicesFromFormatType(&formatIndices, imageFormat);
+  if ( error ) return error;
+  if (maskBounds) {
+    boundsWidth = MIN(maskBounds->width, width);
+    boundsHeight = MIN(maskBounds->height, height);
+    }
+  if (!boundsWidth || !boundsHeight)
+    return IMAGE_SYNTH_ERROR_EMPTY_TARGET;
+
+  return estimateSimpleMemory(width, height, &formatIndices, boundsWidth * boundsHeight, boundsHeight,
+    parameters, &adaptedBytes, peakBytes);
+}
+
+
+/*
+Count of the selected pixels of a mask, and the rows they span.
+Only under a memory budget: admission before adapting.
+*/
+static guint
+countMaskSelection(
+  ImageBuffer * mask,
+  guint* rows  // OUT
+  )
+{
+  guint count = 0;
+  guint firstRow = mask->height;
+  guint endRow = 0;
+  guint row;
+  guint col;
+
+  for (row = 0; row < mask->height; row++)
+  {
+    const guchar * maskRow = &mask->data[(size_t)row * mask->rowBytes];
+    guint rowCount = 0;
+
+    for (col = 0; col < mask->width; col++)
+      rowCount += (maskRow[col] != MASK_UNSELECTED);
+    if (rowCount)
+    {
+      if (firstRow > row) firstRow = row;
+      endRow = row + 1;
+    }
+    count += rowCount;
+  }
+  *rows = count ? endRow - firstRow : 0;
+  return count;
+}
+
+
+extern int
+imageSynthWithExtras(
   ImageBuffer * imageBuffer,  // IN/OUT RGBA four Pixelels
   ImageBuffer * mask,         // IN one mask Pixelel
   TImageFormat imageFormat,
   TImageSynthParameters* parameters,  // or NULL to use defaults
   void (*progressCallback)(int, void*),   // int percentDone, void *contextInfo
   void *contextInfo,
-  int *cancelFlag // flag to check periodically for abort
+  int *cancelFlag, // flag to check periodically for abort
+  TImageSynthExtras* extras  // IN/OUT or NULL, see engineExtras.h
   )
 {
   Map targetMap;
   Map corpusMap;
   TFormatIndices formatIndices;
+  TImageSynthParameters engineParameters;
   int error;
   
   // Sanity: mask and imageBuffer same dimensions
@@ -88,21 +211,39 @@ imageSynth(
   error = prepareImageFormatIndicesFromFormatType(&formatIndices, imageFormat);
   if ( error ) return error;
   
+  engineParameters = *parameters;
+  if (parameters->maxMemoryBytes) {
+    // Fail fast, before adapting.  The engine gets the budget less the adapted pixmaps.
+    size_t adaptedBytes;
+    size_t peakBytes;
+    guint targetRows;
+    guint targetCount = countMaskSelection(mask, &targetRows);
+
+    if (!targetCount)
+      return IMAGE_SYNTH_ERROR_EMPTY_TARGET;
+    error = estimateSimpleMemory(imageBuffer->width, imageBuffer->height, &formatIndices, targetCount, targetRows,
+      parameters, &adaptedBytes, &peakBytes);
+    if ( error ) return error;
+    engineParameters.maxMemoryBytes -= adaptedBytes;
+    }
+  
   // Adapt: put (imageBuffer, mask) into pixmaps etc.
   adaptSimpleAPI(imageBuffer, mask, 
     &targetMap,
     &corpusMap,
-    countPixelelsPerPixelForFormat(imageFormat)
+    countPixelelsPerPixelForFormat(imageFormat),
+    formatIndices.total_bpp
     );
   
   error = engine(
-    *parameters,
+    engineParameters,
     &formatIndices, 
     &targetMap, 
     &corpusMap,
     progressCallback,
     contextInfo,
-    cancelFlag
+    cancelFlag,
+    extras
     );
   
   if (! error && ! (*cancelFlag))
@@ -137,3 +278,18 @@ imageSynth(
 }
 
 
+extern int
+imageSynth(
+  ImageBuffer * imageBuffer,  // IN/OUT RGBA four Pixelels
+  ImageBuffer * mask,         // IN one mask Pixelel
+  TImageFormat imageFormat,
+  TImageSynthParameters* parameters,  // or NULL to use defaults
+  void (*progressCallback)(int, void*),   // int percentDone, void *contextInfo
+  void *contextInfo,
+  int *cancelFlag // flag to check periodically for abort
+  )
+{
+  return imageSynthWithExtras(imageBuffer, mask, imageFormat, parameters,
+    progressCallback, contextInfo, cancelFlag,
+    (TImageSynthExtras*) NULL);
+}
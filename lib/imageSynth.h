@@ -26,8 +26,9 @@ Header for the simple API to libresynthesizer
 #include "imageBuffer.h"
 #include "imageFormat.h"
 #include "engineParams.h"
+#include "engineExtras.h"
 
-// Signature of the only simple API function
+// Signature of the simple API function
 int
 imageSynth(
   ImageBuffer * imageBuffer,  // IN/OUT RGBA Pixels described by imageFormat
@@ -38,3 +39,41 @@ imageSynth(
   void *contextInfo,	// opaque to engine, passed in progressCallback
   int *cancelFlag		// polled by engine: engine quits if ever becomes True
   );
+
+// Same, with optional extras (e.g. statistics) or NULL
+int
+imageSynthWithExtras(
+  ImageBuffer * imageBuffer,
+  ImageBuffer * mask,
+  TImageFormat imageFormat,
+  TImageSynthParameters* parameters,
+  void (*progressCallback)(int, void*),
+  void *contextInfo,
+  int *cancelFlag,
+  TImageSynthExtras* extras   // IN/OUT or NULL
+  );
+
+// Bounds of the selected (nonzero) pixels of a mask
+typedef struct {
+  unsigned int x;
+  unsigned int y;
+  unsigned int width;
+  unsigned int height;
+} TImageSynthMaskBounds;
+
+/*
+Peak bytes imageSynth() allocates for an image of the dimensions and format, and a mask within bounds,
+without allocating: to admit a job, or to choose parameters->maxMemoryBytes.
+Not counting the caller's imageBuffer and mask.
+Returns IMAGE_SYNTH_ERROR_MEMORY_LIMIT if it doesn't fit in parameters->maxMemoryBytes, else IMAGE_SYNTH_SUCCESS
+(or an error of the format.)
+*/
+int
+imageSynthEstimateMemory(
+  unsigned int width,
+  unsigned int height,
+  TImageFormat imageFormat,
+  const TImageSynthMaskBounds* maskBounds,  // or NULL for the whole image
+  const TImageSynthParameters* parameters,  // or NULL to use defaults
+  size_t* peakBytes                         // OUT
+  );
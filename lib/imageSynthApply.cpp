@@ -0,0 +1,156 @@
+/*
+Applying a correspondence.  See imageSynthApply.h.
+
+A gather: a copy from scattered sources.
+But synthesis copies patches: neighboring target pixels often have neighboring sources.
+So a row of the correspondence is copied in runs of consecutive sources,
+each run one memcpy per master row, which the C library vectorizes;
+a run of one pixel is a short copy of scale * bytesPerPixel bytes.
+
+Bands of rows go to threads, that write disjoint rows of the target.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <stddef.h>  // size_t
+#include <stdint.h>
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include "buildSwitches.h"  // THREAD_LIMIT
+#include "engineParams.h"   // error codes
+#include "imageSynthApply.h"
+
+
+typedef struct ApplyArgsStruct
+{
+  const int32_t* sourceIndices;
+  unsigned int proxyWidth;
+  unsigned int proxyCorpusWidth;
+  unsigned int scale;
+  const ImageBuffer* source;
+  ImageBuffer* target;
+  size_t pixelBytes;     // bytes of a proxy pixel's block in one master row: scale * bytesPerPixel
+} TApplyArgs;
+
+
+/* Whether every index is in the source. */
+static int
+isCorrespondenceInSource(
+  const int32_t* sourceIndices,
+  size_t count,
+  unsigned int proxyCorpusWidth,
+  unsigned int proxyCorpusHeight)
+{
+  size_t i;
+  int64_t limit = (int64_t)proxyCorpusWidth * proxyCorpusHeight;
+
+  for (i = 0; i < count; i++)
+    if (sourceIndices[i] >= limit || sourceIndices[i] < -1)
+      return 0;
+  return 1;
+}
+
+
+/* Gather master rows of proxy rows [startRow, endRow). */
+static void
+applyRows(const TApplyArgs* args, unsigned int startRow, unsigned int endRow)
+{
+  unsigned int proxyRow;
+
+  for (proxyRow = startRow; proxyRow < endRow; proxyRow++)
+  {
+    const int32_t* indices = &args->sourceIndices[(size_t)proxyRow * args->proxyWidth];
+    unsigned int x = 0;
+
+    while (x < args->proxyWidth)
+    {
+      int32_t index = indices[x];
+      unsigned int runLength = 1;
+      unsigned int sourceX;
+      unsigned int sourceY;
+      unsigned int dy;
+
+      if (index < 0)
+      {
+        x++;
+        continue;
+      }
+      sourceX = index % args->proxyCorpusWidth;
+      sourceY = index / args->proxyCorpusWidth;
+
+      // Extend the run while sources are consecutive in the same row of the corpus
+      while (x + runLength < args->proxyWidth
+        && indices[x + runLength] == index + (int32_t)runLength
+        && sourceX + runLength < args->proxyCorpusWidth)
+        runLength++;
+
+      for (dy = 0; dy < args->scale; dy++)
+        memcpy(
+          args->target->data + ((size_t)proxyRow * args->scale + dy) * args->target->rowBytes + x * args->pixelBytes,
+          args->source->data + ((size_t)sourceY * args->scale + dy) * args->source->rowBytes + sourceX * args->pixelBytes,
+          runLength * args->pixelBytes);
+      x += runLength;
+    }
+  }
+}
+
+
+int
+imageSynthApplyCorrespondence(
+  const int32_t* sourceIndices,
+  unsigned int proxyWidth,
+  unsigned int proxyHeight,
+  unsigned int proxyCorpusWidth,
+  unsigned int scale,
+  const ImageBuffer* source,
+  ImageBuffer* target,
+  unsigned int bytesPerPixel
+  )
+{
+  TApplyArgs args;
+  unsigned int threadCount;
+  unsigned int threadIndex;
+  std::vector<std::thread> threads;
+
+  if (scale == 0 || proxyCorpusWidth == 0
+    || target->width != proxyWidth * scale || target->height != proxyHeight * scale
+    || source->width < proxyCorpusWidth * scale
+    || !isCorrespondenceInSource(sourceIndices, (size_t)proxyWidth * proxyHeight, proxyCorpusWidth, source->height / scale))
+    return IMAGE_SYNTH_ERROR_CORRESPONDENCE_MISMATCH;
+
+  args.sourceIndices = sourceIndices;
+  args.proxyWidth = proxyWidth;
+  args.proxyCorpusWidth = proxyCorpusWidth;
+  args.scale = scale;
+  args.source = source;
+  args.target = target;
+  args.pixelBytes = (size_t)scale * bytesPerPixel;
+
+  threadCount = (proxyHeight < THREAD_LIMIT ? proxyHeight : THREAD_LIMIT);
+  for (threadIndex = 1; threadIndex < threadCount; threadIndex++)
+    threads.push_back(std::thread(applyRows, &args,
+      threadIndex * proxyHeight / threadCount, (threadIndex + 1) * proxyHeight / threadCount));
+  // The calling thread does the first band
+  if (threadCount)
+    applyRows(&args, 0, proxyHeight / threadCount);
+  for (threadIndex = 0; threadIndex < threads.size(); threadIndex++)
+    threads[threadIndex].join();
+
+  return IMAGE_SYNTH_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/*
+Header for applying a correspondence: render a target by gathering from a source, without synthesis.
+
+Synthesis searches; its result is the correspondence (see TImageSynthExtras sourceIndices):
+for each target pixel, which corpus pixel its color came from.
+Applying the correspondence to another image of the same scene only gathers pixels, at the cost of a copy:
+- other layers (normal maps, depth)
+- a master of higher bit depth, e.g. 16 bits per channel
+- a master of higher resolution: synthesize on a proxy scaled down by an integer factor,
+  then render the master, each proxy pixel a block of scale x scale master pixels,
+  from the corresponding block of the master corpus.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __SYNTH_IMAGE_SYNTH_APPLY_H__
+#define __SYNTH_IMAGE_SYNTH_APPLY_H__
+
+#include <stddef.h>  // size_t
+#include <stdint.h>
+
+#include "imageBuffer.h"
+
+/*
+Gather target pixels from the source, by a correspondence.
+
+sourceIndices: proxyWidth * proxyHeight linear indices (y * proxyCorpusWidth + x) into the proxy corpus,
+  or -1 for a pixel not synthesized, which stays as is in the target.
+  As exported by the engine, where the proxy corpus is the proxy image for the simple API.
+scale: master pixels per proxy pixel, horizontally and vertically; 1 for the same resolution.
+source: the master corpus, at least proxyCorpusWidth * scale wide,
+  and tall enough for every index: rows of the proxy corpus times scale.
+target: the master target, proxyWidth * scale wide and proxyHeight * scale tall.
+  May be the same image as source, if no target pixel is a source pixel (as for the simple API.)
+bytesPerPixel: of both source and target, any pixel format, e.g. 8 for RGBA of 16 bits per channel.
+
+Returns IMAGE_SYNTH_ERROR_CORRESPONDENCE_MISMATCH, and writes nothing,
+if the dimensions disagree or an index is outside the source.
+Rows are divided among threads.
+*/
+int
+imageSynthApplyCorrespondence(
+  const int32_t* sourceIndices,   // IN
+  unsigned int proxyWidth,
+  unsigned int proxyHeight,
+  unsigned int proxyCorpusWidth,
+  unsigned int scale,
+  const ImageBuffer* source,      // IN
+  ImageBuffer* target,            // IN/OUT
+  unsigned int bytesPerPixel
+  );
+
+#endif /* __SYNTH_IMAGE_SYNTH_APPLY_H__ */
@@ -0,0 +1,240 @@
+/*
+Arena of the engine's per-run state.  See imageSynthArena.h.
+
+A list of blocks, allocation bumps an offset in the last block.
+A request that doesn't fit starts a new block at least as large as all the prior blocks,
+so a run needs few blocks, and after a reset, one.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <stddef.h>  // size_t
+#include <stdlib.h>  // aligned_alloc
+
+#include <vector>
+
+#ifdef _MSC_VER
+#include <malloc.h>  // _aligned_malloc
+#endif
+#ifdef __linux__
+#include <sys/mman.h>  // madvise
+#endif
+
+#include "imageSynthArena.h"
+
+
+// Least size of a block
+#define ARENA_MIN_BLOCK_BYTES (1 << 20)
+// Size and alignment of a (transparent) huge page, on x86-64 and most aarch64 Linux
+#define ARENA_HUGE_PAGE_BYTES (2 << 20)
+
+
+typedef struct {
+	char* data;
+	size_t size;
+	size_t used;
+} TArenaBlock;
+
+struct ImageSynthArenaStruct
+{
+	int isHugePages;
+	std::vector<TArenaBlock> blocks;  // Allocation is from the last
+};
+
+
+static size_t roundUp(size_t bytes, size_t alignment)
+{
+	return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+
+static void* allocateAligned(size_t alignment, size_t size)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(size, alignment);
+#else
+	// aligned_alloc requires a size that is a multiple of the alignment
+	return aligned_alloc(alignment, roundUp(size, alignment));
+#endif
+}
+
+
+static void freeAligned(void* memory)
+{
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+
+static size_t blockAlignment(int isHugePages, size_t size)
+{
+	return (isHugePages && size >= ARENA_HUGE_PAGE_BYTES) ? ARENA_HUGE_PAGE_BYTES : IMAGE_SYNTH_ARENA_ALIGN;
+}
+
+
+/* A block of at least size bytes.  Returns its data, or NULL, and its size, rounded up. */
+static char* allocateBlock(int isHugePages, size_t size, size_t* blockSize)
+{
+	size_t alignment = blockAlignment(isHugePages, size);
+	char* data;
+
+	*blockSize = roundUp(size, alignment);
+	data = static_cast<char*>(allocateAligned(alignment, *blockSize));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	// Only a hint: without transparent huge pages, the block is ordinary pages
+	if (data && alignment == ARENA_HUGE_PAGE_BYTES)
+		madvise(data, *blockSize, MADV_HUGEPAGE);
+#endif
+	return data;
+}
+
+
+static void freeBlock(TArenaBlock* block)
+{
+	freeAligned(block->data);
+}
+
+
+void*
+imageSynthAllocateAligned(size_t bytes)
+{
+	return allocateAligned(IMAGE_SYNTH_ARENA_ALIGN, bytes ? bytes : 1);
+}
+
+
+void
+imageSynthFreeAligned(void* memory)
+{
+	freeAligned(memory);
+}
+
+
+TImageSynthArena*
+newImageSynthArena(int isHugePages)
+{
+	TImageSynthArena* arena = new TImageSynthArena;
+	arena->isHugePages = isHugePages;
+	return arena;
+}
+
+
+void
+freeImageSynthArena(TImageSynthArena* arena)
+{
+	size_t i;
+
+	for (i = 0; i < arena->blocks.size(); i++)
+		freeBlock(&arena->blocks[i]);
+	delete arena;
+}
+
+
+size_t
+imageSynthArenaCapacity(const TImageSynthArena* arena)
+{
+	size_t capacity = 0;
+	size_t i;
+
+	for (i = 0; i < arena->blocks.size(); i++)
+		capacity += arena->blocks[i].size;
+	return capacity;
+}
+
+
+void*
+imageSynthArenaAllocate(TImageSynthArena* arena, size_t bytes)
+{
+	TArenaBlock* block = arena->blocks.empty() ? NULL : &arena->blocks.back();
+	void* memory;
+
+	// Sizes are rounded, so every allocation in a block is aligned
+	bytes = roundUp(bytes ? bytes : 1, IMAGE_SYNTH_ARENA_ALIGN);
+	if (!block || block->size - block->used < bytes)
+	{
+		TArenaBlock newBlock;
+		size_t capacity = imageSynthArenaCapacity(arena);
+		size_t size = bytes;
+
+		if (size < ARENA_MIN_BLOCK_BYTES) size = ARENA_MIN_BLOCK_BYTES;
+		if (size < capacity) size = capacity;  // Blocks grow geometrically
+		newBlock.data = allocateBlock(arena->isHugePages, size, &newBlock.size);
+		if (!newBlock.data)
+			return NULL;
+		newBlock.used = 0;
+		arena->blocks.push_back(newBlock);
+		block = &arena->blocks.back();
+	}
+	memory = block->data + block->used;
+	block->used += bytes;
+	return memory;
+}
+
+
+void
+imageSynthArenaReset(TImageSynthArena* arena)
+{
+	size_t used = 0;
+	size_t i;
+
+	if (arena->blocks.size() > 1)
+	{
+		// Coalesce: one block holds what all the blocks held, for the next, likely similar, run
+		TArenaBlock block;
+
+		for (i = 0; i < arena->blocks.size(); i++)
+		{
+			used += arena->blocks[i].used;
+			freeBlock(&arena->blocks[i]);
+		}
+		arena->blocks.clear();
+		block.data = allocateBlock(arena->isHugePages, used, &block.size);
+		if (block.data)
+			arena->blocks.push_back(block);
+	}
+	for (i = 0; i < arena->blocks.size(); i++)
+		arena->blocks[i].used = 0;
+}
+
+
+void
+imageSynthArenaReserve(TImageSynthArena* arena, size_t bytes)
+{
+	TArenaBlock block;
+	size_t i;
+
+	if (bytes < ARENA_MIN_BLOCK_BYTES) bytes = ARENA_MIN_BLOCK_BYTES;
+	// A reset arena has at most one block
+	if (arena->blocks.size() == 1 && arena->blocks[0].size >= bytes)
+		return;
+	for (i = 0; i < arena->blocks.size(); i++)
+		freeBlock(&arena->blocks[i]);
+	arena->blocks.clear();
+	block.data = allocateBlock(arena->isHugePages, bytes, &block.size);
+	block.used = 0;
+	if (block.data)
+		arena->blocks.push_back(block);
+}
+
+
+size_t
+imageSynthArenaReservedBytes(size_t bytes, int isHugePages)
+{
+	if (bytes < ARENA_MIN_BLOCK_BYTES) bytes = ARENA_MIN_BLOCK_BYTES;
+	return roundUp(bytes, blockAlignment(isHugePages, bytes));
+}
@@ -0,0 +1,92 @@
+/*
+Header for an arena: the memory of the engine's per-run state.
+
+A run of the engine allocates maps and vectors the size of the target and corpus
+(which points have values, their sources, recent probers, the target and corpus points, sorted offsets.)
+They all live exactly as long as the run.
+An arena holds them in a few large blocks, aligned on a cache line, not zeroed (the engine sets every element it reads),
+and releases them all at once at the end of the run.
+
+A long-lived process (a server, a batch) can pass the same arena to many runs (see TImageSynthExtras arena.)
+Then the memory and its pages are kept between runs instead of freed and faulted in again:
+after a run that needed more than one block, the blocks coalesce into one of the size the run needed.
+Large blocks are advised for huge pages where the platform supports it (Linux transparent huge pages.)
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __SYNTH_IMAGE_SYNTH_ARENA_H__
+#define __SYNTH_IMAGE_SYNTH_ARENA_H__
+
+#include <stddef.h>  // size_t
+
+// Alignment of every allocation: a cache line
+#define IMAGE_SYNTH_ARENA_ALIGN 64
+
+// Opaque
+typedef struct ImageSynthArenaStruct TImageSynthArena;
+
+/*
+Create an arena, holding no memory until a run allocates.
+isHugePages: advise blocks of at least a huge page for huge pages.
+Not thread safe: one run of the engine at a time per arena.
+*/
+TImageSynthArena*
+newImageSynthArena(int isHugePages);
+
+void
+freeImageSynthArena(TImageSynthArena* arena);
+
+/* Bytes of the blocks the arena holds, allocated or not. */
+size_t
+imageSynthArenaCapacity(const TImageSynthArena* arena);
+
+
+/*
+For the engine.
+*/
+
+/* Memory of bytes, aligned on IMAGE_SYNTH_ARENA_ALIGN, not zeroed, outside any arena: for maps that outlive a run. */
+void*
+imageSynthAllocateAligned(size_t bytes);
+
+void
+imageSynthFreeAligned(void* memory);
+
+/* Memory of bytes, aligned on IMAGE_SYNTH_ARENA_ALIGN, not zeroed.  Valid until the arena is reset or freed. */
+void*
+imageSynthArenaAllocate(TImageSynthArena* arena, size_t bytes);
+
+/*
+Release every allocation at once, keeping the memory for the next run.
+If the allocations spanned blocks, replace them with one block of their total.
+*/
+void
+imageSynthArenaReset(TImageSynthArena* arena);
+
+/*
+Make the arena hold one block of at least bytes, for a run whose allocations are known to total bytes,
+so it doesn't grow (geometrically) during the run.  Only when nothing is allocated, after a reset.
+*/
+void
+imageSynthArenaReserve(TImageSynthArena* arena, size_t bytes);
+
+/* Bytes a new arena holds after reserving bytes, for estimating memory without allocating. */
+size_t
+imageSynthArenaReservedBytes(size_t bytes, int isHugePages);
+
+#endif /* __SYNTH_IMAGE_SYNTH_ARENA_H__ */
@@ -0,0 +1,467 @@
+/*
+Cache of results of the simple API.  See imageSynthCache.h.
+
+The key is a 128-bit hash of: the image content (not row padding), the mask content,
+the dimensions, the image format, and each parameter.
+The value is the image content after synthesis.
+A file of the directory is named by the key, and also holds the key and dimensions, checked when read.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <stddef.h>  // size_t
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "buildSwitches.h"
+#include "imageSynth.h"
+#include "glibProxy.h"
+#include "imageFormatIndicies.h"  // countPixelelsPerPixelForFormat
+#include "imageSynthCache.h"
+
+/*
+Version of results.
+Increment when a change to the engine changes results for the same input and parameters,
+so files of an older engine are not served.
+*/
+#define IMAGE_SYNTH_CACHE_VERSION 2
+
+#define IMAGE_SYNTH_CACHE_MAGIC "RSYNCACH"
+
+
+typedef struct ImageSynthCacheKeyStruct
+{
+  uint64_t low;
+  uint64_t high;
+} TImageSynthCacheKey;
+
+
+typedef struct ImageSynthCacheEntryStruct
+{
+  TImageSynthCacheKey key;
+  unsigned int width;
+  unsigned int height;
+  unsigned int pixelelsPerPixel;
+  std::vector<unsigned char> pixels;  // Rows unpadded
+} TImageSynthCacheEntry;
+
+
+struct ImageSynthCacheStruct
+{
+  std::mutex mutex;
+  size_t maxMemoryBytes;
+  size_t memoryBytes;
+  std::string directory;  // Empty if none
+  std::list<TImageSynthCacheEntry> entries;  // Most recently used first
+  std::unordered_map<uint64_t, std::list<TImageSynthCacheEntry>::iterator> index;  // By key.low
+};
+
+
+/************************************************************************/
+/* Hash                                                                 */
+/************************************************************************/
+
+typedef struct ImageSynthCacheHasherStruct
+{
+  uint64_t low;
+  uint64_t high;
+  uint64_t length;
+} TImageSynthCacheHasher;
+
+
+// Finalizer of SplitMix64
+static inline uint64_t mixCacheBits(uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+
+static inline uint64_t rotateLeft(uint64_t x, int bits)
+{
+  return (x << bits) | (x >> (64 - bits));
+}
+
+
+static void startCacheHash(TImageSynthCacheHasher* hasher)
+{
+  hasher->low = 0x243F6A8885A308D3ull;
+  hasher->high = 0x13198A2E03707344ull;
+  hasher->length = 0;
+}
+
+
+// Two lanes, each a multiply per word: a few bytes per cycle, so hashing costs little beside synthesis
+static inline void hashCacheWord(TImageSynthCacheHasher* hasher, uint64_t word)
+{
+  hasher->low = (rotateLeft(hasher->low, 31) ^ word) * 0x9E3779B97F4A7C15ull;
+  hasher->high = (rotateLeft(hasher->high, 27) ^ rotateLeft(word, 17)) * 0xC2B2AE3D27D4EB4Full;
+  hasher->length += 8;
+}
+
+
+static void hashCacheBytes(TImageSynthCacheHasher* hasher, const unsigned char* bytes, size_t count)
+{
+  size_t i;
+  uint64_t word;
+
+  for (i = 0; i + 8 <= count; i += 8)
+  {
+    memcpy(&word, bytes + i, 8);
+    hashCacheWord(hasher, word);
+  }
+  if (i < count)
+  {
+    word = 0;
+    memcpy(&word, bytes + i, count - i);
+    hashCacheWord(hasher, word ^ (count - i));  // Distinguish trailing zero bytes from none
+  }
+}
+
+
+static void hashCacheDouble(TImageSynthCacheHasher* hasher, double value)
+{
+  uint64_t word;
+  memcpy(&word, &value, sizeof(word));
+  hashCacheWord(hasher, word);
+}
+
+
+// Rows of a buffer, without padding
+static void hashCacheBuffer(TImageSynthCacheHasher* hasher, const ImageBuffer* buffer, unsigned int pixelelsPerPixel)
+{
+  unsigned int row;
+
+  hashCacheWord(hasher, buffer->width);
+  hashCacheWord(hasher, buffer->height);
+  for (row = 0; row < buffer->height; row++)
+    hashCacheBytes(hasher, buffer->data + row * buffer->rowBytes, (size_t)buffer->width * pixelelsPerPixel);
+}
+
+
+// Each field, not the struct, whose padding is garbage.  !!! Add new parameters here.
+static void hashCacheParameters(TImageSynthCacheHasher* hasher, const TImageSynthParameters* parameters)
+{
+  hashCacheWord(hasher, (uint64_t)parameters->isMakeSeamlesslyTileableHorizontally);
+  hashCacheWord(hasher, (uint64_t)parameters->isMakeSeamlesslyTileableVertically);
+  hashCacheWord(hasher, (uint64_t)parameters->matchContextType);
+  hashCacheDouble(hasher, parameters->mapWeight);
+  hashCacheDouble(hasher, parameters->sensitivityToOutliers);
+  hashCacheWord(hasher, parameters->patchSize);
+  hashCacheWord(hasher, parameters->maxProbeCount);
+  hashCacheDouble(hasher, parameters->energyTerminateFraction);
+  hashCacheWord(hasher, parameters->maxMilliseconds);
+  hashCacheWord(hasher, parameters->localityBlockSize);
+  hashCacheWord(hasher, parameters->seed);
+  hashCacheWord(hasher, (uint64_t)parameters->isDeterministic);
+  hashCacheWord(hasher, (uint64_t)parameters->matchMetric);
+  hashCacheWord(hasher, (uint64_t)parameters->isCorpusTiled);
+  hashCacheWord(hasher, (uint64_t)parameters->maxMemoryBytes);
+}
+
+
+static TImageSynthCacheKey finishCacheHash(TImageSynthCacheHasher* hasher)
+{
+  TImageSynthCacheKey key;
+  key.low = mixCacheBits(hasher->low ^ hasher->length);
+  key.high = mixCacheBits(hasher->high ^ key.low);
+  return key;
+}
+
+
+static TImageSynthCacheKey
+imageSynthCacheKey(
+  const ImageBuffer* imageBuffer,
+  const ImageBuffer* mask,
+  TImageFormat imageFormat,
+  const TImageSynthParameters* parameters)
+{
+  TImageSynthCacheHasher hasher;
+  unsigned int pixelelsPerPixel = countPixelelsPerPixelForFormat(imageFormat);
+
+  startCacheHash(&hasher);
+  hashCacheWord(&hasher, IMAGE_SYNTH_CACHE_VERSION);
+  hashCacheWord(&hasher, (uint64_t)imageFormat);
+  hashCacheParameters(&hasher, parameters);
+  hashCacheBuffer(&hasher, imageBuffer, pixelelsPerPixel);
+  hashCacheBuffer(&hasher, mask, 1);
+  return finishCacheHash(&hasher);
+}
+
+
+static inline bool equalCacheKeys(const TImageSynthCacheKey* a, const TImageSynthCacheKey* b)
+{
+  return a->low == b->low && a->high == b->high;
+}
+
+
+/************************************************************************/
+/* Entries                                                              */
+/************************************************************************/
+
+static void copyEntryFromBuffer(TImageSynthCacheEntry* entry, const ImageBuffer* buffer, unsigned int pixelelsPerPixel)
+{
+  unsigned int row;
+  size_t rowLength = (size_t)buffer->width * pixelelsPerPixel;
+
+  entry->width = buffer->width;
+  entry->height = buffer->height;
+  entry->pixelelsPerPixel = pixelelsPerPixel;
+  entry->pixels.resize(rowLength * buffer->height);
+  for (row = 0; row < buffer->height; row++)
+    memcpy(&entry->pixels[row * rowLength], buffer->data + row * buffer->rowBytes, rowLength);
+}
+
+
+static bool copyEntryToBuffer(const TImageSynthCacheEntry* entry, ImageBuffer* buffer, unsigned int pixelelsPerPixel)
+{
+  unsigned int row;
+  size_t rowLength = (size_t)buffer->width * pixelelsPerPixel;
+
+  // The key makes a mismatch improbable, but check what is cheap to check
+  if (entry->width != buffer->width || entry->height != buffer->height
+    || entry->pixelelsPerPixel != pixelelsPerPixel || entry->pixels.size() != rowLength * buffer->height)
+    return false;
+
+  for (row = 0; row < buffer->height; row++)
+    memcpy(buffer->data + row * buffer->rowBytes, &entry->pixels[row * rowLength], rowLength);
+  return true;
+}
+
+
+static inline size_t entryBytes(const TImageSynthCacheEntry* entry)
+{
+  return entry->pixels.size() + sizeof(TImageSynthCacheEntry);
+}
+
+
+/* Find in memory, and make most recently used.  Caller holds the mutex. */
+static TImageSynthCacheEntry* findMemoryEntry(TImageSynthCache* cache, const TImageSynthCacheKey* key)
+{
+  auto found = cache->index.find(key->low);
+  if (found == cache->index.end() || !equalCacheKeys(&found->second->key, key))
+    return NULL;
+  cache->entries.splice(cache->entries.begin(), cache->entries, found->second);
+  return &cache->entries.front();
+}
+
+
+/* Store in memory, discarding least recently used beyond the limit.  Caller holds the mutex. */
+static void storeMemoryEntry(TImageSynthCache* cache, TImageSynthCacheEntry* entry)
+{
+  if (entryBytes(entry) > cache->maxMemoryBytes) return;
+
+  auto found = cache->index.find(entry->key.low);
+  if (found != cache->index.end())
+  {
+    cache->memoryBytes -= entryBytes(&*found->second);
+    cache->entries.erase(found->second);
+    cache->index.erase(found);
+  }
+
+  cache->entries.push_front(TImageSynthCacheEntry());
+  cache->entries.front().key = entry->key;
+  cache->entries.front().width = entry->width;
+  cache->entries.front().height = entry->height;
+  cache->entries.front().pixelelsPerPixel = entry->pixelelsPerPixel;
+  cache->entries.front().pixels.swap(entry->pixels);
+  cache->index[entry->key.low] = cache->entries.begin();
+  cache->memoryBytes += entryBytes(&cache->entries.front());
+
+  while (cache->memoryBytes > cache->maxMemoryBytes)
+  {
+    TImageSynthCacheEntry* oldest = &cache->entries.back();
+    cache->memoryBytes -= entryBytes(oldest);
+    cache->index.erase(oldest->key.low);
+    cache->entries.pop_back();
+  }
+}
+
+
+/************************************************************************/
+/* Files                                                                */
+/************************************************************************/
+
+static std::string entryFilePath(const TImageSynthCache* cache, const TImageSynthCacheKey* key)
+{
+  char name[48];
+  snprintf(name, sizeof(name), "%016llx%016llx.resynth", (unsigned long long)key->high, (unsigned long long)key->low);
+  return cache->directory + "/" + name;
+}
+
+
+static bool readFileEntry(const TImageSynthCache* cache, const TImageSynthCacheKey* key, TImageSynthCacheEntry* entry)
+{
+  char magic[8];
+  uint32_t header[3];
+  TImageSynthCacheKey fileKey;
+  bool isRead = false;
+
+  FILE* file = fopen(entryFilePath(cache, key).c_str(), "rb");
+  if (!file) return false;
+
+  if (fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, IMAGE_SYNTH_CACHE_MAGIC, sizeof(magic)) == 0
+    && fread(&fileKey, sizeof(fileKey), 1, file) == 1 && equalCacheKeys(&fileKey, key)
+    && fread(header, sizeof(header), 1, file) == 1)
+  {
+    entry->key = *key;
+    entry->width = header[0];
+    entry->height = header[1];
+    entry->pixelelsPerPixel = header[2];
+    entry->pixels.resize((size_t)header[0] * header[1] * header[2]);
+    isRead = fread(entry->pixels.data(), 1, entry->pixels.size(), file) == entry->pixels.size();
+  }
+  fclose(file);
+  return isRead;
+}
+
+
+/* Write to a temporary file then rename, so readers (maybe other processes) never see a partial file. */
+static void writeFileEntry(const TImageSynthCache* cache, const TImageSynthCacheEntry* entry)
+{
+  uint32_t header[3] = { entry->width, entry->height, entry->pixelelsPerPixel };
+  std::string path = entryFilePath(cache, &entry->key);
+  std::string temporaryPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  bool isWritten;
+
+  FILE* file = fopen(temporaryPath.c_str(), "wb");
+  if (!file) return;  // A cache that can't be written is not an error of synthesis
+
+  isWritten = fwrite(IMAGE_SYNTH_CACHE_MAGIC, 8, 1, file) == 1
+    && fwrite(&entry->key, sizeof(entry->key), 1, file) == 1
+    && fwrite(header, sizeof(header), 1, file) == 1
+    && fwrite(entry->pixels.data(), 1, entry->pixels.size(), file) == entry->pixels.size();
+  isWritten = (fclose(file) == 0) && isWritten;
+  if (!isWritten || rename(temporaryPath.c_str(), path.c_str()) != 0)
+    remove(temporaryPath.c_str());
+}
+
+
+/************************************************************************/
+/* API                                                                  */
+/************************************************************************/
+
+extern TImageSynthCache*
+newImageSynthCache(size_t maxMemoryBytes, const char* directory)
+{
+  TImageSynthCache* cache = new TImageSynthCache;
+  cache->maxMemoryBytes = maxMemoryBytes;
+  cache->memoryBytes = 0;
+  if (directory) cache->directory = directory;
+  return cache;
+}
+
+
+extern void
+freeImageSynthCache(TImageSynthCache* cache)
+{
+  delete cache;
+}
+
+
+extern int
+isRepeatableImageSynth(const TImageSynthParameters* parameters)
+{
+  TImageSynthParameters defaultParameters;
+
+  if (!parameters) {
+    setDefaultParams(&defaultParameters);
+    parameters = &defaultParameters;
+    }
+  return parameters->maxMilliseconds == 0 && parameters->isDeterministic;
+}
+
+
+extern int
+imageSynthCached(
+  TImageSynthCache* cache,
+  ImageBuffer * imageBuffer,  // IN/OUT
+  ImageBuffer * mask,         // IN
+  TImageFormat imageFormat,
+  TImageSynthParameters* parameters,  // or NULL to use defaults
+  void (*progressCallback)(int, void*),
+  void *contextInfo,
+  int *cancelFlag,
+  int *isHit  // OUT or NULL
+  )
+{
+  TImageSynthParameters defaultParameters;
+  TImageSynthCacheKey key;
+  TImageSynthCacheEntry entry;
+  unsigned int pixelelsPerPixel;
+  int error;
+
+  if (isHit) *isHit = 0;
+
+  // Sanity checks of imageSynth(), before reading the buffers
+  if (imageBuffer->width != mask->width || imageBuffer->height != mask->height)
+    return IMAGE_SYNTH_ERROR_IMAGE_MASK_MISMATCH;
+
+  if (!parameters) {
+    setDefaultParams(&defaultParameters);
+    parameters = &defaultParameters;
+    }
+
+  if (!isRepeatableImageSynth(parameters))
+    return imageSynth(imageBuffer, mask, imageFormat, parameters, progressCallback, contextInfo, cancelFlag);
+
+  pixelelsPerPixel = countPixelelsPerPixelForFormat(imageFormat);
+  key = imageSynthCacheKey(imageBuffer, mask, imageFormat, parameters);
+
+  {
+    std::unique_lock<std::mutex> lock(cache->mutex);
+    TImageSynthCacheEntry* found = findMemoryEntry(cache, &key);
+    if (found && copyEntryToBuffer(found, imageBuffer, pixelelsPerPixel))
+    {
+      if (isHit) *isHit = 1;
+      return IMAGE_SYNTH_SUCCESS;
+    }
+  }
+
+  if (!cache->directory.empty() && readFileEntry(cache, &key, &entry)
+    && copyEntryToBuffer(&entry, imageBuffer, pixelelsPerPixel))
+  {
+    std::unique_lock<std::mutex> lock(cache->mutex);
+    storeMemoryEntry(cache, &entry);
+    if (isHit) *isHit = 1;
+    return IMAGE_SYNTH_SUCCESS;
+  }
+
+  // Miss.  Synthesize outside the lock: other threads may hit or synthesize meanwhile,
+  // which a deterministic run does not depend on, see isRepeatableImageSynth().
+  error = imageSynth(imageBuffer, mask, imageFormat, parameters, progressCallback, contextInfo, cancelFlag);
+  if (error || *cancelFlag) return error;
+
+  entry.key = key;
+  copyEntryFromBuffer(&entry, imageBuffer, pixelelsPerPixel);
+  if (!cache->directory.empty())
+    writeFileEntry(cache, &entry);
+  {
+    std::unique_lock<std::mutex> lock(cache->mutex);
+    storeMemoryEntry(cache, &entry);
+  }
+  return error;
+}
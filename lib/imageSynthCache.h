@@ -0,0 +1,92 @@
+/*
+Header for a cache of results of the simple API.
+
+Clients often resubmit the same image, mask and parameters (retries, a preview then a final render.)
+imageSynthCached() is imageSynth() but returns a stored result, without running the engine,
+for the same image content, mask content, image format and parameters.
+
+Results are stored in memory, least recently used discarded beyond a limit of bytes,
+and/or as files in a directory, which persist between processes.
+The directory is not limited: the client cleans it.
+
+Only repeatable synthesis is cached, see isRepeatableImageSynth():
+otherwise a cached result would be just one of many possible results, and a hit would hide that.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __SYNTH_IMAGE_SYNTH_CACHE_H__
+#define __SYNTH_IMAGE_SYNTH_CACHE_H__
+
+#include <stddef.h>  // size_t
+
+#include "imageBuffer.h"
+#include "imageFormat.h"
+#include "engineParams.h"
+
+// Opaque
+typedef struct ImageSynthCacheStruct TImageSynthCache;
+
+/*
+Create a cache.
+maxMemoryBytes: limit of results in memory, zero for none in memory.
+directory: existing directory for result files, or NULL for none on disk.
+Thread safe: one cache can serve threads calling imageSynthCached() concurrently.
+*/
+TImageSynthCache*
+newImageSynthCache(size_t maxMemoryBytes, const char* directory);
+
+void
+freeImageSynthCache(TImageSynthCache* cache);
+
+/*
+Whether synthesis with these parameters (NULL for defaults) is repeatable:
+the same input always gives the same result, so a result can be cached.
+
+The rule:
+- no time budget (maxMilliseconds zero), since a run that spends its budget depends on timing
+- and synthesis is deterministic (isDeterministic), even if the library is built unthreaded.
+  Otherwise threads read pixels that other threads write, depending on timing,
+  and the order of the target and the probes come from the PRNG (see glibProxy), the C library's rand(),
+  which concurrent runs, and any other caller in the process, share.
+
+Deterministic synthesis draws from streams of the seed instead (see counterRandom.h),
+so the result depends only on the input and the parameters, even while other runs miss the cache concurrently.
+*/
+int
+isRepeatableImageSynth(const TImageSynthParameters* parameters);
+
+/*
+Same as imageSynth(), but served from the cache if possible.
+If synthesis is repeatable and the cache holds the result, copy it into imageBuffer without synthesis.
+Else synthesize, and if repeatable, successful and not canceled, store the result.
+isHit: OUT, or NULL.  Whether the result came from the cache.
+*/
+int
+imageSynthCached(
+  TImageSynthCache* cache,
+  ImageBuffer * imageBuffer,  // IN/OUT
+  ImageBuffer * mask,         // IN
+  TImageFormat imageFormat,
+  TImageSynthParameters* parameters,  // or NULL to use defaults
+  void (*progressCallback)(int, void*),
+  void *contextInfo,
+  int *cancelFlag,
+  int *isHit
+  );
+
+#endif /* __SYNTH_IMAGE_SYNTH_CACHE_H__ */
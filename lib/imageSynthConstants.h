@@ -61,6 +61,17 @@
  */
 #define MAX_IMAGE_SYNTH_BPP 8
 
+/*
+ Internal pixmaps, see new_pixmap().
+ A pixel is padded to a power of two pixelels (see prepareImageFormatIndices())
+ and the first pixel is aligned on IMAGE_SYNTH_PIXMAP_ALIGN bytes,
+ so every pixel is aligned to its size and never straddles a cache line.
+ IMAGE_SYNTH_PIXMAP_TAIL_PAD bytes follow the last pixel,
+ so a load of MAX_IMAGE_SYNTH_BPP bytes at any pixel is in bounds.
+ */
+#define IMAGE_SYNTH_PIXMAP_ALIGN 64
+#define IMAGE_SYNTH_PIXMAP_TAIL_PAD MAX_IMAGE_SYNTH_BPP
+
 
 /*
 Constants of the synthesis algorithm.
@@ -93,6 +104,12 @@ else terminate repeated passes over the target.
 */
 #define IMAGE_SYNTH_TERMINATE_FRACTION 0.1
 
+/*
+The most passes over the target the engine makes.
+Shared so callers can size per-pass statistics.
+*/
+#define IMAGE_SYNTH_MAX_PASSES 6
+
 /*
 The fraction ( count of points in a band / total target points)
 for banded randomization of target points.
@@ -100,6 +117,42 @@ for banded randomization of target points.
 #define IMAGE_SYNTH_BAND_FRACTION 0.1
 
 
+/*
+Anytime synthesis (parameter maxMilliseconds.)
+The first pass, which must fill the whole target, probes this fraction of maxProbeCount,
+so there is time left for refinement.
+*/
+#define IMAGE_SYNTH_FILL_PROBE_DIVISOR 4
+
+// Count of target pixels synthesized between checks of the deadline.
+// Small: reading the clock costs far less than searching for one target pixel.
+// !!! This must in binary all x lower bits ones i.e. 2^4-1
+#define IMAGE_SYNTH_DEADLINE_CHECK_COUNT 15
+
+
+/*
+Deterministic synthesis (parameter isDeterministic.)
+Bounds of the count of target pixels in a phase: synthesized independently, then written to the target.
+*/
+#define IMAGE_SYNTH_PHASE_MIN_TARGETS 64
+#define IMAGE_SYNTH_PHASE_MAX_TARGETS 4096
+
+/*
+Memory budget (parameter maxMemoryBytes.)
+Least radius of the square of offsets searched for neighbors, when the budget limits it.
+A patch of IMAGE_SYNTH_MAX_NEIGHBORS fits many times over.
+*/
+#define IMAGE_SYNTH_MIN_OFFSETS_RADIUS 32
+
+/*
+Count of random probes drawn and prefetched ahead, then scored in order (see synthesizeTargetPoint().)
+So the corpus patches of a batch load in parallel.  1: no batching.
+*/
+#define IMAGE_SYNTH_PROBE_BATCH 8
+
+// Count of the nearest neighbors whose corpus pixels are prefetched per probe (see prefetchPatch())
+#define IMAGE_SYNTH_PREFETCH_NEIGHBORS 8
+
 // Count of target pixels synthesized per deep progress callback
 // !!! This must in binary all x lower bits ones i.e. 2^12-1
 #define IMAGE_SYNTH_CALLBACK_COUNT 4095
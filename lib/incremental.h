@@ -0,0 +1,166 @@
+/*
+Incremental resynthesis: after the user edits the mask, resynthesize only what the edit affects.
+
+A run can export its correspondence (see correspondence.h): for each target pixel, which corpus pixel it came from
+(extras->sourceIndices.)  A later run on the result, with an edited mask, can pass it back
+(extras->priorSourceIndices.)  Then a target pixel keeps its prior source, and is not synthesized,
+unless it is near a changed pixel:
+- a pixel in the target of one run but not the other (the edit)
+- a target pixel whose prior source is no longer in the corpus (e.g. the edit covered it.)
+
+Near means within the patch radius (the farthest offset of a patch) plus a blend band,
+by a chamfer distance transform as for brushfire order (see brushfire.h.)
+Within the patch radius, the patch of a target pixel overlaps the edit, so its best source may differ.
+The blend band further resynthesizes a seam between kept and new pixels.
+Kept pixels have value: the affected pixels are synthesized matching them, as context.
+
+The caller must not change the image outside the targets of the two runs, nor the image size,
+since the distance is to changed mask, not changed pixels.
+Not for tiled synthesis, where patches wrap across the image: then the prior is ignored.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_INCREMENTAL_H_
+#define RESYNTH_INCREMENTAL_H_
+
+#include <cmath>
+
+
+/* Radius of a patch: distance of its farthest offset, rounded up. */
+static guint patchRadius(PointVector sortedOffsets, guint patchSize)
+{
+	Coordinates offset = sortedOffsets->data[MIN(patchSize, sortedOffsets->len) - 1];
+	return static_cast<guint>(ceil(sqrt(static_cast<gdouble>(offset.x * offset.x + offset.y * offset.y))));
+}
+
+
+/* Distance from a changed pixel within which target points are resynthesized: the patch radius plus blendBand. */
+static guint affectedRadius(const TImageSynthParameters* parameters, PointVector sortedOffsets, guint blendBand)
+{
+	return patchRadius(sortedOffsets, parameters->patchSize) + blendBand;
+}
+
+
+/* Prior source of a target point, if it was in the prior target and its source is in the corpus now. */
+static gboolean priorSourceOf(
+	const gint32* priorSourceIndices,
+	TFormatIndices* indices,
+	Map* targetMap,
+	Map* corpusMap,
+	Coordinates point,
+	Coordinates* source)  // OUT
+{
+	gint32 index = priorSourceIndices[point.y * targetMap->width + point.x];
+
+	if (index < 0 || static_cast<guint>(index) >= corpusMap->width * corpusMap->height)
+		return FALSE;
+	source->x = index % corpusMap->width;
+	source->y = index / corpusMap->width;
+	return !clippedOrMaskedCorpus(*source, corpusMap) && not_transparent_corpus(*source, indices, corpusMap);
+}
+
+
+static gboolean isChangedSincePrior(
+	const gint32* priorSourceIndices,
+	TFormatIndices* indices,
+	Map* targetMap,
+	Map* corpusMap,
+	Coordinates point)
+{
+	Coordinates source;
+	gboolean isPriorTarget = (priorSourceIndices[point.y * targetMap->width + point.x] >= 0);
+
+	if (isPriorTarget != isSelectedTarget(point, targetMap))
+		return TRUE;
+	return isPriorTarget && !priorSourceOf(priorSourceIndices, indices, targetMap, corpusMap, point, &source);
+}
+
+
+/*
+Give target points unaffected by the edit their prior source and color, and give them value.
+Remove them from targetPoints, which keeps its order.
+Returns the count kept.
+*/
+static guint keepPriorSources(
+	const TImageSynthParameters* parameters,
+	const gint32* priorSourceIndices,
+	guint blendBand,
+	TFormatIndices* indices,
+	Map* targetMap,
+	Map* corpusMap,
+	Map* hasValueMap,	// IN/OUT
+	Map* sourceOfMap,	// IN/OUT
+	PointVector targetPoints,	// IN/OUT
+	PointVector sortedOffsets)
+{
+	TDistanceGrid grid;
+	Bounds bounds;
+	guint radius;
+	guint x;
+	guint y;
+	guint i;
+	guint keptCount = 0;
+	guint remainingCount = 0;
+
+	if (parameters->isMakeSeamlesslyTileableHorizontally || parameters->isMakeSeamlesslyTileableVertically)
+		return 0;
+
+	/*
+	Grid over the bounds of the target plus the radius, clipped to the image:
+	all changed pixels near a target point are in the grid.
+	*/
+	radius = affectedRadius(parameters, sortedOffsets, blendBand);
+	bounds = get_bounds(targetPoints, targetPoints->len);
+	grid.origin.x = MAX(bounds.ulx - (gint)radius, 0);
+	grid.origin.y = MAX(bounds.uly - (gint)radius, 0);
+	grid.width = MIN(bounds.lrx + (gint)radius, (gint)targetMap->width - 1) - grid.origin.x + 1;
+	grid.height = MIN(bounds.lry + (gint)radius, (gint)targetMap->height - 1) - grid.origin.y + 1;
+	grid.distance.assign(grid.width * grid.height, CHAMFER_INFINITY);
+
+	for (y = 0; y < grid.height; y++)
+		for (x = 0; x < grid.width; x++)
+		{
+			Coordinates imagePoint = { grid.origin.x + static_cast<gint>(x), grid.origin.y + static_cast<gint>(y) };
+			if (isChangedSincePrior(priorSourceIndices, indices, targetMap, corpusMap, imagePoint))
+				*distanceAt(&grid, x, y) = 0;
+		}
+	chamferDistanceTransform(&grid);
+
+	for (i = 0; i < targetPoints->len; i++)
+	{
+		Coordinates position = targetPoints->data[i];
+		Coordinates source;
+
+		// Not changed, so the prior source is valid
+		if (*distanceAtPoint(&grid, position) > CHAMFER_ORTHOGONAL * radius
+			&& priorSourceOf(priorSourceIndices, indices, targetMap, corpusMap, position, &source))
+		{
+			setColor(indices, targetMap, position, corpusMap, source);
+			setSourceOf(position, source, sourceOfMap);
+			setHasValue(&position, TRUE, hasValueMap);
+			keptCount++;
+		}
+		else
+			targetPoints->data[remainingCount++] = position;
+	}
+	targetPoints->len = remainingCount;
+	return keptCount;
+}
+
+
+#endif /* RESYNTH_INCREMENTAL_H_ */
@@ -18,6 +18,8 @@ Fundamental types of the engine.
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include "imageSynthArena.h"
+
 /* 
 2-D array of type, where type has size depth.
 Bytemap: type is char (often used as a bool)
@@ -29,7 +31,8 @@ typedef struct {
   guint width;
   guint height;
   guint depth; 
-  GArray * data;
+  guchar * data;       // width * height elements of depth bytes, row major, aligned (see new_pixmap())
+  gboolean isInArena;  // data is freed with an arena, not by free_map()
   } Map;
 
 typedef guint8 Pixelel;
@@ -78,6 +81,15 @@ new_coordmap(
   guint
   );
 
+extern void
+new_arena_map(
+  Map *,
+  guint, 
+  guint, 
+  guint,
+  TImageSynthArena*
+  );
+
 
 /* Misc map operations. */
 
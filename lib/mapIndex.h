@@ -8,13 +8,10 @@ If the compiler does not inline, may be separate instances of the function in se
 
 Indexing into a Map
 
-This is dictated by use of glib GArray
-instead of conventional malloc and pointer arithmetic.
-Presumably glib does good error checking for malloc.
-Here we also do arithmetic for indexing a dynamic multi-dimensional array.
+A Map's data is a direct pointer to its elements (formerly a glib GArray, indexed through its header.)
+Here we do arithmetic for indexing a dynamic multi-dimensional array, and cast to the type of element.
 Here we use static inline rather than a macro.
-!!! g_array_index is a macro that casts types.
-!!! g_array_index returns an element, we return address of.
+!!! We return the address of an element.
 
   Copyright (C) 2010, 2011  Lloyd Konneker
 
@@ -46,7 +43,7 @@ pixmap_index(
   )
 {
   guint index = (coords.x + coords.y * map->width) * map->depth;
-  return &g_array_index(map->data, Pixelel, index);
+  return &map->data[index];
 }
   
 /* Return pointer to guint at coordinates in map. */
@@ -57,7 +54,7 @@ intmap_index(
   )
 {
   guint index = coords.x + coords.y * map->width;
-  return &g_array_index(map->data, guint, index);
+  return reinterpret_cast<guint*>(map->data) + index;
 }
   
 /* Return pointer to coordinates at coordinates in map. */
@@ -68,7 +65,7 @@ coordmap_index(
   )
 {
   guint index = coords.x + coords.y * map->width;
-  return &g_array_index(map->data, Coordinates, index);
+  return reinterpret_cast<Coordinates*>(map->data) + index;
 }
 
 /* Return pointer to boolean at coordinates in Pixmap. */
@@ -80,7 +77,7 @@ bytemap_index(
   )
 {
   guint index = coords.x + coords.y * map->width;
-  return &g_array_index(map->data, guchar, index);
+  return &map->data[index];
 }
 
 
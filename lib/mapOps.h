@@ -3,7 +3,7 @@ Maps i.e. 2D, coordinate addressable, arrays of element.
 
 lkk I couldn't find a suitable library that implement this.
 So this is a conventional implementation using pointer arithmentic on a 1-D array.
-Here, the 1-D array is a GArray.
+Here, the 1-D array is a block of bytes, aligned, allocated once (see new_map_data()) or in an arena.
 
 In earlier resynthesizer c++ coding, this used templates.
 That is, a Bitmap was a 2D array class parameterized by the type of the element:
@@ -32,15 +32,41 @@ Here, there are separate functions for creating and indexing each type of map.
 
 // Note, included, not compiled separately
 
+/*
+Allocation of a map's data.
+Aligned on IMAGE_SYNTH_PIXMAP_ALIGN, with IMAGE_SYNTH_PIXMAP_TAIL_PAD bytes after the last element,
+so a vector load at any pixel stays in bounds.
+The size is fixed: a map never reallocates, so pointers into it stay valid.
+*/
+static guchar*
+new_map_data(
+  guint width,
+  guint height,
+  guint depth
+  )
+{
+  size_t size = (size_t)width * height * depth + IMAGE_SYNTH_PIXMAP_TAIL_PAD;
+  guchar* data = static_cast<guchar*>(imageSynthAllocateAligned(size));
+  g_assert(data);
+  memset(data, 0, size);
+  return data;
+}
+
+
 void
 free_map (Map *map)
 {
-  g_array_free(map->data, TRUE);
-  map->data = (GArray *) NULL;
+  if (!map->isInArena)
+    imageSynthFreeAligned(map->data);
+  map->data = NULL;
 }
   
 
-/*  Create new Pixmap having Pixel of depth. IE a 3D array */
+/*
+Create new Pixmap having Pixel of depth. IE a 3D array
+For the internal pixmaps, depth is total_bpp, a power of two (see prepareImageFormatIndices().)
+Zeroed, so pad pixelels are zero.
+*/
 void
 new_pixmap(
   Map * map,
@@ -52,13 +78,8 @@ new_pixmap(
   map->width = width;
   map->height = height;
   map->depth = depth;
-  /*
-  Equivalently, but not if Pixelel size changes.
-  IOW the code now depends on Pixelel equal one byte.
-   guint size = width * height * depth;
-   map->data = g_array_sized_new (FALSE, TRUE, sizeof(Pixelel), size);
-  */
-  map->data = g_array_sized_new (FALSE, TRUE, depth, width * height);
+  map->data = new_map_data(width, height, depth);
+  map->isInArena = FALSE;
 }
 
 
@@ -70,10 +91,7 @@ new_intmap(
   guint height
   )
 {
-  map->width = width;
-  map->height = height;
-  map->depth = sizeof(guint);   // Not used
-  map->data = g_array_sized_new (FALSE, TRUE, sizeof(guint), width * height);
+  new_pixmap(map, width, height, sizeof(guint));
 }
 
 /* Create dynamic 2-D array of Coordinates. */
@@ -83,13 +101,54 @@ new_coordmap(
   guint width, 
   guint height
   )
+{
+  new_pixmap(map, width, height, sizeof(Coordinates));
+}
+
+
+/*
+Create a 2-D array of elements of size depth, for one run of the engine, in its arena.
+See imageSynthArena.h.
+Not zeroed: the caller sets every element it reads.
+Freeing it frees nothing: resetting the arena frees all at once.
+*/
+void
+new_arena_map(
+  Map * map,
+  guint width, 
+  guint height, 
+  guint depth,
+  TImageSynthArena* arena
+  )
 {
   map->width = width;
   map->height = height;
-  map->depth = sizeof(Coordinates);   // Not used
-  map->data = g_array_sized_new (FALSE, TRUE, sizeof(Coordinates), width * height);
+  map->depth = depth;
+  map->data = static_cast<guchar*>(imageSynthArenaAllocate(arena, (size_t)width * height * depth + IMAGE_SYNTH_PIXMAP_TAIL_PAD));
+  g_assert(map->data);
+  map->isInArena = TRUE;
 }
-  
+
+
+/*
+Create a vector of capacity points, for one run of the engine, in its arena.
+Not zeroed, empty (len zero.)  Freed with the arena.
+*/
+static PointVector
+new_point_vector(
+  TImageSynthArena* arena,
+  guint capacity
+  )
+{
+  PointVector vector = static_cast<PointVector>(imageSynthArenaAllocate(arena, sizeof(TPointVectorStruct)));
+  g_assert(vector);
+  vector->data = static_cast<Coordinates*>(imageSynthArenaAllocate(arena, (size_t)capacity * sizeof(Coordinates)));
+  g_assert(vector->data);
+  vector->len = 0;
+  vector->capacity = capacity;
+  return vector;
+}
+
 /* Create dynamic 2-D array of guchar. */
 void
 new_bytemap(
@@ -106,24 +165,14 @@ new_bytemap(
 
 /* Misc operations on Map. */
 
-/* Set all elements of bytemap to a value. 
-TODO use memset?
-*/
+/* Set all elements of bytemap to a value. */
 void
 set_bytemap(
   Map* map,
   guchar value
   )
 {
-  guint y;
-  guint x;
-  
-  for (y=0; y<map->height; y++)
-    for (x=0; x<map->width; x++)
-    {
-      Coordinates coords = {static_cast<int>(x), static_cast<int>(y)};
-      *bytemap_index(map, coords) = value;
-    }
+  memset(map->data, value, (size_t)map->width * map->height);
 }
 
 void 
@@ -131,16 +180,13 @@ invert_bytemap(
   Map* map
   )
 {
-  guint y;
-  guint x;
+  guchar * __restrict data = map->data;
+  size_t size = (size_t)map->width * map->height;
+  size_t i;
   
-  for (y=0; y<map->height; y++)
-    for (x=0; x<map->width; x++)
-    {
-      Coordinates coords = {static_cast<int>(x), static_cast<int>(y)};
-      // Ones complement: bitwise negation
-      *bytemap_index(map, coords) = ~ *bytemap_index(map, coords);
-    }
+  // Ones complement: bitwise negation.  A flat loop, the compiler vectorizes it.
+  for (i=0; i < size; i++)
+    data[i] = ~data[i];
 }
 
 
@@ -149,6 +195,7 @@ Interleave one pixelel of mask pixmap into pixelels of pixmap.
 
 lkk Mask bytemap was separate.  Interleaved them for better memory locality.
 The map pixmap was interleaved with the color pixmap, so why not the mask too.
+In bands of rows, in parallel (see rowBands.h.)
 */
 void
 interleave_mask(
@@ -156,15 +203,21 @@ interleave_mask(
   Map *mask
   )
 {
-  guint i;
-  
-  guint size = pixmap->height * pixmap->width;
-  g_assert( size == mask->height * mask->width);  /* Same dimensions. */
+  g_assert( pixmap->height * pixmap->width == mask->height * mask->width);  /* Same dimensions. */
 
-  for (i=0; i < size; i++)
-    /* Copy one byte */
-    g_array_index(pixmap->data, Pixelel, i*pixmap->depth + MASK_PIXELEL_INDEX) =
-          g_array_index(mask->data, Pixelel, i*mask->depth);
+  forEachRowBand(rowBandCount(pixmap->width, pixmap->height), pixmap->height,
+    [pixmap, mask](guint /*band*/, guint startRow, guint endRow)
+    {
+      Pixelel * __restrict dest = pixmap->data;
+      const guchar * __restrict src = mask->data;
+      const guint depth = pixmap->depth;
+      const guint maskDepth = mask->depth;
+      size_t i;
+
+      for (i = (size_t)startRow * pixmap->width; i < (size_t)endRow * pixmap->width; i++)
+        /* Copy one byte */
+        dest[i*depth + MASK_PIXELEL_INDEX] = src[i*maskDepth];
+    });
 }
 
 
@@ -0,0 +1,235 @@
+/*
+Scanning a pixmap for pixels by their mask (and alpha) pixelel, a chunk of MASK_SCAN_BYTES at a time.
+
+The mask is the first pixelel of each pixel, at a stride of the pixmap's depth,
+a power of two no larger than a chunk (see prepareImageFormatIndices().)
+A chunk compares all its bytes at once (SSE2: compare, then movemask to a bit per byte.)
+The bits at the first byte of each pixel are the results for the chunk's pixels:
+counted by popcount, visited lowest first, or written as flags.
+A chunk without any bit is skipped whole, so a scan for a small target in a large image is mostly skipping.
+Without SSE2, the same bits come from a loop over the chunk's pixels.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_MASK_SCAN_H_
+#define RESYNTH_MASK_SCAN_H_
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MASK_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#define MASK_SCAN_BYTES 16
+
+// A bit per byte of a chunk
+typedef guint TMaskScanBits;
+
+
+/*
+Which pixels a scan finds: those whose mask pixelel equals (or if not isEqual, differs from) maskValue,
+and if alphaIndex is not zero, whose alpha pixelel (at alphaIndex in the pixel) is not totally transparent.
+*/
+typedef struct {
+	guint depth;
+	guint depthShift;           // log2(depth)
+	TMaskScanBits pixelBits;    // The bit of the first byte of each pixel in a chunk
+	Pixelel maskValue;
+	gboolean isEqual;
+	TPixelelIndex alphaIndex;   // Zero, the mask's index, for none
+} TMaskScan;
+
+
+static void
+prepareMaskScan(
+	TMaskScan* scan,  // OUT
+	guint depth,
+	Pixelel maskValue,
+	gboolean isEqual,
+	TPixelelIndex alphaIndex)
+{
+	guint i;
+
+	g_assert(depth && (depth & (depth - 1)) == 0 && depth <= MASK_SCAN_BYTES);
+	g_assert(alphaIndex < depth);
+	scan->depth = depth;
+	for (scan->depthShift = 0; (1u << scan->depthShift) < depth; scan->depthShift++)
+		;
+	scan->pixelBits = 0;
+	for (i = 0; i < MASK_SCAN_BYTES; i += depth)
+		scan->pixelBits |= 1u << i;
+	scan->maskValue = maskValue;
+	scan->isEqual = isEqual;
+	scan->alphaIndex = alphaIndex;
+}
+
+
+static inline guint
+countMaskScanBits(TMaskScanBits bits)
+{
+#ifdef __GNUC__
+	return __builtin_popcount(bits);
+#else
+	guint count = 0;
+	for (; bits; bits &= bits - 1)
+		count++;
+	return count;
+#endif
+}
+
+
+/* Index of the lowest bit.  bits must not be zero. */
+static inline guint
+lowestMaskScanBit(TMaskScanBits bits)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(bits);
+#else
+	guint index = 0;
+	for (; !(bits & 1); bits >>= 1)
+		index++;
+	return index;
+#endif
+}
+
+
+/* Bits of the bytes of a chunk that equal value.  Only the bits of pixels are meaningful. */
+static inline TMaskScanBits
+equalMaskScanBits(
+	const Pixelel* chunk,
+	Pixelel value,
+	const TMaskScan* scan)
+{
+#ifdef MASK_SCAN_SSE2
+	(void)scan;  // All bytes at once, whatever the depth
+	__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk));
+	return static_cast<TMaskScanBits>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(value)))));
+#else
+	TMaskScanBits bits = 0;
+	guint i;
+	for (i = 0; i < MASK_SCAN_BYTES; i += scan->depth)
+		if (chunk[i] == value)
+			bits |= 1u << i;
+	return bits;
+#endif
+}
+
+
+/*
+Bits of the pixels of a chunk that the scan finds.
+Reads MASK_SCAN_BYTES + alphaIndex bytes from chunk.
+*/
+static inline TMaskScanBits
+maskScanChunk(
+	const Pixelel* chunk,
+	const TMaskScan* scan)
+{
+	TMaskScanBits bits = equalMaskScanBits(chunk + MASK_PIXELEL_INDEX, scan->maskValue, scan);
+
+	if (!scan->isEqual)
+		bits = ~bits;
+	// Loaded from the alpha pixelel, the bits of alpha fall where the bits of pixels do
+	if (scan->alphaIndex)
+		bits &= ~equalMaskScanBits(chunk + scan->alphaIndex, ALPHA_TOTAL_TRANSPARENCY, scan);
+	return bits & scan->pixelBits;
+}
+
+
+static inline gboolean
+maskScanPixel(
+	const Pixelel* pixel,
+	const TMaskScan* scan)
+{
+	return ((pixel[MASK_PIXELEL_INDEX] == scan->maskValue) == (scan->isEqual != FALSE))
+		&& (!scan->alphaIndex || pixel[scan->alphaIndex] != ALPHA_TOTAL_TRANSPARENCY);
+}
+
+
+/* Count of the pixels in a row (width pixels from row) that the scan finds. */
+static inline guint
+countMaskScanRow(
+	const Pixelel* row,
+	guint width,
+	const TMaskScan* scan)
+{
+	const guint rowBytes = width * scan->depth;
+	guint count = 0;
+	guint offset = 0;
+	guint x;
+
+	// Whole chunks whose alpha load also stays in the row
+	for (; offset + MASK_SCAN_BYTES + scan->depth <= rowBytes; offset += MASK_SCAN_BYTES)
+		count += countMaskScanBits(maskScanChunk(row + offset, scan));
+	for (x = offset >> scan->depthShift; x < width; x++)
+		count += maskScanPixel(row + (x << scan->depthShift), scan);
+	return count;
+}
+
+
+/* Call pointFunc(x) for each pixel of a row that the scan finds, in order of x. */
+template<typename PointFunc>
+static inline void
+forEachMaskScanRow(
+	const Pixelel* row,
+	guint width,
+	const TMaskScan* scan,
+	PointFunc pointFunc)
+{
+	const guint rowBytes = width * scan->depth;
+	guint offset = 0;
+	guint x;
+
+	for (; offset + MASK_SCAN_BYTES + scan->depth <= rowBytes; offset += MASK_SCAN_BYTES)
+	{
+		TMaskScanBits bits = maskScanChunk(row + offset, scan);
+		for (; bits; bits &= bits - 1)
+			pointFunc((offset + lowestMaskScanBit(bits)) >> scan->depthShift);
+	}
+	for (x = offset >> scan->depthShift; x < width; x++)
+		if (maskScanPixel(row + (x << scan->depthShift), scan))
+			pointFunc(x);
+}
+
+
+/* For each pixel of a row, write whether the scan finds it, TRUE or FALSE, to a byte of flags. */
+static inline void
+writeMaskScanRow(
+	const Pixelel* row,
+	guint width,
+	const TMaskScan* scan,
+	guchar* __restrict flags)
+{
+	const guint rowBytes = width * scan->depth;
+	const guint chunkPixels = MASK_SCAN_BYTES >> scan->depthShift;
+	guint offset = 0;
+	guint x;
+
+	for (; offset + MASK_SCAN_BYTES + scan->depth <= rowBytes; offset += MASK_SCAN_BYTES)
+	{
+		TMaskScanBits bits = maskScanChunk(row + offset, scan);
+		guchar* chunkFlags = flags + (offset >> scan->depthShift);
+		guint k;
+
+		for (k = 0; k < chunkPixels; k++)
+			chunkFlags[k] = (bits >> (k << scan->depthShift)) & 1;
+	}
+	for (x = offset >> scan->depthShift; x < width; x++)
+		flags[x] = maskScanPixel(row + (x << scan->depthShift), scan);
+}
+
+
+#endif /* RESYNTH_MASK_SCAN_H_ */
@@ -182,6 +182,17 @@ quantizeMapMetricFunc(
 
 
 
+/*
+Arithmetic metrics of the color difference of two pixels (see colorDifference()), instead of lookups in corpusTargetMetric:
+no load dependent on each pixelel difference.
+Scaled so the extreme difference of a pixelel, 255, weighs about MAX_WEIGHT, as for the Cauchy metric,
+so that weights of maps and of clipped neighbors keep their proportion.
+SAD weighs a pixelel difference times SAD_SCALE.
+SSD weighs it squared, the extreme 255*255 already about MAX_WEIGHT.
+*/
+#define SAD_SCALE (MAX_WEIGHT / 255)  // 257
+
+
 /*
 Quantize the metric functions.
 Two functions: for target/corpus match, and for targetmap/corpusmap match.
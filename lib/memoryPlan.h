@@ -0,0 +1,178 @@
+/*
+Memory of a run of the engine: an estimate without allocating, and strategies under a budget (parameter maxMemoryBytes.)
+
+A run allocates, in its arena (see imageSynthArena.h), maps the size of the target image
+(hasValueMap, sourceOfMap) and of the corpus (recentProberMap), vectors of the target and corpus points,
+and sortedOffsets, twice the smaller of target and corpus in each dimension, i.e. four times its pixels.
+Besides, temporaries on the heap, not all at once: the buffers of sorting the offsets,
+then of ordering the target points, then during synthesis, the energies of the target points and the tiled copy of the corpus (see corpusTiles.h.)
+The peak is the arena, which the engine reserves whole (so it doesn't grow geometrically), plus the most of the temporaries.
+
+The estimate follows the allocations of engine() and the functions it calls: change both together.
+Given only bounds, it bounds the count of target points by their area, so it is not less than the run.
+
+Over budget, strategies of less memory, in order:
+- without the tiled copy of the corpus: the same result, slower for a large corpus.
+- sortedOffsets within a radius, the largest that fits, but not less than IMAGE_SYNTH_MIN_OFFSETS_RADIUS.
+  Sorting the offsets is most of the peak for a large image, while a patch needs only the nearest.
+  A target point whose nearest neighbors with values are farther than the radius has fewer neighbors:
+  only on the first pass, deep within a large target.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_MEMORY_PLAN_H_
+#define RESYNTH_MEMORY_PLAN_H_
+
+// Per point sorted by sortPointsByKey(): its key, and the other buffers of points and keys
+#define SORT_TEMPORARY_BYTES (2 * sizeof(guint) + sizeof(Coordinates))
+
+
+/* Strategies of a run, and their memory. */
+typedef struct {
+	gboolean isCorpusTiled;  // Parameter isCorpusTiled, unless the budget excludes the tiled copy
+	guint offsetsRadius;     // Of sortedOffsets, zero for all
+	size_t arenaBytes;       // Total of the allocations in the arena
+	size_t peakBytes;        // The reserved arena, plus the most temporaries at once
+} TMemoryPlan;
+
+
+static inline size_t arenaAllocationBytes(size_t bytes)
+{
+	return (bytes + IMAGE_SYNTH_ARENA_ALIGN - 1) & ~(static_cast<size_t>(IMAGE_SYNTH_ARENA_ALIGN) - 1);
+}
+
+
+/* See new_arena_map() */
+static inline size_t arenaMapBytes(guint width, guint height, size_t depth)
+{
+	return arenaAllocationBytes((size_t)width * height * depth + IMAGE_SYNTH_PIXMAP_TAIL_PAD);
+}
+
+
+/* See new_point_vector() */
+static inline size_t arenaPointVectorBytes(size_t capacity)
+{
+	return arenaAllocationBytes(sizeof(TPointVectorStruct)) + arenaAllocationBytes(capacity * sizeof(Coordinates));
+}
+
+
+/* See prepareCorpusTiles() */
+static inline size_t corpusTilesBytes(const TEngineMemoryShape* shape)
+{
+	size_t tilesPerRow = (shape->corpusWidth + CORPUS_TILE_MASK) >> CORPUS_TILE_SHIFT;
+	size_t tileRows = (shape->corpusHeight + CORPUS_TILE_MASK) >> CORPUS_TILE_SHIFT;
+	return tilesPerRow * tileRows * CORPUS_TILE_SIDE * CORPUS_TILE_SIDE * (1 + shape->matchDepth);
+}
+
+
+/* Memory of the strategies in plan (isCorpusTiled, offsetsRadius.) */
+static void estimateMemoryPlan(
+	TMemoryPlan* plan,  // IN/OUT
+	const TEngineMemoryShape* shape)
+{
+	gint offsetsWidth;
+	gint offsetsHeight;
+	size_t offsets = countSortedOffsets(shape->targetWidth, shape->targetHeight, shape->corpusWidth, shape->corpusHeight,
+		plan->offsetsRadius, &offsetsWidth, &offsetsHeight);
+	size_t offsetsTemporary;
+	size_t orderTemporary;
+	size_t synthesisTemporary;
+
+	plan->arenaBytes =
+		arenaMapBytes(shape->targetWidth, shape->targetHeight, 1)                         // hasValueMap
+		+ arenaPointVectorBytes(shape->targetCount)                                       // targetPoints
+		+ arenaMapBytes(shape->targetWidth, shape->targetHeight, sizeof(Coordinates))     // sourceOfMap
+		+ arenaPointVectorBytes((size_t)shape->corpusWidth * shape->corpusHeight)         // corpusPoints, reserved for all
+		+ arenaPointVectorBytes(offsets)                                                  // sortedOffsets
+		+ arenaMapBytes(shape->corpusWidth, shape->corpusHeight, sizeof(guint));          // recentProberMap
+
+	offsetsTemporary = offsets * SORT_TEMPORARY_BYTES;
+	// Sorting target points, then the blocks and reordered copy of a local order, or the distance grid of brushfire
+	orderTemporary = (size_t)shape->targetCount * (SORT_TEMPORARY_BYTES + sizeof(TBlockRun) + sizeof(Coordinates))
+		+ (size_t)(shape->targetBoundsWidth + 2) * (shape->targetBoundsHeight + 2) * sizeof(guint);
+	// Energies of the target points (see sumTargetEnergies()), results of a phase of deterministic synthesis
+	synthesisTemporary = (size_t)shape->targetCount * sizeof(TTargetEnergy) + IMAGE_SYNTH_PHASE_MAX_TARGETS * sizeof(TPhasedResult);
+	if (plan->isCorpusTiled)
+		synthesisTemporary += corpusTilesBytes(shape);
+
+	plan->peakBytes = imageSynthArenaReservedBytes(plan->arenaBytes, TRUE)
+		+ MAX(offsetsTemporary, MAX(orderTemporary, synthesisTemporary));
+}
+
+
+/*
+Pick the strategies of a run under parameters->maxMemoryBytes, see above.
+Returns whether they fit.  If not, plan is the strategies of the least memory.
+*/
+static gboolean planMemory(
+	TMemoryPlan* plan,  // OUT
+	const TImageSynthParameters* parameters,
+	const TEngineMemoryShape* shape)
+{
+	const size_t maxBytes = static_cast<size_t>(parameters->maxMemoryBytes);
+	guint leastRadius = IMAGE_SYNTH_MIN_OFFSETS_RADIUS;
+	guint mostRadius = MAX(shape->targetWidth, shape->targetHeight);  // Any radius beyond spans all
+
+	plan->isCorpusTiled = parameters->isCorpusTiled;
+	plan->offsetsRadius = 0;
+	estimateMemoryPlan(plan, shape);
+	if (!maxBytes || plan->peakBytes <= maxBytes)
+		return TRUE;
+
+	plan->isCorpusTiled = FALSE;
+	estimateMemoryPlan(plan, shape);
+	if (plan->peakBytes <= maxBytes || mostRadius <= leastRadius)
+		return plan->peakBytes <= maxBytes;
+
+	plan->offsetsRadius = leastRadius;
+	estimateMemoryPlan(plan, shape);
+	if (plan->peakBytes > maxBytes)
+		return FALSE;
+
+	// The largest radius that fits: the memory grows with the radius
+	while (leastRadius < mostRadius)
+	{
+		guint radius = leastRadius + (mostRadius - leastRadius + 1) / 2;
+		plan->offsetsRadius = radius;
+		estimateMemoryPlan(plan, shape);
+		if (plan->peakBytes <= maxBytes)
+			leastRadius = radius;
+		else
+			mostRadius = radius - 1;
+	}
+	plan->offsetsRadius = leastRadius;
+	estimateMemoryPlan(plan, shape);
+	return TRUE;
+}
+
+
+int
+engineEstimateMemory(
+	const TImageSynthParameters* parameters,
+	const TEngineMemoryShape* shape,
+	size_t* peakBytes)
+{
+	TMemoryPlan plan;
+	gboolean isFitting = planMemory(&plan, parameters, shape);
+
+	*peakBytes = plan.peakBytes;
+	return isFitting ? IMAGE_SYNTH_SUCCESS : IMAGE_SYNTH_ERROR_MEMORY_LIMIT;
+}
+
+
+#endif /* RESYNTH_MEMORY_PLAN_H_ */
@@ -5,8 +5,9 @@ first synthesizing target points near the context can give *better* results
 but can also lead to artifacts: objects bleeding from the context into the target.
 Originally, there was only one method of ordering: random over the entire target.
 Added methods of ordering by distance from center.
-
-TODO ordering by a thinning, or brushfire, algorithm, i.e. distance from context, not from center.
+Added ordering by a thinning, or brushfire, algorithm, i.e. distance from context, not from center.
+The randomizing draws from a TProbeRandom (see counterRandom.h):
+the shared PRNG, or for deterministic synthesis, a stream of the seed, which no other caller of rand() disturbs.
 
   Copyright (C) 2010, 2011  Lloyd Konneker
 
@@ -34,12 +35,12 @@ TODO ordering by a thinning, or brushfire, algorithm, i.e. distance from context
  * Order vector of target pixels: shuffle randomly
  * This is the single, original method of randomizing.
  */
-static void orderTargetPointsRandom(PointVector targetPoints, GRand *prng)
+static void orderTargetPointsRandom(PointVector targetPoints, TProbeRandom* random)
 {
 	guint i;
 	for (i = 0; i < targetPoints->len; i++)
 	{
-		guint j = g_rand_int_range(prng, 0, targetPoints->len);
+		guint j = drawRandomRange(random, targetPoints->len);
 		swap_vector_elements(targetPoints, targetPoints->len, i, j);
 	}
 }
@@ -53,10 +54,11 @@ static void orderTargetPointsRandom(PointVector targetPoints, GRand *prng)
  * elements can only move the band size forward.
  * TODO another method of random bands that is symmetric.
  */
-static void randomizeBandsTargetPoints(PointVector targetPoints, GRand *prng)
+template<typename T>
+static void randomizeBands(T* elements, guint count, TProbeRandom* random)
 {
-	gint last = targetPoints->len - 1;
-	gint halfBand = static_cast<int>(targetPoints->len * IMAGE_SYNTH_BAND_FRACTION);
+	gint last = count - 1;
+	gint halfBand = static_cast<int>(count * IMAGE_SYNTH_BAND_FRACTION);
 	gint i;
 	for (i = 0; i <= last; i++)
 	{
@@ -68,84 +70,168 @@ static void randomizeBandsTargetPoints(PointVector targetPoints, GRand *prng)
 		gint bandStart = MAX(i - halfBand, 0);  // bandStart in [0, last-halfBand]
 		gint bandEnd = MIN(i + halfBand, last); // bandEnd in [halfBand, last]
 		gint bandSize = bandEnd - bandStart;
-		gint j = bandStart + g_rand_int_range(prng, 0, bandSize);
-		swap_vector_elements(targetPoints, targetPoints->len, i, j);
+		gint j = bandStart + drawRandomRange(random, bandSize);
+		std::swap(elements[i], elements[j]);
 	}
 }
 
+
+static void randomizeBandsTargetPoints(PointVector targetPoints, TProbeRandom* random)
+{
+	if (targetPoints->len == 0) return;
+	randomizeBands(&targetPoints->data[0], targetPoints->len, random);
+}
+
+
 #ifdef TODO
 /*
 This is an alternate version that doesn't move front elements indefinitely far to the back.
 Seems to make no difference in practice.
 */
 void randomizeBandsTargetPoints2(
-	GRand *prng
+	TProbeRandom* random
 	)
 {
 	gint last = targetPoints->len - 1;
 	gint halfBand = targetPoints->len * IMAGE_SYNTH_BAND_FRACTION;
 	gint i;
 
-	GArray * moved;
-	moved = g_array_sized_new(TRUE, TRUE, sizeof(gboolean), targetPoints->len);
+	std::vector<gboolean> moved(targetPoints->len, FALSE);
 
 	for (i = 0; i <= last; i++)
 	{
 		/* If the source is not the original (another has been moved already here already), skip */
-		if (g_array_index(moved, gboolean, i))
+		if (moved[i])
 			continue;
 
 		gint bandStart = MAX(i - halfBand, 0);  // bandStart in [0, last-halfBand]
 		gint bandEnd = MIN(i + halfBand, last); // bandEnd in [halfBand, last]
 		gint bandSize = bandEnd - bandStart;
-		gint j = bandStart + g_rand_int_range(prng, 0, bandSize);
+		gint j = bandStart + drawRandomRange(random, bandSize);
 
 
 		swap_vector_elements(targetPoints, targetPoints->len, i, j);
 		/* Mark both sides moved. */
-		g_array_index(moved, gboolean, i) = TRUE;
-		g_array_index(moved, gboolean, j) = TRUE;
+		moved[i] = TRUE;
+		moved[j] = TRUE;
 	}
 }
 #endif
 
 /*
- * Coordinates to and from offsets.
- * Add or subtract a point (e.g. a center.)
+ * Index of a point along a Hilbert curve filling a square of side (a power of two.)
+ * Consecutive indices are adjacent points.
  */
-static void targetPoints_to_offsets(Coordinates center, PointVector targetPoints)
+static guint hilbertIndex(guint side, guint x, guint y)
 {
-	// Coords => offsets from center
-	guint i;
-	for (i = 0; i < targetPoints->len; i++)
+	guint index = 0;
+	guint s;
+	for (s = side / 2; s > 0; s /= 2)
 	{
-		// c++ targetPoints[i] = subtract_points(targetPoints[i], center);
-		g_array_index(targetPoints, Coordinates, i) = subtract_points(g_array_index(targetPoints, Coordinates, i), center);
+		guint rx = (x & s) > 0;
+		guint ry = (y & s) > 0;
+		index += s * s * ((3 * rx) ^ ry);
+		// Rotate the quadrant
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = side - 1 - x;
+				y = side - 1 - y;
+			}
+			std::swap(x, y);
+		}
 	}
+	return index;
 }
 
 
-static void targetPoints_from_offsets(Coordinates center, PointVector targetPoints)
+// A run of target points in one block, after sorting along the curve
+typedef struct {
+	guint start;
+	guint count;
+} TBlockRun;
+
+
+/*
+ * Random order, in blocks, for cache locality (parameter localityBlockSize.)
+ *
+ * A full random shuffle scatters consecutive target points across the image,
+ * so gathering their neighbors (prepare_neighbors) reads the maps at random addresses.
+ * Here the target's bounds are divided into square blocks.
+ * Blocks are ordered along a Hilbert curve, then randomized in bands,
+ * and target points are shuffled within each block.
+ * Consecutive target points are in the same block, and consecutive blocks are usually near each other.
+ * Still random enough at the scale of the image to avoid directional artifacts.
+ */
+static void orderTargetPointsRandomBlocks(PointVector targetPoints, guint blockSize, TProbeRandom* random)
 {
 	guint i;
-	// offsets from center => Coords
-	for (i = 0; i < targetPoints->len; i++)
+	guint count = targetPoints->len;
+
+	if (count == 0) return;
+
+	Bounds bounds = get_bounds(targetPoints, count);
+	guint blocksWide = (bounds.lrx - bounds.ulx) / blockSize + 1;
+	guint blocksHigh = (bounds.lry - bounds.uly) / blockSize + 1;
+	guint side = 1;
+	while (side < MAX(blocksWide, blocksHigh))
+		side *= 2;
+
+	// Sort along the curve, so the points of each block are a run
+	TSortKeys keys(count);
+	for (i = 0; i < count; i++)
 	{
-		g_array_index(targetPoints, Coordinates, i) = add_points(g_array_index(targetPoints, Coordinates, i), center);
+		Coordinates point = targetPoints->data[i];
+		keys[i] = hilbertIndex(side, (point.x - bounds.ulx) / blockSize, (point.y - bounds.uly) / blockSize);
 	}
-}
+	sortPointsByKey(targetPoints, keys);
 
+	std::vector<TBlockRun> blocks;
+	for (i = 0; i < count; i++)
+	{
+		if (i == 0 || keys[i] != keys[i - 1])
+		{
+			TBlockRun run = { i, 0 };
+			blocks.push_back(run);
+		}
+		blocks.back().count++;
+	}
+
+	randomizeBands(blocks.data(), static_cast<guint>(blocks.size()), random);
+
+	// Gather the blocks in their new order, shuffling within each block
+	std::vector<Coordinates> ordered;
+	ordered.reserve(count);
+	for (const TBlockRun& block : blocks)
+	{
+		guint blockStart = static_cast<guint>(ordered.size());
+		for (i = 0; i < block.count; i++)
+			ordered.push_back(targetPoints->data[block.start + i]);
+		for (i = 0; i < block.count; i++)
+		{
+			guint j = drawRandomRange(random, block.count);
+			std::swap(ordered[blockStart + i], ordered[blockStart + j]);
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		targetPoints->data[i] = ordered[i];
+}
 
 
 /*
  * Order target points by 2D distance from target center, then randomize in bands.
- * Note the compare function changes the direction, eg inward, outward, horizontal, vertical, etc.
+ * Note the key function and isDescending give the direction, eg inward, outward, horizontal, vertical, etc.
  */
-static void orderTargetPointsRandomDirectional(// c++ bool (*compare) (const Coordinates, const Coordinates)
-	gint(*compare)(const void*, const void*),
+static void orderTargetPointsRandomDirectional(
+	SortKeyFunc keyFunc,
+	gboolean isDescending,  // farthest from center first, i.e. inward
 	PointVector targetPoints,
-	GRand *prng)
+	TProbeRandom* random)
 {
+	guint i;
+
 	/*
 	 * Get rough coords for the center.
 	 * !!! Of the target, not the entire source context nor the corpus.
@@ -154,100 +240,64 @@ static void orderTargetPointsRandomDirectional(// c++ bool (*compare) (const Coo
 	 */
 	Coordinates center = get_center(targetPoints, targetPoints->len);
 
-	targetPoints_to_offsets(center, targetPoints);
+	// Key of the offset from center, computed once per point
+	TSortKeys keys(targetPoints->len);
+	for (i = 0; i < targetPoints->len; i++)
+		keys[i] = keyFunc(subtract_points(targetPoints->data[i], center));
 
-	// ascending or descending, outward or inward, concentric or linear, depending on compare function
-	// c++ sort(targetPoints.begin(), targetPoints.end(), compare);  
-	g_array_sort(targetPoints, compare);
+	// ascending or descending, outward or inward, concentric or linear, depending on key function
+	if (isDescending)
+		invertSortKeys(keys);
+	sortPointsByKey(targetPoints, keys);
 
-	targetPoints_from_offsets(center, targetPoints);
-	randomizeBandsTargetPoints(targetPoints, prng);
+	randomizeBandsTargetPoints(targetPoints, random);
 }
 
 
-
-
-
+/*
+ * Order target points by distance from the context (see brushfire.h), then randomize in bands.
+ * Inward: nearest the context first.  Outward: farthest from the context first.
+ */
 static void
 orderTargetPointsRandomBrushfire(
-	// c++ bool (*compare) (const Coordinates, const Coordinates)
-	gint(*compare)(const void*, const void*),
+	gboolean isOutward,
 	PointVector targetPoints,
-	GRand *prng
+	Map* hasValueMap,
+	TProbeRandom* random
 	)
 {
-	Coordinates center = get_center(targetPoints, targetPoints->len);
-	targetPoints_to_offsets(center, targetPoints);
-	// Coordinates are now offsets.
-	GArray* sortArray = targetPointsToSortArray(targetPoints);
-	g_array_sort(sortArray, compare);  // outward or inward  compare function
-	targetPointsFromSortArray(targetPoints, sortArray);
-	targetPoints_from_offsets(center, targetPoints);
-	randomizeBandsTargetPoints(targetPoints, prng);
-}
-
+	TDistanceGrid grid;
 
+	if (targetPoints->len == 0) return;
+	prepareDistanceGrid(&grid, targetPoints, hasValueMap);
+	sortTargetPointsByDistance(targetPoints, &grid, isOutward);
+	randomizeBandsTargetPoints(targetPoints, random);
+}
 
 
 /*
-Random squeeze: order the target points both directions, in and out by distance from center.
-Used if the target is a donut, with context inside and outside.
-*/
-static void orderTargetPointsRandomSqueeze(
+ * Brushfire that burns away from the center of the target's bounds.
+ * For uncrop, the center is context (the original image) and the fire burns outward from it, i.e. inward from the context.
+ * For a hole, the center is target and the fire burns outward from it, i.e. toward the context.
+ */
+static void
+orderTargetPointsRandomBrushfireFromCenter(
 	PointVector targetPoints,
-	GRand *prng
+	Map* hasValueMap,
+	TProbeRandom* random
 	)
 {
-	guint i;
-	PointVector target_temp;
+	TDistanceGrid grid;
 
+	if (targetPoints->len == 0) return;
+	prepareDistanceGrid(&grid, targetPoints, hasValueMap);
 	Coordinates center = get_center(targetPoints, targetPoints->len);
-
-	targetPoints_to_offsets(center, targetPoints); // Temporarily: Coords => to offsets from center
-	GArray* sortArray = targetPointsToSortArray(targetPoints);
-
-	// Algorithm: shuffle (one from each end alternatively, not random.)
-
-	// Sort ascending on distance from center
-	// c++ sort(targetPoints.begin(), targetPoints.end(), lessCartesian);   
-	g_array_sort(sortArray, (gint(*)(const void*, const void*)) moreInward);
-
-	// Copy targetPoints vector
-	target_temp = g_array_sized_new(FALSE, TRUE, sizeof(Coordinates), targetPoints->len);
-
-	for (i = 0; i < targetPoints->len; i++)
-		g_array_index(target_temp, Coordinates, i) = g_array_index(targetPoints, Coordinates, i);
-
-	// Shuffle back into the original
-	{
-		guint pointCount = targetPoints->len;
-		gint frontIndex = 0;
-		gint backIndex = pointCount - 1;
-
-		i = 0;
-		while (TRUE)
-		{
-			// Copy from front.
-			// c++ targetPoints[i] = targetTemp[frontIndex];
-			g_array_index(targetPoints, Coordinates, i) = g_array_index(target_temp, Coordinates, frontIndex);
-			i++;
-			frontIndex++;
-			if (i >= pointCount) break;
-			// Copy from back.
-			// c++ targetPoints[i] = targetTemp[backIndex]; // Backwards
-			g_array_index(targetPoints, Coordinates, i) = g_array_index(target_temp, Coordinates, backIndex);
-			i++;
-			backIndex--;
-			if (i >= pointCount) break;
-		}
-	}
-
-	targetPointsFromSortArray(targetPoints, sortArray);
-	targetPoints_from_offsets(center, targetPoints); // offsets => coordinates
-	randomizeBandsTargetPoints(targetPoints, prng);
-	g_array_free(target_temp, TRUE);
+	gboolean isCenterContext = (*distanceAtPoint(&grid, center) == 0);
+	sortTargetPointsByDistance(targetPoints, &grid, !isCenterContext);
+	randomizeBandsTargetPoints(targetPoints, random);
 }
 
+
 /*
 Order the vector of target points in one of many ways
 specified by parameter use_border.
@@ -256,69 +306,64 @@ int
 orderTargetPoints(
 	TImageSynthParameters* parameters,
 	PointVector targetPoints,
-	GRand *prng
+	Map* hasValueMap,  // context, i.e. where the brushfire starts
+	TProbeRandom* random
 	)
 {
 	switch (parameters->matchContextType)
 	{
 	case 0: /* Random order, not using context in matches. */
 	case 1: /* Random order, using context in matches. */
-		orderTargetPointsRandom(targetPoints, prng);
+		if (parameters->localityBlockSize > 0)
+			orderTargetPointsRandomBlocks(targetPoints, parameters->localityBlockSize, random);
+		else
+			orderTargetPointsRandom(targetPoints, random);
 		break;
 	case 2: /* Randomized bands, concentric, inward */
-		orderTargetPointsRandomBrushfire(
-			(gint(*)(const void*, const void*)) moreInward,
-			targetPoints,
-			prng
-			);
-		/* Formerly moreCartesian */
+		orderTargetPointsRandomBrushfire(FALSE, targetPoints, hasValueMap, random);
+		/* Formerly moreCartesian, then moreInward (proportional distance to center along rays) */
 		break;
 	case 3:
 		orderTargetPointsRandomDirectional(
-			(gint(*)(const void*, const void*)) moreHorizontal,
+			horizontalKey, TRUE,
 			targetPoints,
-			prng
+			random
 			);
 		// randomized bands, horizontally, inwards.  IE squeezing from top and bottom
 		break;
 	case 4:
 		orderTargetPointsRandomDirectional(
-			(gint(*)(const void*, const void*)) moreVertical,
+			verticalKey, TRUE,
 			targetPoints,
-			prng
+			random
 			);
 		// randomized bands, vertically, inwards.  IE squeezing from sides.
 		break;
 	case 5:
-		orderTargetPointsRandomBrushfire(
-			(gint(*)(const void*, const void*)) lessInward,
-			targetPoints,
-			prng
-			);
-		// randomized bands, concentric, outward (eg for uncrop)
+		orderTargetPointsRandomBrushfireFromCenter(targetPoints, hasValueMap, random);
+		// randomized bands, concentric, outward from center (eg for uncrop)
 		break;
 	case 6:
 		orderTargetPointsRandomDirectional(
-			(gint(*)(const void*, const void*)) lessHorizontal,
+			horizontalKey, FALSE,
 			targetPoints,
-			prng
+			random
 			);
 		// randomized bands, horizontally, outwards.   IE expanding to top and bottom
 		break;
 	case 7:
 		orderTargetPointsRandomDirectional(
-			(gint(*)(const void*, const void*)) lessVertical,
+			verticalKey, FALSE,
 			targetPoints,
-			prng
+			random
 			);
 		// randomized bands, vertically, outwards.  IE expanding to sides
 		break;
 	case 8:
-		orderTargetPointsRandomSqueeze(
-			targetPoints,
-			prng
-			);
-		// randomized bands, concentric squeezing in and out a donut
+		orderTargetPointsRandomBrushfire(FALSE, targetPoints, hasValueMap, random);
+		// randomized bands, concentric squeezing in and out a donut.
+		// Formerly interleaved the order by distance from center with its reverse;
+		// a brushfire burns from the context inside and outside the donut.
 		break;
 	default:
 		// no gimp: gimp_message("Parameter use_border out of range."); 
@@ -49,10 +49,231 @@ TODO experiments on other ways of repeating synthesis.
 #define RESYNTH_PASSES_H_
 
 #include <cstdio>
+#include <cstring>
+#include <chrono>
 
-#define MAX_PASSES 6
+#define MAX_PASSES IMAGE_SYNTH_MAX_PASSES
 typedef guint TRepetionParameters[MAX_PASSES][2];
 
+
+/*
+Tally of one pass, or of one thread's slice of a pass.
+Each thread tallies privately, without locks or atomics, so tallying is always on.
+refiner() sums the tallies when the threads rejoin.
+*/
+typedef struct passTallyStruct {
+	guint targetCount;  // target points synthesized
+	guint betters;      // target points given a new source
+	guint bettersByNeighborsSource;  // of betters, new source found by heuristic 1
+	guint bettersByRandom;           // of betters, new source found by random probe
+	guint perfectMatches;            // target points whose probing ended on a perfect match
+	guint64 energy;     // sum of best patch difference over target points synthesized
+	guint64 probes;     // corpus patches compared with target patches, by computeBestFit()
+	guint64 earlyOuts[IMAGE_SYNTH_MAX_NEIGHBORS];  // probes quit at neighbor index
+	Bounds changedBounds;  // of target points given a new source, for previews
+	guint64 targetEnergy;     // after the pass, over all target points, not summed: see sumTargetEnergies()
+	guint64 targetNeighbors;  // after the pass, neighbors matched over all target points, likewise
+} TPassTally;
+
+
+/* Latest best patch difference of a target point, and the count of neighbors it matched. */
+typedef struct targetEnergyStruct {
+	guint energy;
+	guint neighbors;
+} TTargetEnergy;
+
+
+static inline void resetPassTally(TPassTally* tally)
+{
+	memset(tally, 0, sizeof(TPassTally));
+	tally->changedBounds = emptyBounds();
+}
+
+
+static inline void addPassTally(TPassTally* sum, const TPassTally* addend)
+{
+	guint i;
+
+	sum->targetCount += addend->targetCount;
+	sum->betters += addend->betters;
+	sum->bettersByNeighborsSource += addend->bettersByNeighborsSource;
+	sum->bettersByRandom += addend->bettersByRandom;
+	sum->perfectMatches += addend->perfectMatches;
+	sum->energy += addend->energy;
+	sum->probes += addend->probes;
+	for (i = 0; i < IMAGE_SYNTH_MAX_NEIGHBORS; i++)
+		sum->earlyOuts[i] += addend->earlyOuts[i];
+	sum->changedBounds = unionBounds(sum->changedBounds, addend->changedBounds);
+}
+
+
+/*
+Energy of the whole target: the sums over all target points of their latest best patch difference,
+and of the count of neighbors the difference is over.
+A target point not synthesized in a pass keeps its difference from the pass that last did.
+*/
+static inline void sumTargetEnergies(const std::vector<TTargetEnergy>& targetEnergies, TPassTally* tally)
+{
+	tally->targetEnergy = 0;
+	tally->targetNeighbors = 0;
+	for (const TTargetEnergy& targetEnergy : targetEnergies)
+	{
+		tally->targetEnergy += targetEnergy.energy;
+		tally->targetNeighbors += targetEnergy.neighbors;
+	}
+}
+
+
+/*
+Energy of the whole target per matched neighbor.
+Comparable between passes, unlike the sum:
+a patch of the first pass has few neighbors, and later patches have more, so more difference.
+*/
+static inline gdouble targetEnergyPerNeighbor(const TPassTally* tally)
+{
+	return tally->targetNeighbors ? static_cast<gdouble>(tally->targetEnergy) / tally->targetNeighbors : 0;
+}
+
+
+static inline gdouble millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<gdouble, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/*
+Schedule of one pass, for anytime synthesis (parameter maxMilliseconds.)
+The first pass is a fill pass: target points have no value yet, so it must complete.
+Later passes are refinement passes, that can quit at the deadline
+since every target point already has a value.
+*/
+typedef struct passScheduleStruct {
+	guint maxProbeCount;   // random probes per target point
+	gboolean isFillPass;
+	gboolean hasDeadline;
+	std::chrono::steady_clock::time_point deadline;
+} TPassSchedule;
+
+
+static void preparePassSchedule(
+	TPassSchedule* schedule,  // OUT
+	const TImageSynthParameters* parameters,
+	guint pass,
+	std::chrono::steady_clock::time_point startTime
+	)
+{
+	schedule->isFillPass = (pass == 0);
+	schedule->hasDeadline = (parameters->maxMilliseconds > 0);
+	schedule->deadline = startTime + std::chrono::milliseconds(parameters->maxMilliseconds);
+	schedule->maxProbeCount = parameters->maxProbeCount;
+	if (schedule->isFillPass && schedule->hasDeadline)
+	{
+		// Fast fill, leaving time to refine.  But at least one probe, so every target point gets a source.
+		schedule->maxProbeCount = MAX(parameters->maxProbeCount / IMAGE_SYNTH_FILL_PROBE_DIVISOR, 1);
+	}
+}
+
+
+/*
+Whether the deadline is past.
+Called from synthesize() every so often, then:
+a refinement pass quits; a fill pass continues without searching (see quickFillTargetPoint()) to finish the fill.
+*/
+static inline gboolean isPastDeadline(const TPassSchedule* schedule)
+{
+	return schedule->hasDeadline && std::chrono::steady_clock::now() >= schedule->deadline;
+}
+
+
+/*
+Whether to quit making passes, after a pass.
+Returns the reason, or IMAGE_SYNTH_TERMINATION_ALL_PASSES to continue (or when the pass was the last.)
+
+Default rule: quit if a small fraction of target is bettered.
+This is a fraction of total target points,
+not the possibly smaller count of target attempts this pass.
+
+Energy rule (if parameter energyTerminateFraction): quit if the energy of the whole target
+per matched neighbor (see targetEnergyPerNeighbor()) decreased, by less than the fraction, from the prior pass.
+The whole target, since later passes synthesize a prefix of the target points:
+the energies of two passes are over the same points.
+An increase is not convergence: then the default rule applies instead.
+Not applied to the first two passes:
+on the first pass, patches are sparse, so its energy is not comparable to later passes.
+
+Either rule, quit if the time budget is spent.
+*/
+static TImageSynthTermination terminationAfterPass(
+	const TImageSynthParameters* parameters,
+	guint pass,
+	const TPassTally* tally,
+	const TPassTally* priorTally,  // tally of pass-1, unused when pass==0
+	guint countTargetPoints,
+	std::chrono::steady_clock::time_point startTime,
+	int* cancelFlag
+	)
+{
+	if (*cancelFlag)
+		return IMAGE_SYNTH_TERMINATION_CANCELED;
+
+	// Before the other rules: a pass cut short by the deadline might have few betters
+	if (parameters->maxMilliseconds && millisecondsSince(startTime) >= parameters->maxMilliseconds)
+		return IMAGE_SYNTH_TERMINATION_TIME;
+
+	if (parameters->energyTerminateFraction > 0)
+	{
+		if (pass < 2)
+			return IMAGE_SYNTH_TERMINATION_ALL_PASSES;
+
+		gdouble energy = targetEnergyPerNeighbor(tally);
+		gdouble priorEnergy = targetEnergyPerNeighbor(priorTally);
+		if (energy <= priorEnergy)
+		{
+			// Zero energy (all perfect matches) can't decrease
+			if (priorEnergy <= 0 || (priorEnergy - energy) / priorEnergy < parameters->energyTerminateFraction)
+				return IMAGE_SYNTH_TERMINATION_ENERGY;
+			return IMAGE_SYNTH_TERMINATION_ALL_PASSES;
+		}
+		// Else energy increased: fall through to the default rule
+	}
+	if (static_cast<float>(tally->betters) / countTargetPoints < (IMAGE_SYNTH_TERMINATE_FRACTION))
+	{
+		return IMAGE_SYNTH_TERMINATION_FEW_BETTERS;
+	}
+
+	return IMAGE_SYNTH_TERMINATION_ALL_PASSES;
+}
+
+
+/* Record a pass into the caller's stats, if any. */
+static void recordPassStats(TImageSynthStats* stats, guint pass, const TPassTally* tally, gdouble milliseconds)
+{
+	TImageSynthPassStats* passStats;
+	guint i;
+
+	if (!stats) return;
+
+	passStats = &stats->passes[pass];
+	passStats->targetCount = tally->targetCount;
+	passStats->betters = tally->betters;
+	passStats->bettersByNeighborsSource = tally->bettersByNeighborsSource;
+	passStats->bettersByRandom = tally->bettersByRandom;
+	passStats->perfectMatches = tally->perfectMatches;
+	passStats->energy = tally->energy;
+	passStats->targetEnergy = tally->targetEnergy;
+	passStats->targetNeighbors = tally->targetNeighbors;
+	passStats->probes = tally->probes;
+	passStats->earlyOutCount = 0;
+	for (i = 0; i < IMAGE_SYNTH_MAX_NEIGHBORS; i++)
+	{
+		passStats->earlyOuts[i] = tally->earlyOuts[i];
+		passStats->earlyOutCount += tally->earlyOuts[i];
+	}
+	passStats->milliseconds = milliseconds;
+	stats->passCount = pass + 1;
+}
+
+
 static guint estimatePixelsToSynth(TRepetionParameters repetition_params)
 {
 	guint pass;
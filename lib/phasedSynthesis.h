@@ -0,0 +1,219 @@
+/*
+Deterministic synthesis (parameter isDeterministic):
+the result depends only on the input, the parameters and the seed,
+not on the count of threads nor their timing.
+
+Threaded synthesis by synthesize() is not deterministic:
+a thread reads target pixels that other threads are writing, so what it reads depends on timing,
+and all threads draw from one shared PRNG.
+
+Here, a pass is divided into phases: consecutive runs of targetPoints.
+Within a phase, each target point is synthesized from the state of the target at the start of the phase,
+by any thread: its result is buffered, and written to the target only after all threads finish the phase.
+So target points of the same phase never read each other.
+Random probes of a target point come from its own counter based stream (counterRandom.h),
+and heuristic 2 remembers probes privately, not in recentProberMap shared among threads.
+
+Phases are as long as the count of target points before them, from IMAGE_SYNTH_PHASE_MIN_TARGETS
+up to IMAGE_SYNTH_PHASE_MAX_TARGETS: they double at the start of a pass,
+when the first target points of the first pass see little but context.
+Phase bounds do not depend on the count of threads.
+
+The deadline of anytime synthesis (parameter maxMilliseconds) and the cancel flag are checked between phases.
+A run that spends its time budget depends on timing, as it must.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_PHASED_SYNTHESIS_H_
+#define RESYNTH_PHASED_SYNTHESIS_H_
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+
+/* Buffered result of synthesizing a target point, written to the target at the end of its phase. */
+typedef struct phasedResultStruct {
+	Coordinates source;
+	gboolean isBettered;
+} TPhasedResult;
+
+
+/* Barrier: threads wait until all have arrived.  The last to arrive first runs a completion. */
+typedef struct phaseBarrierStruct {
+	std::mutex mutex;
+	std::condition_variable condition;
+	guint threadCount;
+	guint waiting;
+	guint generation;
+} TPhaseBarrier;
+
+
+template<typename CompletionFunc>
+static void waitPhaseBarrier(TPhaseBarrier* barrier, CompletionFunc completion)
+{
+	std::unique_lock<std::mutex> lock(barrier->mutex);
+	guint generation = barrier->generation;
+
+	if (++barrier->waiting == barrier->threadCount)
+	{
+		completion();
+		barrier->waiting = 0;
+		barrier->generation++;
+		barrier->condition.notify_all();
+	}
+	else
+		barrier->condition.wait(lock, [&] { return barrier->generation != generation; });
+}
+
+
+/* State of a pass, shared by the threads. */
+typedef struct phasedPassStruct {
+	TPhaseBarrier barrier;
+	guint pass;
+	guint seed;
+	guint maxProbeCount;    // Of the schedule
+	gboolean isQuickFill;   // Past the deadline of a fill pass, see quickFillTargetPoint()
+	gboolean isQuitting;    // Deadline of a refinement pass, or canceled
+	std::vector<TPhasedResult> results;  // Of the current phase, by target index minus phase start
+} TPhasedPass;
+
+
+static void preparePhasedPass(
+	TPhasedPass* phased,  // OUT
+	guint threadCount,
+	guint pass,
+	const TImageSynthParameters* parameters,
+	const TPassSchedule* schedule)
+{
+	phased->barrier.threadCount = threadCount;
+	phased->barrier.waiting = 0;
+	phased->barrier.generation = 0;
+	phased->pass = pass;
+	phased->seed = parameters->seed;
+	phased->maxProbeCount = schedule->maxProbeCount;
+	phased->isQuickFill = FALSE;
+	phased->isQuitting = FALSE;
+	phased->results.resize(IMAGE_SYNTH_PHASE_MAX_TARGETS);
+}
+
+
+static inline guint endOfPhase(guint phaseStart, guint endTargetIndex)
+{
+	guint length = MIN(MAX(phaseStart, (guint)IMAGE_SYNTH_PHASE_MIN_TARGETS), (guint)IMAGE_SYNTH_PHASE_MAX_TARGETS);
+	return MIN(phaseStart + length, endTargetIndex);
+}
+
+
+/*
+ * \brief Deterministic counterpart of synthesize(), for one of threadCount threads.
+ * Every thread of the pass must call it, since threads wait for each other at the end of each phase.
+ * Tallies this thread's target points.
+ */
+static void synthesizePhased(
+	TImageSynthParameters *parameters,		// IN
+	const TPassSchedule* schedule,			// IN
+	guint threadIndex,						// IN
+	guint threadCount,						// IN
+	guint endTargetIndex,					// IN
+	TFormatIndices* indices,				// IN
+	Map * targetMap,						// IN/OUT
+	Map* corpusMap,							// IN
+	Map* hasValueMap,						// IN/OUT
+	Map* sourceOfMap,						// IN/OUT
+	PointVector targetPoints,				// IN
+	PointVector corpusPoints,				// IN
+	PointVector sortedOffsets,				// IN
+	TPixelelMetricFunc corpusTargetMetric,  // Array pointers
+	TMapPixelelMetricFunc mapsMetric,
+	TBestFitFunc bestFit,
+	const TCorpusTiles* corpusTiles,
+	TTargetEnergy* targetEnergies,			// IN/OUT latest best patch difference by target index
+	int *cancelFlag,
+	TPhasedPass* phased,					// IN/OUT shared by the threads
+	TPassTally* tally)						// OUT
+{
+	guint phaseStart;
+	guint phaseEnd;
+	guint target_index;
+	guint countVisited = 0;  // target points visited by this thread, for checks of the deadline
+	gboolean isQuickFill = FALSE;
+	TProbeRandom random;
+	TNeighbor neighbors[IMAGE_SYNTH_MAX_NEIGHBORS];
+
+	resetPassTally(tally);
+
+	for (phaseStart = 0; phaseStart < endTargetIndex && !phased->isQuitting; phaseStart = phaseEnd)
+	{
+		phaseEnd = endOfPhase(phaseStart, endTargetIndex);
+
+		// Synthesize, reading the target as of the start of the phase
+		for (target_index = phaseStart + threadIndex; target_index < phaseEnd; target_index += threadCount)
+		{
+			TPhasedResult* result = &phased->results[target_index - phaseStart];
+
+			// A fill pass also checks the deadline within a phase, since a phase can be long
+			isQuickFill = isQuickFill || phased->isQuickFill
+				|| (schedule->isFillPass && (countVisited & IMAGE_SYNTH_DEADLINE_CHECK_COUNT) == 0 && isPastDeadline(schedule));
+			countVisited++;
+
+			startCounterProbeRandom(&random, phased->seed, phased->pass, target_index);
+			if (isQuickFill)
+				result->isBettered = quickFillTargetPoint(parameters, targetPoints->data[target_index],
+					targetMap, corpusMap, hasValueMap, sourceOfMap,
+					corpusPoints, sortedOffsets, &random, &result->source, tally);
+			else
+				result->isBettered = synthesizeTargetPoint(parameters, target_index,
+					targetPoints->data[target_index], phased->maxProbeCount, indices,
+					targetMap, corpusMap, NULL, hasValueMap, sourceOfMap,
+					corpusPoints, sortedOffsets, &random,
+					corpusTargetMetric, mapsMetric, bestFit, corpusTiles, targetEnergies,
+					neighbors, &result->source, tally);
+		}
+		waitPhaseBarrier(&phased->barrier, [] {});
+
+		// Write results.  Target points are distinct, and no thread is reading.
+		for (target_index = phaseStart + threadIndex; target_index < phaseEnd; target_index += threadCount)
+		{
+			const TPhasedResult* result = &phased->results[target_index - phaseStart];
+			Coordinates position = targetPoints->data[target_index];
+
+			if (result->isBettered)
+			{
+				setColor(indices, targetMap, position, corpusMap, result->source);
+				setSourceOf(position, result->source, sourceOfMap);
+			}
+			setHasValue(&position, TRUE, hasValueMap);
+		}
+		waitPhaseBarrier(&phased->barrier, [&] {
+			if (*cancelFlag)
+				phased->isQuitting = TRUE;
+			// Anytime synthesis: at the deadline, quit refining, or finish the fill without searching.
+			if (isPastDeadline(schedule))
+			{
+				if (schedule->isFillPass)
+					phased->isQuickFill = TRUE;
+				else
+					phased->isQuitting = TRUE;
+			}
+		});
+	}
+}
+
+
+#endif /* RESYNTH_PHASED_SYNTHESIS_H_ */
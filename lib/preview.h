@@ -0,0 +1,110 @@
+/*
+Progressive preview: show the caller the target as synthesis proceeds.
+
+The first pass fills the whole target, coarsely; later passes refine it.
+An interactive caller can show the fill soon after it is complete, instead of only the final result.
+See TImageSynthExtras.previewCallback.
+
+Previews are between passes, by the engine's calling thread, when synthesis threads are joined.
+So the view is of a consistent target that no thread is writing, and is not copied:
+it is the engine's own pixmap, valid only during the callback.
+Not during a pass: then threads are writing the target.
+
+Each preview has the bounds of the pixels changed since the prior preview (or since the start),
+so the caller can redraw only those.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_PREVIEW_H_
+#define RESYNTH_PREVIEW_H_
+
+#include <chrono>
+
+
+typedef struct previewerStruct {
+	TImageSynthPreviewCallback callback;  // or NULL, for no previews
+	void* callbackContext;
+	guint intervalMilliseconds;
+	std::chrono::steady_clock::time_point origin;  // start of the engine
+	std::chrono::steady_clock::time_point priorTime;  // of the prior preview
+	gboolean isAnyPreview;
+	Bounds changedBounds;  // since the prior preview
+	TImageSynthPreview view;
+} TPreviewer;
+
+
+static void preparePreviewer(
+	TPreviewer* previewer,  // OUT
+	const TImageSynthExtras* extras,  // or NULL
+	TFormatIndices* indices,
+	Map* targetMap,
+	std::chrono::steady_clock::time_point origin)
+{
+	previewer->callback = (extras ? extras->previewCallback : NULL);
+	previewer->callbackContext = (extras ? extras->previewContext : NULL);
+	previewer->intervalMilliseconds = (extras ? extras->previewIntervalMilliseconds : 0);
+	previewer->origin = origin;
+	previewer->priorTime = origin;
+	previewer->isAnyPreview = FALSE;
+	previewer->changedBounds = emptyBounds();
+
+	previewer->view.pixels = targetMap->data;
+	previewer->view.width = targetMap->width;
+	previewer->view.height = targetMap->height;
+	previewer->view.bytesPerPixel = targetMap->depth;
+	previewer->view.colorStart = FIRST_PIXELEL_INDEX;
+	previewer->view.colorEnd = indices->colorEndBip;
+}
+
+
+/*
+After a pass, preview if the caller wants it:
+after the first pass, and then after any pass at least the interval after the prior preview.
+changedBounds: of the pixels the pass changed.
+*/
+static void previewAfterPass(
+	TPreviewer* previewer,
+	guint pass,
+	Bounds changedBounds)
+{
+	std::chrono::steady_clock::time_point now;
+
+	if (!previewer->callback) return;
+
+	previewer->changedBounds = unionBounds(previewer->changedBounds, changedBounds);
+	now = std::chrono::steady_clock::now();
+	if (previewer->isAnyPreview
+		&& std::chrono::duration<gdouble, std::milli>(now - previewer->priorTime).count() < previewer->intervalMilliseconds)
+		return;
+
+	previewer->view.pass = pass;
+	previewer->view.milliseconds = std::chrono::duration<gdouble, std::milli>(now - previewer->origin).count();
+	previewer->view.isAnyChanged = !isEmptyBounds(previewer->changedBounds);
+	previewer->view.changedLeft = previewer->view.isAnyChanged ? previewer->changedBounds.ulx : 0;
+	previewer->view.changedTop = previewer->view.isAnyChanged ? previewer->changedBounds.uly : 0;
+	previewer->view.changedRight = previewer->view.isAnyChanged ? previewer->changedBounds.lrx : 0;
+	previewer->view.changedBottom = previewer->view.isAnyChanged ? previewer->changedBounds.lry : 0;
+	previewer->callback(&previewer->view, previewer->callbackContext);
+
+	previewer->isAnyPreview = TRUE;
+	previewer->priorTime = now;
+	previewer->changedBounds = emptyBounds();
+}
+
+
+#endif /* RESYNTH_PREVIEW_H_ */
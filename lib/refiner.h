@@ -38,9 +38,11 @@
 #include "glibProxy.h"
 #include "matchWeighting.h"
 #include "passes.h"
+#include "trace.h"
+#include "preview.h"
 #include "imageSynthConstants.h"
-#include "stats.h"
 #include "synthesize.h"
+#include "phasedSynthesis.h"
 
 /*
  * Non threaded version, but with same signature and calls to synthesize()
@@ -60,12 +62,21 @@ static void refiner(
 	GRand *prng,
 	TPixelelMetricFunc corpusTargetMetric,  // array pointers
 	TMapPixelelMetricFunc mapsMetric,
+	TBestFitFunc bestFit,
+	const TCorpusTiles* corpusTiles,
 	void(*progressCallback)(int, void*),
 	void *contextInfo,
-	int* cancelFlag
+	int* cancelFlag,
+	std::chrono::steady_clock::time_point startTime,
+	TImageSynthStats* stats,  // OUT, or NULL
+	TTracer* tracer,
+	TPreviewer* previewer
 	)
 {
 	TRepetionParameters repetition_params;
+	TPassTally priorTally;
+	TPhasedPass phased;
+	std::vector<TTargetEnergy> targetEnergies(targetPoints->len, { 0, 0 });  // See terminationAfterPass()
 
 	// For progress
 	guint estimatedPixelCountToCompletion;
@@ -96,47 +107,68 @@ static void refiner(
 
 	prepare_repetition_parameters(repetition_params, targetPoints->len);
 	estimatedPixelCountToCompletion = estimatePixelsToSynth(repetition_params);
+	resetPassTally(&priorTally);
 
 	guint pass;
 	for (pass = 0; pass < MAX_PASSES; pass++)
 	{
 		guint endTargetIndex = repetition_params[pass][1];
-		gulong betters = 0; // gulong so can be cast to void *
+		TPassTally tally;
+		TPassSchedule schedule;
+		std::chrono::steady_clock::time_point passStartTime = std::chrono::steady_clock::now();
 
-		betters = synthesize(
-			&parameters,
-			0,      // Unthreaded synthesis is threadIndex 0
-			0,      // Unthreaded synthesis startTargetIndex is 0
-			endTargetIndex,
-			indices,
-			targetMap,
-			corpusMap,
-			recentProberMap,
-			hasValueMap,
-			sourceOfMap,
-			targetPoints,
-			corpusPoints,
-			sortedOffsets,
-			prng,
-			corpusTargetMetric,
-			mapsMetric,
-			deepProgressCallback,
-			cancelFlag
-			);
+		preparePassSchedule(&schedule, &parameters, pass, startTime);
+		if (parameters.isDeterministic)
+		{
+			preparePhasedPass(&phased, 1, pass, &parameters, &schedule);
+			synthesizePhased(&parameters, &schedule, 0, 1, endTargetIndex, indices,
+				targetMap, corpusMap, hasValueMap, sourceOfMap,
+				targetPoints, corpusPoints, sortedOffsets,
+				corpusTargetMetric, mapsMetric, bestFit, corpusTiles, targetEnergies.data(), cancelFlag, &phased, &tally);
+		}
+		else
+		{
+			synthesize(
+				&parameters,
+				&schedule,
+				0,      // Unthreaded synthesis is threadIndex 0
+				0,      // Unthreaded synthesis startTargetIndex is 0
+				endTargetIndex,
+				indices,
+				targetMap,
+				corpusMap,
+				recentProberMap,
+				hasValueMap,
+				sourceOfMap,
+				targetPoints,
+				corpusPoints,
+				sortedOffsets,
+				prng,
+				corpusTargetMetric,
+				mapsMetric,
+				bestFit,
+				corpusTiles,
+				targetEnergies.data(),
+				deepProgressCallback,
+				cancelFlag,
+				&tally
+				);
+		}
 
-		// nil unless DEBUG
-		print_pass_stats(pass, repetition_params[pass][1], betters);
-		// printf("Pass %d betters %ld\n", pass, betters);
+		sumTargetEnergies(targetEnergies, &tally);
+		recordPassStats(stats, pass, &tally, millisecondsSince(passStartTime));
+		traceSpanBetween(tracer, "pass", pass, 0, passStartTime, std::chrono::steady_clock::now());
+		previewAfterPass(previewer, pass, tally.changedBounds);
+		// printf("Pass %d betters %u energy %llu\n", pass, tally.betters, tally.energy);
 
-		/* Break if a small fraction of target is bettered
-		This is a fraction of total target points,
-		not the possibly smaller count of target attempts this pass.
-		Or break on small integral change: if ( targetPoints_size / integralColorChange < 10 ) {
-		*/
-		if (static_cast<float>(betters) / targetPoints->len < (IMAGE_SYNTH_TERMINATE_FRACTION))
+		TImageSynthTermination termination = terminationAfterPass(&parameters, pass, &tally, &priorTally,
+			targetPoints->len, startTime, cancelFlag);
+		if (termination != IMAGE_SYNTH_TERMINATION_ALL_PASSES)
 		{
+			if (stats) stats->termination = termination;
 			break;
 		}
+		priorTally = tally;
 
 		// Simple progress: percent of passes complete.
 		// This is not ideal, a maximum of MAX_PASSES callbacks, typically six.
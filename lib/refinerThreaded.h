@@ -61,6 +61,7 @@
 // Wrapper struct for single arg to synthesize
 typedef struct synthArgsStruct {
     TImageSynthParameters *parameters;		// IN
+    const TPassSchedule* schedule;			// IN
     guint threadIndex;
     guint startTargetIndex;
     guint endTargetIndex;					// IN // array pointers
@@ -76,8 +77,15 @@ typedef struct synthArgsStruct {
     GRand *prng;
     gushort * corpusTargetMetric;			// array pointers TPixelelMetricFunc
     guint * mapsMetric;						// TMapPixelelMetricFunc
+    TBestFitFunc bestFit;
+    const TCorpusTiles* corpusTiles;
+    TTargetEnergy* targetEnergies;          // IN/OUT latest best patch difference by target index
     std::function<void()> deepProgressCallback;         // void func(void)
     int* cancelFlag;  // flag set when canceled
+    TPhasedPass* phased;                    // IN/OUT shared by threads, if parameters->isDeterministic
+    TPassTally tally;                       // OUT tally of this thread's slice
+    std::chrono::steady_clock::time_point sliceStartTime;  // OUT, for the trace
+    std::chrono::steady_clock::time_point sliceEndTime;
 } SynthArgs;
 
 
@@ -86,6 +94,7 @@ static void
 newSynthesisArgs(
     SynthArgs* args,
     TImageSynthParameters *parameters,  // IN
+    const TPassSchedule* schedule,      // IN
     guint threadIndex,
     guint startTargetIndex,
     guint endTargetIndex,  // IN
@@ -101,10 +110,15 @@ newSynthesisArgs(
     GRand *prng,
     TPixelelMetricFunc corpusTargetMetric,  // array pointers
     TMapPixelelMetricFunc mapsMetric,
+    TBestFitFunc bestFit,
+    const TCorpusTiles* corpusTiles,
+    TTargetEnergy* targetEnergies,
     void(*deepProgressCallback)(),
-    int* cancelFlag)
+    int* cancelFlag,
+    TPhasedPass* phased)
 {
     args->parameters = parameters;
+    args->schedule = schedule;
     args->threadIndex = threadIndex;
     args->startTargetIndex = startTargetIndex;
     args->endTargetIndex = endTargetIndex;
@@ -120,8 +134,12 @@ newSynthesisArgs(
     args->prng = prng;
     args->corpusTargetMetric = corpusTargetMetric;
     args->mapsMetric = mapsMetric;
+    args->bestFit = bestFit;
+    args->corpusTiles = corpusTiles;
+    args->targetEnergies = targetEnergies;
     args->deepProgressCallback = deepProgressCallback;
     args->cancelFlag = cancelFlag;
+    args->phased = phased;
 }
 
 
@@ -131,6 +149,7 @@ static void * synthesisThread(void * uncastArgs)
 
     // Unpack wrapped args
     TImageSynthParameters * parameters = args->parameters;
+    const TPassSchedule* schedule = args->schedule;
     guint threadIndex = args->threadIndex;
     guint startTargetIndex = args->startTargetIndex;
     guint endTargetIndex = args->endTargetIndex;
@@ -146,11 +165,25 @@ static void * synthesisThread(void * uncastArgs)
     GRand *prng = args->prng;
     gushort * corpusTargetMetric = args->corpusTargetMetric; // array pointers TPixelelMetricFunc
     guint * mapsMetric = args->mapsMetric;
+    TBestFitFunc bestFit = args->bestFit;
+    const TCorpusTiles* corpusTiles = args->corpusTiles;
+    TTargetEnergy* targetEnergies = args->targetEnergies;
     std::function<void()> deepProgressCallback = args->deepProgressCallback;
     int* cancelFlag = args->cancelFlag;
 
-    gulong betters = synthesize(  // gulong so can be cast to void *
+    args->sliceStartTime = std::chrono::steady_clock::now();
+    if (parameters->isDeterministic)
+    {
+        synthesizePhased(parameters, schedule, threadIndex, THREAD_LIMIT, endTargetIndex, indices,
+            targetMap, corpusMap, hasValueMap, sourceOfMap,
+            targetPoints, corpusPoints, sortedOffsets,
+            corpusTargetMetric, mapsMetric, bestFit, corpusTiles, targetEnergies, cancelFlag, args->phased, &args->tally);
+        args->sliceEndTime = std::chrono::steady_clock::now();
+        return NULL;
+    }
+    synthesize(
         parameters,
+        schedule,
         threadIndex,
         startTargetIndex,
         endTargetIndex,
@@ -166,10 +199,15 @@ static void * synthesisThread(void * uncastArgs)
         prng,
         corpusTargetMetric,
         mapsMetric,
+        bestFit,
+        corpusTiles,
+        targetEnergies,
         deepProgressCallback,
-        cancelFlag
+        cancelFlag,
+        &args->tally
         );
-    return (void*)betters;
+    args->sliceEndTime = std::chrono::steady_clock::now();
+    return NULL;    // Result is in args->tally, read after the thread joins
 }
 
 
@@ -180,6 +218,7 @@ static void startThread(
     guint start,
     guint end,
     TImageSynthParameters* parameters,
+    const TPassSchedule* schedule,
     TFormatIndices* indices,
     Map* targetMap,
     Map* corpusMap,
@@ -192,12 +231,17 @@ static void startThread(
     GRand *prng,
     TPixelelMetricFunc corpusTargetMetric,  // array pointers
     TMapPixelelMetricFunc mapsMetric,
+    TBestFitFunc bestFit,
+    const TCorpusTiles* corpusTiles,
+    TTargetEnergy* targetEnergies,
     void(*deepProgressCallback)(),
-    int* cancelFlag)
+    int* cancelFlag,
+    TPhasedPass* phased)
 {
     newSynthesisArgs(
         args,
         parameters,
+        schedule,
         threadIndex, // thread specific
         start,      // thread specific
         end,        // thread specific
@@ -213,8 +257,12 @@ static void startThread(
         prng,
         corpusTargetMetric,
         mapsMetric,
+        bestFit,
+        corpusTiles,
+        targetEnergies,
         deepProgressCallback,
-        cancelFlag);
+        cancelFlag,
+        phased);
 
     // pthread_create(thread, NULL, synthesisThread, (void * __restrict__) args);
     theThread = std::shared_ptr<std::thread>(new std::thread(synthesisThread, args));
@@ -237,23 +285,39 @@ static void refiner(
     GRand *prng,
     TPixelelMetricFunc corpusTargetMetric,  // array pointers
     TMapPixelelMetricFunc mapsMetric,
+    TBestFitFunc bestFit,
+    const TCorpusTiles* corpusTiles,
     void(*progressCallback)(int, void*),
     void *contextInfo,
-    int* cancelFlag)
+    int* cancelFlag,
+    std::chrono::steady_clock::time_point startTime,
+    TImageSynthStats* stats,  // OUT, or NULL
+    TTracer* tracer,
+    TPreviewer* previewer)
 {
     TRepetionParameters repetition_params;
+    TPassTally priorTally;
     std::vector< std::shared_ptr< std::thread > > procThreads(THREAD_LIMIT);
     SynthArgs synthArgs[THREAD_LIMIT];
+    TPhasedPass phased;
+    std::vector<TTargetEnergy> targetEnergies(targetPoints->len, { 0, 0 });  // See terminationAfterPass()
 
     // For progress
     guint estimatedPixelCountToCompletion = 0;
     prepare_repetition_parameters(repetition_params, targetPoints->len);
     estimatedPixelCountToCompletion = estimatePixelsToSynth(repetition_params);
+    resetPassTally(&priorTally);
 
     for (guint pass = 0; pass < MAX_PASSES; pass++)
     {
         guint endTargetIndex = repetition_params[pass][1];
-        gulong betters = 0;
+        TPassTally tally;
+        TPassSchedule schedule;
+        std::chrono::steady_clock::time_point passStartTime = std::chrono::steady_clock::now();
+
+        preparePassSchedule(&schedule, &parameters, pass, startTime);
+        if (parameters.isDeterministic)
+            preparePhasedPass(&phased, THREAD_LIMIT, pass, &parameters, &schedule);
 
         guint threadIndex = 0;
         for (threadIndex = 0; threadIndex < THREAD_LIMIT; threadIndex++)
@@ -264,6 +328,7 @@ static void refiner(
                 threadIndex, 
                 0, endTargetIndex,      
                 &parameters,
+                &schedule,
                 indices,
                 targetMap,
                 corpusMap,
@@ -274,37 +339,39 @@ static void refiner(
                 corpusPoints,
                 sortedOffsets,
                 prng,
-                corpusTargetMetric, mapsMetric,
+                corpusTargetMetric, mapsMetric, bestFit, corpusTiles, targetEnergies.data(),
                 NULL,
-                cancelFlag);
+                cancelFlag,
+                &phased);
         }
 
-        // Wait for threads to complete; rejoin them
+        // Wait for threads to complete; rejoin them, and sum their tallies
+        resetPassTally(&tally);
         for (threadIndex = 0; threadIndex < THREAD_LIMIT; threadIndex++)
         {
-            gulong temp = 1;
-            
             //pthread_join(procThreads[threadIndex], (void**)&temp);
             procThreads[threadIndex]->join();
-            
-            betters += temp;
+            addPassTally(&tally, &synthArgs[threadIndex].tally);
         }
 
-
-        // nil unless DEBUG
-        print_pass_stats(pass, repetition_params[pass][1], betters);
-        // printf("Pass %d betters %ld\n", pass, betters);
-
-        /* Break if a small fraction of target is bettered
-        This is a fraction of total target points,
-        not the possibly smaller count of target attempts this pass.
-        Or break on small integral change: if ( targetPoints_size / integralColorChange < 10 ) {
-        */
-        if ((float)betters / targetPoints->len < (IMAGE_SYNTH_TERMINATE_FRACTION))
+        sumTargetEnergies(targetEnergies, &tally);
+        recordPassStats(stats, pass, &tally, millisecondsSince(passStartTime));
+        traceSpanBetween(tracer, "pass", pass, 0, passStartTime, std::chrono::steady_clock::now());
+        for (threadIndex = 0; threadIndex < THREAD_LIMIT; threadIndex++)
+            traceSpanBetween(tracer, "threadSlice", pass, threadIndex,
+                synthArgs[threadIndex].sliceStartTime, synthArgs[threadIndex].sliceEndTime);
+        previewAfterPass(previewer, pass, tally.changedBounds);
+        // printf("Pass %d betters %u energy %llu\n", pass, tally.betters, tally.energy);
+
+        TImageSynthTermination termination = terminationAfterPass(&parameters, pass, &tally, &priorTally,
+            targetPoints->len, startTime, cancelFlag);
+        if (termination != IMAGE_SYNTH_TERMINATION_ALL_PASSES)
         {
-            // printf("Quitting early after %d passes. Betters %ld\n", pass+1, betters);
+            // printf("Quitting early after %d passes. Betters %u\n", pass+1, tally.betters);
+            if (stats) stats->termination = termination;
             break;
         }
+        priorTally = tally;
 
         // Simple progress: percent of passes complete.
         // This is not ideal, a maximum of MAX_PASSES callbacks, typically six.
@@ -10,7 +10,8 @@ MMX code for SIMD vectorized innermost loop of resynthesizer
   Compute difference of target and corpus pixels in parallel 
   Eight bytes at once.
   
-  There must be padding after the last pixel if it is not eight bytes.
+  Pixmaps reserve IMAGE_SYNTH_PIXMAP_TAIL_PAD bytes after the last pixel, so this is in bounds,
+  and pixels are padded to a power of two, so an eight byte pixel is an aligned load.
   
   Unsigned 8-bit difference is (saturated subtract) xor (saturated subtract)
   */
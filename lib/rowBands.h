@@ -0,0 +1,89 @@
+/*
+Preparations over bands of rows, in parallel.
+
+The preparations of a run (adapting the image, interleaving the mask, scanning the masks
+for target and corpus points, filling the maps of sources and probers) each visit every pixel,
+and each row independently of the others.
+For a large image with a small target, they took longer than synthesis itself.
+
+They split the rows into bands, one per thread up to THREAD_LIMIT, the calling thread doing the first band.
+A band is at least ROW_BAND_MIN_PIXELS, so a small image is one band, in the calling thread,
+without the cost of starting threads.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_ROW_BANDS_H_
+#define RESYNTH_ROW_BANDS_H_
+
+#include <thread>
+#include <vector>
+
+#define ROW_BAND_MIN_PIXELS (1 << 16)
+
+
+/* Count of bands for an image: one per ROW_BAND_MIN_PIXELS, at most THREAD_LIMIT and the rows. */
+static inline guint rowBandCount(
+	guint width,
+	guint height)
+{
+	guint count = 1;
+#ifdef SYNTH_THREADED
+	guint64 bands = (static_cast<guint64>(width) * height) / ROW_BAND_MIN_PIXELS;
+
+	if (bands > THREAD_LIMIT) bands = THREAD_LIMIT;
+	if (bands > height) bands = height;
+	if (bands > 1) count = static_cast<guint>(bands);
+#endif
+	return count;
+}
+
+
+/* First row of a band.  The band's rows are [rowBandStart(band), rowBandStart(band + 1)). */
+static inline guint rowBandStart(
+	guint band,
+	guint bandCount,
+	guint height)
+{
+	return static_cast<guint>(static_cast<guint64>(height) * band / bandCount);
+}
+
+
+/*
+Call bandFunc(band, startRow, endRow) for each band, in parallel, and return when all are done.
+bandFunc must only write what its own rows own.
+*/
+template<typename BandFunc>
+static void forEachRowBand(
+	guint bandCount,
+	guint height,
+	BandFunc bandFunc)
+{
+	std::vector<std::thread> threads;
+	guint band;
+
+	for (band = 1; band < bandCount; band++)
+		threads.push_back(std::thread(bandFunc, band,
+			rowBandStart(band, bandCount, height), rowBandStart(band + 1, bandCount, height)));
+	// The calling thread does the first band
+	bandFunc(0, 0, rowBandStart(1, bandCount, height));
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+
+#endif /* RESYNTH_ROW_BANDS_H_ */
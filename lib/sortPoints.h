@@ -0,0 +1,213 @@
+/*
+Sort vectors of points (target points, offsets) by integer keys.
+
+Formerly: qsort (g_array_sort) with a comparator function per ordering (lessCartesian, moreHorizontal, ...)
+The comparators never returned 0, which is not a valid ordering for qsort,
+and they recomputed the key (e.g. x^2 + y^2) on every comparison, through a function pointer.
+
+Here the caller computes the key of each point once.
+The sort is a stable LSD radix sort on the key:
+linear time, and points of equal key stay in their original order (e.g. row major),
+so orderings are deterministic.
+Large vectors are sorted in slices by threads; the result does not depend on the count of threads.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_SORT_POINTS_H_
+#define RESYNTH_SORT_POINTS_H_
+
+#include <vector>
+#include <thread>
+
+// Digit of radix sort: two passes for 32-bit keys, one pass for small keys.
+#define SORT_RADIX_BITS 16
+#define SORT_RADIX_SIZE (1 << SORT_RADIX_BITS)
+// Fewer points than this are sorted by one thread.
+#define SORT_PARALLEL_MIN_POINTS (1 << 18)
+
+// Key per point, same length and order as the points.
+typedef std::vector<guint> TSortKeys;
+
+
+/*
+ * A slice of a radix pass: a contiguous range of the source,
+ * and for each digit, the count of the slice's keys having that digit,
+ * then (after prefix sum) the index in destination of the slice's first key having that digit.
+ */
+typedef struct {
+	const Coordinates* points;
+	const guint* keys;
+	Coordinates* sortedPoints;
+	guint* sortedKeys;
+	guint start;
+	guint end;
+	guint shift;
+	guint* digitIndex;  // [SORT_RADIX_SIZE]
+} TRadixSlice;
+
+
+static inline guint radixDigit(guint key, guint shift)
+{
+	return (key >> shift) & (SORT_RADIX_SIZE - 1);
+}
+
+
+static void countRadixSlice(TRadixSlice* slice)
+{
+	guint i;
+	for (i = slice->start; i < slice->end; i++)
+		slice->digitIndex[radixDigit(slice->keys[i], slice->shift)]++;
+}
+
+
+static void scatterRadixSlice(TRadixSlice* slice)
+{
+	guint i;
+	for (i = slice->start; i < slice->end; i++)
+	{
+		guint destination = slice->digitIndex[radixDigit(slice->keys[i], slice->shift)]++;
+		slice->sortedPoints[destination] = slice->points[i];
+		slice->sortedKeys[destination] = slice->keys[i];
+	}
+}
+
+
+static void runRadixSlices(void (*sliceFunc)(TRadixSlice*), std::vector<TRadixSlice>& slices)
+{
+	if (slices.size() == 1)
+	{
+		sliceFunc(&slices[0]);
+		return;
+	}
+	std::vector<std::thread> threads;
+	for (TRadixSlice& slice : slices)
+		threads.push_back(std::thread(sliceFunc, &slice));
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+
+/*
+ * One stable pass on the digit at shift, from (points, keys) to (sortedPoints, sortedKeys).
+ * Destinations are assigned in order of digit, then of slice, so the pass is stable
+ * regardless of the count of slices.
+ */
+static void radixPass(
+	const Coordinates* points,
+	const guint* keys,
+	Coordinates* sortedPoints,
+	guint* sortedKeys,
+	guint count,
+	guint shift,
+	guint sliceCount
+	)
+{
+	std::vector<guint> digitIndex(sliceCount * SORT_RADIX_SIZE, 0);
+	std::vector<TRadixSlice> slices(sliceCount);
+	guint sliceIndex;
+	guint digit;
+	guint total = 0;
+
+	for (sliceIndex = 0; sliceIndex < sliceCount; sliceIndex++)
+	{
+		TRadixSlice* slice = &slices[sliceIndex];
+		slice->points = points;
+		slice->keys = keys;
+		slice->sortedPoints = sortedPoints;
+		slice->sortedKeys = sortedKeys;
+		slice->start = static_cast<guint>(static_cast<guint64>(count) * sliceIndex / sliceCount);
+		slice->end = static_cast<guint>(static_cast<guint64>(count) * (sliceIndex + 1) / sliceCount);
+		slice->shift = shift;
+		slice->digitIndex = &digitIndex[sliceIndex * SORT_RADIX_SIZE];
+	}
+
+	runRadixSlices(countRadixSlice, slices);
+
+	// Exclusive prefix sum, digit major, slice minor
+	for (digit = 0; digit < SORT_RADIX_SIZE; digit++)
+		for (sliceIndex = 0; sliceIndex < sliceCount; sliceIndex++)
+		{
+			guint countOfDigit = slices[sliceIndex].digitIndex[digit];
+			slices[sliceIndex].digitIndex[digit] = total;
+			total += countOfDigit;
+		}
+
+	runRadixSlices(scatterRadixSlice, slices);
+}
+
+
+/*
+ * Sort points ascending by keys, stable.
+ * Permutes keys the same as points.
+ */
+static void sortPointsByKey(PointVector points, TSortKeys& keys)
+{
+	guint count = points->len;
+	guint maxKey = 0;
+	guint shift;
+	guint i;
+
+	g_assert(keys.size() == count);
+	if (count < 2) return;
+
+	for (i = 0; i < count; i++)
+		maxKey = MAX(maxKey, keys[i]);
+
+	guint sliceCount = 1;
+#ifdef SYNTH_THREADED
+	if (count >= SORT_PARALLEL_MIN_POINTS)
+		sliceCount = THREAD_LIMIT;
+#endif
+
+	Coordinates* pointsData = &points->data[0];
+	std::vector<Coordinates> otherPoints(count);
+	TSortKeys otherKeys(count);
+	Coordinates* from = pointsData;
+	Coordinates* to = otherPoints.data();
+	guint* fromKeys = keys.data();
+	guint* toKeys = otherKeys.data();
+
+	// Skip passes on high digits that are zero for all keys
+	for (shift = 0; shift < 32 && (shift == 0 || (maxKey >> shift) != 0); shift += SORT_RADIX_BITS)
+	{
+		radixPass(from, fromKeys, to, toKeys, count, shift, sliceCount);
+		std::swap(from, to);
+		std::swap(fromKeys, toKeys);
+	}
+
+	// Result in the other buffers after an odd count of passes
+	if (from != pointsData)
+	{
+		std::copy(from, from + count, pointsData);
+		std::copy(fromKeys, fromKeys + count, keys.data());
+	}
+}
+
+
+/* Invert keys, so that sortPointsByKey() sorts descending (still stable.) */
+static void invertSortKeys(TSortKeys& keys)
+{
+	guint maxKey = 0;
+	for (guint key : keys)
+		maxKey = MAX(maxKey, key);
+	for (guint& key : keys)
+		key = maxKey - key;
+}
+
+
+#endif /* RESYNTH_SORT_POINTS_H_ */
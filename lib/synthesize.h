@@ -27,6 +27,17 @@
 #	include <mmintrin.h> // intrinsics for assembly language MMX op codes, for sse2 xmmintrin.h
 #endif
 
+#if defined(__GNUC__)
+#	define PREFETCH_READ(address) __builtin_prefetch((address), 0, 1)
+#elif defined(_MSC_VER)
+#	include <xmmintrin.h>
+#	define PREFETCH_READ(address) _mm_prefetch((const char *)(address), _MM_HINT_T1)
+#else
+#	define PREFETCH_READ(address)
+#endif
+
+#define CACHE_LINE_BYTES 64
+
 
 /*
  * Threaded synthesis uses mutex on read and write to certain shared data among threads.
@@ -119,6 +130,9 @@ typedef struct neighborStruct {
 	/// Offset from patch center
 	Coordinates offset;
 
+	/// Offset in the corpus pixmap, in bytes: (offset.y * width + offset.x) * depth
+	gint corpusDelta;
+
 	/// Coords of corpus point this target synthed from, or -1 if this neighbor is context
 	Coordinates sourceOf;
 
@@ -149,25 +163,35 @@ static inline void set_neighbor_state(
 }
 
 
-/** Create a neighbor.  Initialize: offset, status, and pixel. */
+/*
+ * Create a neighbor.  Initialize: offset, status, and pixel.
+ * isLocked: read the color and source under gSynthMutex, atomic with the write of another thread (see synthesize().)
+ */
 static inline void new_neighbor(
 	const guint index,
 	Coordinates offset,
 	Coordinates neighbor_point,
 	TFormatIndices* indices,
 	Map* targetMap,
+	Map* corpusMap,
 	Map* sourceOfMap,
+	gboolean isLocked,
 	TNeighbor neighbors[])
 {
 	neighbors[index].offset = offset;
-	std::unique_lock<std::mutex> lock(gSynthMutex);
+	neighbors[index].corpusDelta = (offset.y * (gint)corpusMap->width + offset.x) * (gint)corpusMap->depth;
+	std::unique_lock<std::mutex> lock(gSynthMutex, std::defer_lock);
+	if (isLocked)
+		lock.lock();
 
 	set_neighbor_state(index, neighbor_point, sourceOfMap, neighbors);
 	{
+		const Pixelel * __restrict const image_pixel = pixmap_index(targetMap, neighbor_point);
+		Pixelel * __restrict const neighbor_pixel = neighbors[index].pixel;
 		TPixelelIndex k;
 		for (k = 0; k < indices->total_bpp; k++) 
 		{
-			neighbors[index].pixel[k] = pixmap_index(targetMap, neighbor_point)[k];
+			neighbor_pixel[k] = image_pixel[k];
 		}
 	}
 }
@@ -180,30 +204,42 @@ static inline void new_neighbor(
  * Neighbors array is global, used both for heuristic and in synthing every point ( in computeBestFit() )
  * Neighbors describes a patch, a shotgun pattern in the first pass, or a contiguous patch in later passes.
  * It is stored in an array, but is not necessarily a square, contiguous patch.
+ *
+ * The patch is fixed for all the candidates probed for the target point.
+ * So each neighbor also carries its offset into the corpus pixmap (corpusDelta),
+ * and patchBounds are the extreme offsets, for computeBestFit() to clip a candidate's patch by one test.
+ *
+ * Deterministic synthesis (see phasedSynthesis.h) writes the target only between phases, when no thread reads it,
+ * so reads without the lock.
  */
 static guint prepare_neighbors(
 	Coordinates position, // IN target point
 	TImageSynthParameters *parameters, // IN
 	TFormatIndices* indices,
 	Map* targetMap,
+	Map* corpusMap,
 	Map* hasValueMap,
 	Map* sourceOfMap,
 	PointVector sortedOffsets,
-	TNeighbor neighbors[])
+	TNeighbor neighbors[],
+	Bounds* patchBounds)  // OUT bounds of the offsets of neighbors
 {
 	guint count = 0;
 	Coordinates offset;
 	Coordinates neighbor_point;
+	const gboolean isLocked = !parameters->isDeterministic;
 
 	// Target point is always its own first neighbor, even though on startup and first pass it doesn't have a value.
-	offset = g_array_index(sortedOffsets, Coordinates, 0);
-	new_neighbor(count, offset, position, indices, targetMap, sourceOfMap, neighbors);
+	offset = sortedOffsets->data[0];
+	new_neighbor(count, offset, position, indices, targetMap, corpusMap, sourceOfMap, isLocked, neighbors);
 	count++;
+	*patchBounds = emptyBounds();
+	extendBounds(patchBounds, offset);
 	
 	guint j;
 	for (j = 1; j < sortedOffsets->len; j++) // !!! Start at 1
 	{
-		offset = g_array_index(sortedOffsets, Coordinates, j);
+		offset = sortedOffsets->data[j];
 		neighbor_point = add_points(position, offset);
 
 		// !!! Note side effects: clipToTargetOrWrapIfTiled might change neighbor_point coordinates !!!
@@ -212,7 +248,8 @@ static guint prepare_neighbors(
 			// AND ( is neighbor outside target (context) OR inside target with already synthed value )
 			)
 		{
-			new_neighbor(count, offset, neighbor_point, indices, targetMap, sourceOfMap, neighbors);
+			new_neighbor(count, offset, neighbor_point, indices, targetMap, corpusMap, sourceOfMap, isLocked, neighbors);
+			extendBounds(patchBounds, offset);
 			count++;
 			if (count >= (guint)parameters->patchSize) break;
 		}
@@ -236,130 +273,246 @@ static guint prepare_neighbors(
 
 
 /*
- * This is the inner crux: comparing target patch to corpus patch, pixel by pixel.
- * Also the bottleneck in performance.
- *
- * Computing a best fit metric, with early out when exceed known best.
- *
- * Because of a log transform of a product, this is a summing.
- *
- * The following discussion depends on how repetition (passes) are configured:
- * if the first pass is not a complete pass over the target, it doesn't apply.
- * On the first pass the candidate patch might be a shotgun pattern, to distant context.
- * On subsequent passes, the candidate patch is often a rectangular pixmap (since the target is filled in.)
- * But since pixels can be masked, the actual patch tested might be irregularly shaped.
- *
- * Note that size of patch (n_neighbors) is usually the same for each target pixel,
- * but in rare cases, it might not be.
- * (If there is no context, the first probe has 0 neighbors, the second probe 1 neighbor, ...)
- * Then does it make sense to also use MAX_WEIGHT for missing neighbors?
+ * Kernels of computeBestFit() are specialized at compile time for the pixel layout:
+ * count of color pixelels, whether there is an alpha pixelel (which displaces the map pixelels), count of map pixelels,
+ * the metric, and whether the corpus is matched from its pixmap or from tiles (see corpusTiles.h.)
+ * So loops over pixelels unroll, and branches on the layout and metric compile away.
+ * KERNEL_ANY: a layout not specialized, whose counts come from TFormatIndices at run time.
+ * engine() selects a kernel once, see selectBestFit().
  */
-static inline gboolean computeBestFit(
-	const Coordinates point,
+#define KERNEL_ANY 255
+
+
+/*
+ * Weighted difference of the color pixelels of a neighbor.
+ * image_colors, corpus_colors: the first color pixelel of each pixel.
+ */
+template<guint ColorCount, int Metric>
+static inline guint colorDifference(
+	const Pixelel * const image_colors,
+	const Pixelel * const corpus_colors,
 	const TFormatIndices * const indices,
-	const Map * const corpusMap,
-	guint * const bestPatchDiff,  // OUT
-	Coordinates * const bestMatchCorpusPoint, // OUT
-	const guint countNeighbors,
-	const TNeighbor neighbors[],
-	ImprovementType* latestBettermentKind,
-	const ImprovementType bettermentKind,
-	const TPixelelMetricFunc corpusTargetMetric,  // array pointers
-	const TMapPixelelMetricFunc mapsMetric)
+	const TPixelelMetricFunc corpusTargetMetric)
 {
+	const TPixelelIndex colorCount = (ColorCount == KERNEL_ANY) ? indices->img_match_bpp : ColorCount;
 	guint sum = 0;
-	guint i;
+	TPixelelIndex j;
 
-#ifdef STATS
-	countSourceTries++;
+	for (j = 0; j < colorCount; j++)
+	{
+		gint diff = (gint)image_colors[j] - (gint)corpus_colors[j];
+		if (Metric == IMAGE_SYNTH_METRIC_SAD)
+			sum += ((diff < 0) ? -diff : diff) * SAD_SCALE;
+		else if (Metric == IMAGE_SYNTH_METRIC_SSD)
+			sum += diff * diff;
+		else
+#ifdef SYMMETRIC_METRIC_TABLE
+			sum += corpusTargetMetric[((diff < 0) ? (-diff) : (diff))];
+#else
+			sum += corpusTargetMetric[256u + diff];
 #endif
+	}
+	return sum;
+}
+
+
+/*
+ * Weighted difference of the map pixelels of a neighbor.
+ * image_maps, corpus_maps: the first map pixelel of each pixel.
+ */
+template<guint MapCount>
+static inline guint mapDifference(
+	const Pixelel * const image_maps,
+	const Pixelel * const corpus_maps,
+	const TFormatIndices * const indices,
+	const TMapPixelelMetricFunc mapsMetric)
+{
+	const TPixelelIndex mapCount = (MapCount == KERNEL_ANY) ? indices->map_match_bpp : MapCount;
+	guint sum = 0;
+	TPixelelIndex j;
 
-	// Iterate over neighbors of candidate point. Sum grows as more neighbors tested.
-	for (i = 0; i < countNeighbors; i++)
+	for (j = 0; j < mapCount; j++)
 	{
-		Coordinates off_point = add_points(point, neighbors[i].offset);
-		if (clippedOrMaskedCorpus(off_point, corpusMap))
-		{
-			/*
-			Maximum weighted difference for this neighbor outside corpus.
-			!!! Note even if no maps are passed to engine, we weight by the map,
-			for this case of an invalid corpus point.
-			!!! Note the mapsMetric function is not scaled,
-			so we can't use a constant such as MAX_MAP_DIFF,'
-			but instead mapMetric[...], the extreme max value of the metric.
-			!!! Which will be zero if mapWeight parameter is zero.
-			*/
+		gint diff = (gint)image_maps[j] - (gint)corpus_maps[j];
+#ifdef SYMMETRIC_METRIC_TABLE
+		sum += mapsMetric[((diff < 0) ? (-diff) : (diff))];
+#else
+		sum += mapsMetric[256u + diff];
+#endif
+	}
+	return sum;
+}
+
+
+/*
+Maximum weighted difference for a neighbor outside corpus.
+!!! Note even if no maps are passed to engine, we weight by the map,
+for this case of an invalid corpus point.
+!!! Note the mapsMetric function is not scaled,
+so we can't use a constant such as MAX_MAP_DIFF,'
+but instead mapMetric[...], the extreme max value of the metric.
+!!! Which will be zero if mapWeight parameter is zero.
+*/
+template<guint ColorCount, guint MapCount>
+static inline guint clippedDifference(
+	const TFormatIndices * const indices,
+	const TMapPixelelMetricFunc mapsMetric)
+{
+	const guint colorCount = (ColorCount == KERNEL_ANY) ? indices->img_match_bpp : ColorCount;
+	const guint mapCount = (MapCount == KERNEL_ANY) ? indices->map_match_bpp : MapCount;
 #ifdef SYMMETRIC_METRIC_TABLE
-			// mapsMetric[256] is the max
-			sum += MAX_WEIGHT*indices->img_match_bpp + mapsMetric[LIMIT_DOMAIN] * indices->map_match_bpp;
+	// mapsMetric[256] is the max
+	return MAX_WEIGHT * colorCount + mapsMetric[LIMIT_DOMAIN] * mapCount;
 #else
-			sum += MAX_WEIGHT * indices->img_match_bpp + mapsMetric[0] * indices->map_match_bpp;
+	return MAX_WEIGHT * colorCount + mapsMetric[0] * mapCount;
 #endif
+}
+
+
+/*
+ * Weighted difference of one neighbor of a candidate: the target's neighbor pixel versus the corpus pixel at the same offset.
+ * IsSelf: the neighbor is the target point itself (neighbor 0), whose color is not compared.
+ * !!! On the first pass, the target point as its own 0th neighbor has no meaningful, unbiased value.
+ * Even if e.g. we initialize target to all black, that biases the search.
+ * IsInterior: the candidate's whole patch is within the corpus (see isPatchInCorpus()), so only masks are tested.
+ * Then, from the pixmap, the corpus pixel is candidatePixel plus the neighbor's corpusDelta.
+ * Else clip the coordinates of each neighbor.
+ * IsTiled: the corpus pixel is from corpusTiles, packed, with its mask separate.
+ */
+template<guint ColorCount, guint MapStart, guint MapCount, int Metric, gboolean IsTiled, gboolean IsSelf, gboolean IsInterior>
+static inline guint neighborDifference(
+	const Coordinates point,
+	const Pixelel * const candidatePixel,
+	const TNeighbor * const neighbor,
+	const TFormatIndices * const indices,
+	const Map * const corpusMap,
+	const TCorpusTiles * const corpusTiles,
+	const TPixelelMetricFunc corpusTargetMetric,
+	const TMapPixelelMetricFunc mapsMetric)
+{
+	const Pixelel * corpus_colors;
+	const Pixelel * corpus_maps;
+
+	if (IsTiled)
+	{
+		const guint colorCount = (ColorCount == KERNEL_ANY) ? indices->img_match_bpp : ColorCount;
+		const guint depth = (ColorCount == KERNEL_ANY || MapCount == KERNEL_ANY) ? corpusTiles->depth : ColorCount + MapCount;
+		Coordinates off_point = add_points(point, neighbor->offset);
+		guint index;
+
+		if (!IsInterior && isClippedCorpusTiles(corpusTiles, off_point))
+			return clippedDifference<ColorCount, MapCount>(indices, mapsMetric);
+		index = corpusTileIndex(corpusTiles, off_point);
+		if (corpusTiles->mask[index] != MASK_TOTALLY_SELECTED)  // Masked
+			return clippedDifference<ColorCount, MapCount>(indices, mapsMetric);
+		corpus_colors = &corpusTiles->pixels[index * depth];
+		corpus_maps = corpus_colors + colorCount;
+	}
+	else
+	{
+		const Pixelel * corpus_pixel;
+		if (IsInterior)
+		{
+			corpus_pixel = candidatePixel + neighbor->corpusDelta;
+			if (corpus_pixel[MASK_PIXELEL_INDEX] != MASK_TOTALLY_SELECTED)  // Masked
+				return clippedDifference<ColorCount, MapCount>(indices, mapsMetric);
 		}
 		else
 		{
-#ifndef VECTORIZED
-			// Iterate over color pixelels to compute weighted difference
-			const Pixelel * corpus_pixel;
-			const Pixelel * image_pixel;
-#	ifdef SYMMETRIC_METRIC_TABLE
-			gshort diff;
-#	endif
-
+			Coordinates off_point = add_points(point, neighbor->offset);
+			if (clippedOrMaskedCorpus(off_point, corpusMap))
+				return clippedDifference<ColorCount, MapCount>(indices, mapsMetric);
 			corpus_pixel = pixmap_index(corpusMap, off_point);
-			// ! Note target pixel comes not from targetPoints, but from copy neighbors
-			image_pixel = neighbors[i].pixel; // pixel is array, yields Pixelel pointer
-
-
-			/* If not the target point (its own 0th neighbor).
-			!!! On the first pass, the target point as its own 0th neighbor has no meaningful, unbiased value.
-			Even if e.g. we initialize target to all black, that biases the search.
-			*/
-			if (i)
-			{
-				TPixelelIndex j;
-				for (j = FIRST_PIXELEL_INDEX; j < indices->colorEndBip; j++)
-				{
-#	ifdef SYMMETRIC_METRIC_TABLE
-					diff = (gshort)image_pixel[j] - (gshort)corpus_pixel[j];
-					sum += corpusTargetMetric[((diff < 0) ? (-diff) : (diff))];
-					// OR sum += corpusTargetMetric[ abs(diff) ]; // abs() a macro? from stddef.h
-#	else
-					sum += corpusTargetMetric[256u + image_pixel[j] - corpus_pixel[j]];
-#	endif
-				}
-			}
+		}
+		corpus_colors = corpus_pixel + FIRST_PIXELEL_INDEX;
+		corpus_maps = corpus_pixel + ((MapCount == KERNEL_ANY) ? indices->map_start_bip : MapStart);
+	}
 
-			if (indices->map_match_bpp > 0) // If maps
-			{
-				TPixelelIndex j;
-				for (j = indices->map_start_bip; j < indices->map_end_bip; j++)  // also sum mapped difference
-				{
-#	ifdef SYMMETRIC_METRIC_TABLE
-					diff = (gshort)image_pixel[j] - (gshort)corpus_pixel[j];
-					sum += mapsMetric[((diff < 0) ? (-diff) : (diff))];
-					// sum += mapsMetric[ abs(diff) ];
-#	else
-					sum += mapsMetric[256u + image_pixel[j] - corpus_pixel[j]];
-#	endif
-				}
-			}
+	{
+		guint sum = 0;
+#ifndef VECTORIZED
+		// ! Note target pixel comes not from targetPoints, but from copy neighbors
+		const Pixelel * image_pixel = neighbor->pixel; // pixel is array, yields Pixelel pointer
+
+		if (!IsSelf)
+			sum += colorDifference<ColorCount, Metric>(image_pixel + FIRST_PIXELEL_INDEX, corpus_colors,
+				indices, corpusTargetMetric);
+		if (MapCount)
+			sum += mapDifference<MapCount>(image_pixel + ((MapCount == KERNEL_ANY) ? indices->map_start_bip : MapStart),
+				corpus_maps, indices, mapsMetric);
 #else
-			const Pixelel * __restrict__ corpus_pixel = pixmap_index(corpusMap, off_point);
-			const Pixelel  * __restrict__ image_pixel = neighbors[i].pixel;
+		// Only the Cauchy metric, the layout from indices, and the corpus pixmap
+		const Pixelel * __restrict__ corpus_pixel = corpus_colors - FIRST_PIXELEL_INDEX;
+		const Pixelel  * __restrict__ image_pixel = neighbor->pixel;
+		const guint i = IsSelf ? 0 : 1;
 #define MMX_INTRINSICS_RESYNTH
 #include "resynth-vectorized.h"
-
 #endif
-			/*
-			 * !!! Very subtle: on the very first pass and very first target point, with no context,
-			 * the patch is only one point, the being synthesized pixel.
-			 * Above, the loop will execute exactly once.
-			 * At "if (i)", it will not compute a weighted difference.
-			 * Hence the sum will be zero, i.e. a perfect match, and the very first probe will be the best match.
-			 * In other words, it will be completely at random, with no actual searching.
-			 */
+		return sum;
+	}
+}
+
+
+/* Whether the patch of a candidate, every offset in patchBounds, is within the corpus pixmap (though maybe masked.) */
+static inline gboolean isPatchInCorpus(
+	const Coordinates point,
+	const Bounds patchBounds,
+	const Map * const corpusMap)
+{
+	return point.x + patchBounds.ulx >= 0
+		&& point.y + patchBounds.uly >= 0
+		&& point.x + patchBounds.lrx < (gint)corpusMap->width
+		&& point.y + patchBounds.lry < (gint)corpusMap->height;
+}
+
+
+/*
+ * Sum the weighted differences of the neighbors of a candidate, until the sum reaches bestPatchDiff.
+ * Returns whether the sum stayed under bestPatchDiff (no early out.)
+ */
+template<guint ColorCount, guint MapStart, guint MapCount, int Metric, gboolean IsTiled, gboolean IsInterior>
+static inline gboolean sumPatchDifference(
+	const Coordinates point,
+	const TFormatIndices * const indices,
+	const Map * const corpusMap,
+	const TCorpusTiles * const corpusTiles,
+	const guint bestPatchDiff,
+	const guint countNeighbors,
+	const TNeighbor * __restrict const neighbors,  // Not aliased by the tally
+	const TPixelelMetricFunc corpusTargetMetric,
+	const TMapPixelelMetricFunc mapsMetric,
+	TPassTally * const tally,
+	guint * const patchDiff)  // OUT
+{
+	// Only dereferenced if IsInterior, when point is in the corpus pixmap
+	const Pixelel * __restrict const candidatePixel = (IsInterior && !IsTiled) ? pixmap_index(corpusMap, point) : NULL;
+	guint sum = 0;
+	guint i;
+
+	/*
+	 * Iterate over neighbors of candidate point. Sum grows as more neighbors tested.
+	 * The target point, its own first neighbor, is peeled from the loop.
+	 *
+	 * !!! Very subtle: on the very first pass and very first target point, with no context,
+	 * the patch is only one point, the being synthesized pixel.
+	 * It does not compute a weighted difference of color.
+	 * Hence the sum will be zero, i.e. a perfect match, and the very first probe will be the best match.
+	 * In other words, it will be completely at random, with no actual searching.
+	 */
+	if (countNeighbors)
+	{
+		sum += neighborDifference<ColorCount, MapStart, MapCount, Metric, IsTiled, TRUE, IsInterior>(point, candidatePixel,
+			&neighbors[0], indices, corpusMap, corpusTiles, corpusTargetMetric, mapsMetric);
+		if (sum >= bestPatchDiff)
+		{
+			tally->earlyOuts[0]++;
+			return FALSE;
 		}
+	}
+	for (i = 1; i < countNeighbors; i++)
+	{
+		sum += neighborDifference<ColorCount, MapStart, MapCount, Metric, IsTiled, FALSE, IsInterior>(point, candidatePixel,
+			&neighbors[i], indices, corpusMap, corpusTiles, corpusTargetMetric, mapsMetric);
 
 		/*
 		 * lkk !!! bestMatchCorpusPoint not set.
@@ -371,8 +524,64 @@ static inline gboolean computeBestFit(
 		 * ??? Study how many different but equal sources are found.
 		 * Are different source in later repeats closer distance?
 		 */
-		if (sum >= *bestPatchDiff) return FALSE;  // !!! Short circuit for neighbors
+		if (sum >= bestPatchDiff)  // !!! Short circuit for neighbors
+		{
+			tally->earlyOuts[i]++;
+			return FALSE;
+		}
 	}
+	*patchDiff = sum;
+	return TRUE;
+}
+
+
+/*
+ * This is the inner crux: comparing target patch to corpus patch, pixel by pixel.
+ * Also the bottleneck in performance.
+ *
+ * Computing a best fit metric, with early out when exceed known best.
+ *
+ * Because of a log transform of a product, this is a summing.
+ *
+ * The following discussion depends on how repetition (passes) are configured:
+ * if the first pass is not a complete pass over the target, it doesn't apply.
+ * On the first pass the candidate patch might be a shotgun pattern, to distant context.
+ * On subsequent passes, the candidate patch is often a rectangular pixmap (since the target is filled in.)
+ * But since pixels can be masked, the actual patch tested might be irregularly shaped.
+ *
+ * Note that size of patch (n_neighbors) is usually the same for each target pixel,
+ * but in rare cases, it might not be.
+ * (If there is no context, the first probe has 0 neighbors, the second probe 1 neighbor, ...)
+ * Then does it make sense to also use MAX_WEIGHT for missing neighbors?
+ */
+template<guint ColorCount, guint MapStart, guint MapCount, int Metric, gboolean IsTiled>
+static gboolean computeBestFit(
+	const Coordinates point,
+	const TFormatIndices * const indices,
+	const Map * const corpusMap,
+	const TCorpusTiles * const corpusTiles,  // or NULL, if not IsTiled
+	guint * const bestPatchDiff,  // OUT
+	Coordinates * const bestMatchCorpusPoint, // OUT
+	const guint countNeighbors,
+	const TNeighbor neighbors[],
+	const Bounds patchBounds,  // of the offsets of neighbors
+	ImprovementType* latestBettermentKind,
+	const ImprovementType bettermentKind,
+	const TPixelelMetricFunc corpusTargetMetric,  // array pointers
+	const TMapPixelelMetricFunc mapsMetric,
+	TPassTally * const tally)  // IN/OUT this thread's counts of probes and early outs
+{
+	guint sum = 0;
+
+	tally->probes++;
+
+	// One test whether to clip the neighbors of the candidate
+	if (isPatchInCorpus(point, patchBounds, corpusMap)
+		? !sumPatchDifference<ColorCount, MapStart, MapCount, Metric, IsTiled, TRUE>(point, indices, corpusMap, corpusTiles,
+			*bestPatchDiff, countNeighbors, neighbors, corpusTargetMetric, mapsMetric, tally, &sum)
+		: !sumPatchDifference<ColorCount, MapStart, MapCount, Metric, IsTiled, FALSE>(point, indices, corpusMap, corpusTiles,
+			*bestPatchDiff, countNeighbors, neighbors, corpusTargetMetric, mapsMetric, tally, &sum))
+		return FALSE;
 
 	// Assert sum strictly < bestPatchDiff
 	*bestPatchDiff = sum;
@@ -381,17 +590,86 @@ static inline gboolean computeBestFit(
 	// bestMatchCorpusPoint might already equal point, but might be smaller sum because different neighbors or different neighbor values
 	*bestMatchCorpusPoint = point;
 	if (sum <= 0)
-	{
-#ifdef STATS
-		bettermentStats[PERFECT_MATCH] += 1;
-#endif
 		return TRUE;  // PERFECT_MATCH
-	}
 	else
 		return FALSE; // GENERIC_BETTERMENT;
 }
 
 
+/* A kernel of computeBestFit(), for a pixel layout and metric. */
+typedef gboolean (*TBestFitFunc)(
+	const Coordinates point,
+	const TFormatIndices * const indices,
+	const Map * const corpusMap,
+	const TCorpusTiles * const corpusTiles,
+	guint * const bestPatchDiff,
+	Coordinates * const bestMatchCorpusPoint,
+	const guint countNeighbors,
+	const TNeighbor neighbors[],
+	const Bounds patchBounds,  // of the offsets of neighbors
+	ImprovementType* latestBettermentKind,
+	const ImprovementType bettermentKind,
+	const TPixelelMetricFunc corpusTargetMetric,
+	const TMapPixelelMetricFunc mapsMetric,
+	TPassTally * const tally);
+
+
+template<guint ColorCount, gboolean HasAlpha, int Metric, gboolean IsTiled>
+static TBestFitFunc selectBestFitForMaps(guint mapCount)
+{
+	const guint mapStart = FIRST_PIXELEL_INDEX + ColorCount + (HasAlpha ? 1 : 0);
+
+	switch (mapCount)
+	{
+	case 0: return computeBestFit<ColorCount, mapStart, 0, Metric, IsTiled>;
+	case 1: return computeBestFit<ColorCount, mapStart, 1, Metric, IsTiled>;
+	case 3: return computeBestFit<ColorCount, mapStart, 3, Metric, IsTiled>;
+	default: return computeBestFit<KERNEL_ANY, 0, KERNEL_ANY, Metric, IsTiled>;
+	}
+}
+
+
+template<int Metric, gboolean IsTiled>
+static TBestFitFunc selectBestFitForLayout(const TFormatIndices* indices)
+{
+	gboolean hasAlpha = (indices->map_start_bip != indices->colorEndBip);
+
+	if (indices->img_match_bpp == 1)
+		return hasAlpha ? selectBestFitForMaps<1, TRUE, Metric, IsTiled>(indices->map_match_bpp)
+			: selectBestFitForMaps<1, FALSE, Metric, IsTiled>(indices->map_match_bpp);
+	if (indices->img_match_bpp == 3)
+		return hasAlpha ? selectBestFitForMaps<3, TRUE, Metric, IsTiled>(indices->map_match_bpp)
+			: selectBestFitForMaps<3, FALSE, Metric, IsTiled>(indices->map_match_bpp);
+	return computeBestFit<KERNEL_ANY, 0, KERNEL_ANY, Metric, IsTiled>;
+}
+
+
+template<int Metric>
+static TBestFitFunc selectBestFitForCorpus(const TFormatIndices* indices, gboolean isTiled)
+{
+#ifdef VECTORIZED
+	// The vectorized kernel reads the corpus pixmap
+	return computeBestFit<KERNEL_ANY, 0, KERNEL_ANY, Metric, FALSE>;
+#endif
+	return isTiled ? selectBestFitForLayout<Metric, TRUE>(indices) : selectBestFitForLayout<Metric, FALSE>(indices);
+}
+
+
+/*
+ * Select the kernel of computeBestFit() for the pixel layout and metric, once per run of the engine.
+ * isTiled: whether the kernel will be passed corpusTiles.
+ */
+static TBestFitFunc selectBestFit(const TFormatIndices* indices, TImageSynthMatchMetric metric, gboolean isTiled)
+{
+	switch (metric)
+	{
+	case IMAGE_SYNTH_METRIC_SAD: return selectBestFitForCorpus<IMAGE_SYNTH_METRIC_SAD>(indices, isTiled);
+	case IMAGE_SYNTH_METRIC_SSD: return selectBestFitForCorpus<IMAGE_SYNTH_METRIC_SSD>(indices, isTiled);
+	default: return selectBestFitForCorpus<IMAGE_SYNTH_METRIC_CAUCHY>(indices, isTiled);
+	}
+}
+
+
 static inline void setColor(
 	TFormatIndices* indices,
 	Map* targetMap,
@@ -399,24 +677,381 @@ static inline void setColor(
 	Map* corpusMap,
 	Coordinates corpusPosition)
 {
+	Pixelel * __restrict const target_pixel = pixmap_index(targetMap, targetPosition);
+	const Pixelel * __restrict const corpus_pixel = pixmap_index(corpusMap, corpusPosition);
 	TPixelelIndex j;
 
 	// For all color pixelels (channels)
 	for (j = FIRST_PIXELEL_INDEX; j < indices->colorEndBip; j++)
 	{
 		// Overwrite prior with new color
-		pixmap_index(targetMap, targetPosition)[j] = pixmap_index(corpusMap, corpusPosition)[j];
+		target_pixel[j] = corpus_pixel[j];
+	}
+}
+
+
+/*
+ * Prefetch the corpus pixels of a candidate's patch that matching reads first:
+ * those of the nearest neighbors, at most IMAGE_SYNTH_PREFETCH_NEIGHBORS, that are in the corpus.
+ * From the tiles if matching reads them (parameter isCorpusTiled), which never reads the corpus pixmap.
+ * Hides the latency of a random corpus patch, which is rarely in cache, behind scoring earlier candidates.
+ * Not the patch's bounding box: on the first pass, a sparse patch can span hundreds of rows,
+ * and most probes quit after a few neighbors (early outs.)
+ */
+static inline void prefetchPatch(
+	const Coordinates point,
+	const Bounds patchBounds,
+	const Map * const corpusMap,
+	const TCorpusTiles * const corpusTiles,  // or NULL
+	const guint countNeighbors,
+	const TNeighbor neighbors[])
+{
+	const guint count = MIN(countNeighbors, IMAGE_SYNTH_PREFETCH_NEIGHBORS);
+	guint i;
+
+	if (corpusTiles)
+	{
+		for (i = 0; i < count; i++)
+		{
+			Coordinates neighborPoint = add_points(point, neighbors[i].offset);
+			if (!isClippedCorpusTiles(corpusTiles, neighborPoint))
+			{
+				guint index = corpusTileIndex(corpusTiles, neighborPoint);
+				PREFETCH_READ(&corpusTiles->mask[index]);
+				PREFETCH_READ(&corpusTiles->pixels[index * corpusTiles->depth]);
+			}
+		}
+		return;
+	}
+	if (isPatchInCorpus(point, patchBounds, corpusMap))
+	{
+		const Pixelel * const candidatePixel = pixmap_index(corpusMap, point);
+		for (i = 0; i < count; i++)
+			PREFETCH_READ(candidatePixel + neighbors[i].corpusDelta);
+		return;
+	}
+	for (i = 0; i < count; i++)
+	{
+		Coordinates neighborPoint = add_points(point, neighbors[i].offset);
+		if (neighborPoint.x >= 0 && neighborPoint.y >= 0
+			&& neighborPoint.x < (gint)corpusMap->width && neighborPoint.y < (gint)corpusMap->height)
+			PREFETCH_READ(pixmap_index(corpusMap, neighborPoint));
 	}
 }
 
 
+/*
+ * Whether a corpus point is among the first count corpus points probed for a target point.
+ * Heuristic 2 for deterministic synthesis, which must not share recentProberMap among threads.
+ */
+static inline gboolean isProbedCorpusPoint(Coordinates corpusPoint, const Coordinates probedPoints[], guint count)
+{
+	guint i;
+	for (i = 0; i < count; i++)
+		if (equal_points(probedPoints[i], corpusPoint)) return TRUE;
+	return FALSE;
+}
+
+
+/*
+ * \brief Synthesize one target point: search the corpus for the patch best matching the target point's patch.
+ * Returns whether the best match is a new source for the target point (a betterment.)
+ * Reads, but does not write, the target: the caller stores the new source and color, and sets hasValue.
+ * Tallies the target point.
+ */
+static gboolean synthesizeTargetPoint(
+	TImageSynthParameters *parameters,		// IN
+	guint target_index,						// IN
+	Coordinates position,					// IN
+	guint maxProbeCount,					// IN random probes
+	TFormatIndices* indices,				// IN
+	Map * targetMap,						// IN
+	Map* corpusMap,							// IN
+	Map* recentProberMap,					// IN/OUT, or NULL: remember probes privately
+	Map* hasValueMap,						// IN
+	Map* sourceOfMap,						// IN
+	PointVector corpusPoints,				// IN
+	PointVector sortedOffsets,				// IN
+	TProbeRandom* random,					// IN/OUT
+	TPixelelMetricFunc corpusTargetMetric,  // Array pointers
+	TMapPixelelMetricFunc mapsMetric,
+	TBestFitFunc bestFit,					// Kernel of computeBestFit()
+	const TCorpusTiles* corpusTiles,		// IN or NULL, for bestFit
+	TTargetEnergy* targetEnergies,			// OUT at target_index, or NULL
+	TNeighbor neighbors[],					// Scratch, IMAGE_SYNTH_MAX_NEIGHBORS
+	Coordinates* bestMatchCorpusPoint,		// OUT
+	TPassTally* tally)						// IN/OUT
+{
+	ImprovementType latestBettermentKind; // matchResult;
+	gboolean isPerfectMatch = FALSE;
+	gboolean isBettered = FALSE;
+
+	// Best match in this pass search for a matching patch.
+	guint bestPatchDiff;
+	guint countNeighbors = 0;
+	Bounds patchBounds;
+
+	// Corpus points probed by heuristic 1, when not using recentProberMap
+	Coordinates probedPoints[IMAGE_SYNTH_MAX_NEIGHBORS];
+	guint countProbed = 0;
+
+	*bestMatchCorpusPoint = { 0,0 };
+
+	/*
+	In the original algorithm, here we called setHasValue(&position, TRUE, hasValueMap);
+	Which meant we are about to give it a value (and a source),
+	but also was a flag that meant to put offset (0,0) in neighbors !!!
+	Now, we always put offset(0,0) in neighbors, and don't call setHasValue
+	until after we actually synthesize the pixel.
+	This is safer for threading: it eliminates a window where hasValue is set but color is uninitialized.
+	*/
+
+	countNeighbors = prepare_neighbors(position, parameters, indices,
+		targetMap, corpusMap, hasValueMap, sourceOfMap, sortedOffsets,
+		neighbors, &patchBounds
+		);
+
+	/*
+	Repeat a pixel even if found an exact match last pass, because neighbors might have changed.
+
+	On passes after the first, we don't explicitly start with best of the previous match,
+	but since a pixel is it's own first neighbor, the first best calculated will a be
+	from the source that gave the previous best, and should be a good starting best.
+	*/
+	bestPatchDiff = G_MAXUINT; /* A very large positive number.  Was: 1<<30 */
+	latestBettermentKind = NO_BETTERMENT;
+
+	/*
+	 * Heuristic 1, try neighbors of sources of neighbors of target pixel.
+	 * In other words, continue building this region of the target
+	 * from the corpus region (continuation) where neighbors of the target pixel came from.
+	 *
+	 * Subtle: The target pixel is its own first neighbor (offset 0,0).
+	 * On the first pass, it has no source.
+	 * On subsequent passes, it has a source and thus its source is the first corpus point to be probed again,
+	 * and that will set bestPatchDiff to a low value!!!
+	 */
+	{
+		guint neighbor_index;
+
+		// TODO check for zero here is redundant
+		for (neighbor_index = 0; neighbor_index < countNeighbors && bestPatchDiff != 0; neighbor_index++)
+		{
+			// If the neighbor is in the target (not the context) and has a source in the corpus (already synthesized.)
+			if (has_source_neighbor(neighbor_index, neighbors))
+			{
+				/*
+				Coord arithmetic: corpus source minus neighbor offset.
+				corpus_point is a pixel in the corpus with opposite offset to corpus source of neighbor
+				as target position has to this target neighbor.
+				!!! Note corpus_point is raw coordinate into corpus: might be masked.
+				!!! It is not an index into unmasked corpusPoints.
+				*/
+				Coordinates corpus_point = subtract_points(neighbors[neighbor_index].sourceOf,
+					neighbors[neighbor_index].offset);
+
+				/* !!! Must clip corpus_point before further use, its only potentially in the corpus. */
+				if (clippedOrMaskedCorpus(corpus_point, corpusMap)) continue;
+				if (recentProberMap)
+				{
+					if (*intmap_index(recentProberMap, corpus_point) == target_index) continue; // Heuristic 2
+				}
+				else if (isProbedCorpusPoint(corpus_point, probedPoints, countProbed)) continue;
+
+				isPerfectMatch = bestFit(corpus_point, indices, corpusMap, corpusTiles,
+					&bestPatchDiff, bestMatchCorpusPoint,
+					countNeighbors, neighbors, patchBounds,
+					&latestBettermentKind, NEIGHBORS_SOURCE,
+					corpusTargetMetric, mapsMetric, tally
+					);
+				// if ( matchResult == PERFECT_MATCH ) break;  // Break neighbors loop
+				if (isPerfectMatch) break;  // Break neighbors loop
+				/*
+				!!! Remember we probed corpus pixel point for target point target_index.
+				Heuristic 2: all target neighbors with values might come from the same corpus locus,
+				called a "continuation" in Harrison's thesis.
+				*/
+				/*
+				 * Shared and written but no mutex.  It should not be a problem,
+				 * even if garbled, the value written is not used except for a comparison.
+				 * At most, it would reduce the value of heuristic2.
+				 * Different threads are probably working in different continuations and not contending.
+				 */
+				if (recentProberMap)
+					*intmap_index(recentProberMap, corpus_point) = target_index;
+				else
+					probedPoints[countProbed++] = corpus_point;
+			}
+			// Else the neighbor is not in the target (has no source) so we can't use the heuristic 1.
+		}
+
+	}
+
+	// if ( matchResult != PERFECT_MATCH )
+	if (!isPerfectMatch)
+	{
+		/*
+		Match patches at random source points from the corpus.
+		In later passes, many will be earlyouts.
+
+		In batches: draw the random points of a batch and prefetch their patches,
+		then score them in the order drawn, each bounded by the best so far.
+		Still at most maxProbeCount probes, and the same probes as one at a time,
+		except a perfect match leaves the rest of its batch drawn but not probed.
+		*/
+		unsigned j;
+		for (j = 0; j < maxProbeCount && !isPerfectMatch; j += IMAGE_SYNTH_PROBE_BATCH)
+		{
+			Coordinates batch[IMAGE_SYNTH_PROBE_BATCH];
+			guint batchCount = MIN(IMAGE_SYNTH_PROBE_BATCH, maxProbeCount - j);
+			guint k;
+
+			for (k = 0; k < batchCount; k++)
+			{
+				batch[k] = probeRandomCorpusPoint(corpusPoints, random);
+				prefetchPatch(batch[k], patchBounds, corpusMap, corpusTiles, countNeighbors, neighbors);
+			}
+			for (k = 0; k < batchCount; k++)
+			{
+				isPerfectMatch = bestFit(batch[k],
+					indices, corpusMap, corpusTiles,
+					&bestPatchDiff, bestMatchCorpusPoint,
+					countNeighbors, neighbors, patchBounds,
+					&latestBettermentKind, RANDOM_CORPUS,
+					corpusTargetMetric, mapsMetric, tally
+					);
+
+				if (isPerfectMatch) break;  /* Break loop over random corpus points */
+				// if ( matchResult == PERFECT_MATCH ) break;  /* Break loop over random corpus points */
+				// Not set recentProberMap(point) since heuristic rarely works for random source.
+			}
+		}
+	}
+
+	/*
+	Energy: the best difference found, whether or not bettered.
+	On passes after the first, the target point's own source is probed first,
+	so this is the difference of the patch as it now stands.
+	Only unknown if there were no probes at all.
+	Also the target point's latest energy, for the energy of the whole target (see terminationAfterPass().)
+	*/
+	tally->targetCount++;
+	if (bestPatchDiff != G_MAXUINT)
+	{
+		tally->energy += bestPatchDiff;
+		if (targetEnergies)
+		{
+			targetEnergies[target_index].energy = bestPatchDiff;
+			targetEnergies[target_index].neighbors = countNeighbors;
+		}
+	}
+	if (isPerfectMatch)
+		tally->perfectMatches++;
+
+	/*
+	Compared to match from a previous pass:
+	 The best match may be no better.
+	 The best match may be the same source point.
+	 The best match may be the same color from a different source point.
+	 The best match may be the same source but a better match because the patch changed.
+	These are all independent.
+	We distinguish some of these cases: only a better matching, new source is a betterment.
+	*/
+	// if (matchResult != NO_BETTERMENT )
+	if (latestBettermentKind != NO_BETTERMENT
+		/* if source different from previous pass */
+		&& !equal_points(getSourceOf(position, sourceOfMap), *bestMatchCorpusPoint))
+	{
+		isBettered = TRUE;
+		tally->betters++;   /* feedback for termination. */
+		extendBounds(&tally->changedBounds, position);
+		if (latestBettermentKind == NEIGHBORS_SOURCE)
+			tally->bettersByNeighborsSource++;
+		else
+			tally->bettersByRandom++;
+	} /* else match is same or worse, or same source for target */
+
+	return isBettered;
+}
+
+
+/*
+ * \brief Fill one target point without searching: anytime synthesis, past the deadline of the fill pass.
+ * The source is the continuation of the nearest neighbor with a value (as heuristic 1, but not matched):
+ * the neighbor's source minus its offset, or if the neighbor is context, the neighbor itself.
+ * Else, when no near neighbor gives a corpus point, a random corpus point.
+ * No patch is compared, so no energy.  Like synthesizeTargetPoint(), the caller writes the target.
+ */
+static gboolean quickFillTargetPoint(
+	TImageSynthParameters *parameters,		// IN
+	Coordinates position,					// IN
+	Map * targetMap,						// IN
+	Map* corpusMap,							// IN
+	Map* hasValueMap,						// IN
+	Map* sourceOfMap,						// IN
+	PointVector corpusPoints,				// IN
+	PointVector sortedOffsets,				// IN
+	TProbeRandom* random,					// IN/OUT
+	Coordinates* bestMatchCorpusPoint,		// OUT
+	TPassTally* tally)						// IN/OUT
+{
+	ImprovementType kind = NO_BETTERMENT;
+	guint countNeighbors = 0;
+	guint j;
+
+	// Nearest first, and no farther than a patch
+	for (j = 1; j < sortedOffsets->len && countNeighbors < (guint)parameters->patchSize; j++)
+	{
+		Coordinates offset = sortedOffsets->data[j];
+		Coordinates neighbor_point = add_points(position, offset);
+		Coordinates candidate;
+
+		if (!clipToTargetOrWrapIfTiled(parameters, targetMap, &neighbor_point)
+			|| !getHasValue(neighbor_point, hasValueMap))
+			continue;
+		countNeighbors++;
+		{
+			std::unique_lock<std::mutex> lock(gSynthMutex, std::defer_lock);  // As new_neighbor()
+			if (!parameters->isDeterministic)
+				lock.lock();
+			candidate = getSourceOf(neighbor_point, sourceOfMap);
+		}
+		candidate = (candidate.x != -1) ? subtract_points(candidate, offset) : neighbor_point;
+		if (!clippedOrMaskedCorpus(candidate, corpusMap))
+		{
+			*bestMatchCorpusPoint = candidate;
+			kind = NEIGHBORS_SOURCE;
+			break;
+		}
+	}
+	if (kind == NO_BETTERMENT)
+	{
+		*bestMatchCorpusPoint = probeRandomCorpusPoint(corpusPoints, random);
+		kind = RANDOM_CORPUS;
+	}
+
+	tally->targetCount++;
+	if (equal_points(getSourceOf(position, sourceOfMap), *bestMatchCorpusPoint))
+		return FALSE;
+	tally->betters++;
+	extendBounds(&tally->changedBounds, position);
+	if (kind == NEIGHBORS_SOURCE)
+		tally->bettersByNeighborsSource++;
+	else
+		tally->bettersByRandom++;
+	return TRUE;
+}
+
+
 /* 
  * \brief The core of the synthesis algorithm
  * The heart of the algorithm.
  * Called repeatedly: many passes over the data.
+ * Tallies betters (feedback for termination) and energy of this slice of the pass.
  */
-static guint synthesize(
+static void synthesize(
 	TImageSynthParameters *parameters,		// IN
+	const TPassSchedule* schedule,			// IN
 	guint threadIndex,						// IN Zero if not threaded
 	guint startTargetIndex,					// IN
 	guint endTargetIndex,					// IN
@@ -432,18 +1067,22 @@ static guint synthesize(
 	GRand *prng,							// IN
 	TPixelelMetricFunc corpusTargetMetric,  // Array pointers
 	TMapPixelelMetricFunc mapsMetric,
+	TBestFitFunc bestFit,
+	const TCorpusTiles* corpusTiles,
+	TTargetEnergy* targetEnergies,			// IN/OUT latest best patch difference by target index, or NULL
 	std::function<void()>& deepProgressCallback,
-	int *cancelFlag)
+	int *cancelFlag,
+	TPassTally* tally)						// OUT
 {
 	guint target_index;
 	Coordinates position;
-	guint repeatCountBetters = 0;
+	guint countVisited = 0;  // target points visited by this thread, for periodic checks
+	gboolean isQuickFill = FALSE;  // past the deadline of the fill pass
+	TProbeRandom random;
 
-	ImprovementType latestBettermentKind; // matchResult;
-	gboolean isPerfectMatch = FALSE;
+	resetPassTally(tally);
+	prepareProbeRandom(&random, prng);
 
-	// Best match in this pass search for a matching patch.
-	guint bestPatchDiff;
 	Coordinates bestMatchCorpusPoint = { 0,0 };
 
 	/*
@@ -452,10 +1091,6 @@ static guint synthesize(
 	*/
 	// TODO this is large and allocated on the stack
 	TNeighbor neighbors[IMAGE_SYNTH_MAX_NEIGHBORS];
-	guint countNeighbors = 0;
-
-	/* ALT: count progress once at start of pass countTargetTries += repetition_params[pass][1]; */
-	reset_color_change();
 
 	// Each thread works on a slice of targetPoints.  Starting at the threadIndex, incremented by count of threads.
 	// If there is no threads or only one thread, starts at startTargetIndex, increments by 1
@@ -467,160 +1102,44 @@ static guint synthesize(
 		// Modulo is the intuitive way to do this.
 		// But here, we are testing for x lower bits all 1, say 4095, 1111111111.
 		// Don't AND with an arbitrary single bit, say 4096, since one bit is often set.
-		if ((target_index & IMAGE_SYNTH_CALLBACK_COUNT) == 0)
+		// !!! Count visits, not target_index, which when threaded has lower bits of the threadIndex.
+		if ((countVisited & IMAGE_SYNTH_CALLBACK_COUNT) == 0)
 		{
 			//deepProgressCallback();
 			if (*cancelFlag) break; // for each target pixel
 		}
 #endif
 
-		position = g_array_index(targetPoints, Coordinates, target_index);
-
-		/*
-		In the original algorithm, here we called setHasValue(&position, TRUE, hasValueMap);
-		Which meant we are about to give it a value (and a source),
-		but also was a flag that meant to put offset (0,0) in neighbors !!!
-		Now, we always put offset(0,0) in neighbors, and don't call setHasValue
-		until after we actually synthesize the pixel.
-		This is safer for threading: it eliminates a window where hasValue is set but color is uninitialized.
-		*/
-
-		countNeighbors = prepare_neighbors(position, parameters, indices,
-			targetMap, hasValueMap, sourceOfMap, sortedOffsets,
-			neighbors
-			);
-
-		/*
-		Repeat a pixel even if found an exact match last pass, because neighbors might have changed.
-
-		On passes after the first, we don't explicitly start with best of the previous match,
-		but since a pixel is it's own first neighbor, the first best calculated will a be
-		from the source that gave the previous best, and should be a good starting best.
-		*/
-		bestPatchDiff = G_MAXUINT; /* A very large positive number.  Was: 1<<30 */
-		isPerfectMatch = FALSE;
-		latestBettermentKind = NO_BETTERMENT;
-
-		/*
-		 * Heuristic 1, try neighbors of sources of neighbors of target pixel.
-		 * In other words, continue building this region of the target
-		 * from the corpus region (continuation) where neighbors of the target pixel came from.
-		 *
-		 * Subtle: The target pixel is its own first neighbor (offset 0,0).
-		 * On the first pass, it has no source.
-		 * On subsequent passes, it has a source and thus its source is the first corpus point to be probed again,
-		 * and that will set bestPatchDiff to a low value!!!
-		 */
+		// Anytime synthesis: at the deadline, quit refining, or finish the fill without searching.
+		if (!isQuickFill && (countVisited & IMAGE_SYNTH_DEADLINE_CHECK_COUNT) == 0 && isPastDeadline(schedule))
 		{
-			guint neighbor_index;
-
-			// TODO check for zero here is redundant
-			for (neighbor_index = 0; neighbor_index < countNeighbors && bestPatchDiff != 0; neighbor_index++)
-			{
-				// If the neighbor is in the target (not the context) and has a source in the corpus (already synthesized.)
-				if (has_source_neighbor(neighbor_index, neighbors))
-				{
-					/*
-					Coord arithmetic: corpus source minus neighbor offset.
-					corpus_point is a pixel in the corpus with opposite offset to corpus source of neighbor
-					as target position has to this target neighbor.
-					!!! Note corpus_point is raw coordinate into corpus: might be masked.
-					!!! It is not an index into unmasked corpusPoints.
-					*/
-					Coordinates corpus_point = subtract_points(neighbors[neighbor_index].sourceOf,
-						neighbors[neighbor_index].offset);
-
-					/* !!! Must clip corpus_point before further use, its only potentially in the corpus. */
-					if (clippedOrMaskedCorpus(corpus_point, corpusMap)) continue;
-					if (*intmap_index(recentProberMap, corpus_point) == target_index) continue; // Heuristic 2
-					isPerfectMatch = computeBestFit(corpus_point, indices, corpusMap,
-						&bestPatchDiff, &bestMatchCorpusPoint,
-						countNeighbors, neighbors,
-						&latestBettermentKind, NEIGHBORS_SOURCE,
-						corpusTargetMetric, mapsMetric
-						);
-					// TODO stats: if bettered, is kind NEIGHBORS_SOURCE 
-					// if ( matchResult == PERFECT_MATCH ) break;  // Break neighbors loop
-					if (isPerfectMatch) break;  // Break neighbors loop
-					/*
-					!!! Remember we probed corpus pixel point for target point target_index.
-					Heuristic 2: all target neighbors with values might come from the same corpus locus,
-					called a "continuation" in Harrison's thesis.
-					*/
-					/*
-					 * Shared and written but no mutex.  It should not be a problem,
-					 * even if garbled, the value written is not used except for a comparison.
-					 * At most, it would reduce the value of heuristic2.
-					 * Different threads are probably working in different continuations and not contending.
-					 */
-					*intmap_index(recentProberMap, corpus_point) = target_index;
-				}
-				// Else the neighbor is not in the target (has no source) so we can't use the heuristic 1.
-			}
-			
+			if (!schedule->isFillPass) break; // for each target pixel
+			isQuickFill = TRUE;
 		}
-
-		// if ( matchResult != PERFECT_MATCH )
-		if (!isPerfectMatch)
+		countVisited++;
+
+		position = targetPoints->data[target_index];
+
+		if (isQuickFill
+			? quickFillTargetPoint(parameters, position, targetMap, corpusMap, hasValueMap, sourceOfMap,
+				corpusPoints, sortedOffsets, &random, &bestMatchCorpusPoint, tally)
+			: synthesizeTargetPoint(parameters, target_index, position, schedule->maxProbeCount, indices,
+				targetMap, corpusMap, recentProberMap, hasValueMap, sourceOfMap,
+				corpusPoints, sortedOffsets, &random,
+				corpusTargetMetric, mapsMetric, bestFit, corpusTiles, targetEnergies,
+				neighbors, &bestMatchCorpusPoint, tally))
 		{
-			/*
-			Match patches at random source points from the corpus.
-			In later passes, many will be earlyouts.
-			*/
-			unsigned j;
-			for (j = 0; j < parameters->maxProbeCount; j++)
-			{
-				isPerfectMatch = computeBestFit(randomCorpusPoint(corpusPoints, prng),
-					indices, corpusMap,
-					&bestPatchDiff, &bestMatchCorpusPoint,
-					countNeighbors, neighbors,
-					&latestBettermentKind, RANDOM_CORPUS,
-					corpusTargetMetric, mapsMetric
-					);
-
-				if (isPerfectMatch) break;  /* Break loop over random corpus points */
-				// if ( matchResult == PERFECT_MATCH ) break;  /* Break loop over random corpus points */
-				// Not set recentProberMap(point) since heuristic rarely works for random source.
-				// TODO if bettered is kind RANDOM_CORPUS
-			}
+			/* Store best match: a better matching, new source */
+			std::unique_lock<std::mutex> lock{ gSynthMutex };    // Atomic write to color and sourceOf
+			// Save the new color values (!!! not the alpha) for this target point
+			setColor(indices, targetMap, position, corpusMap, bestMatchCorpusPoint);
+			setSourceOf(position, bestMatchCorpusPoint, sourceOfMap); /* Remember new source */
+			// printf("Position %d %d source %d %d\n", position.x, position.y, bestMatchCorpusPoint.x, bestMatchCorpusPoint.y);
 		}
 
-		store_betterment_stats(matchResult);
-		/* DEBUG dump_target_resynthesis(position); */
-
-		/*
-		Store best match.
-		Compared to match from a previous pass:
-		 The best match may be no better.
-		 The best match may be the same source point.
-		 The best match may be the same color from a different source point.
-		 The best match may be the same source but a better match because the patch changed.
-		These are all independent.
-		We distinguish some of these cases: only store a better matching, new source.
-		*/
-		// if (matchResult != NO_BETTERMENT )
-		if (latestBettermentKind != NO_BETTERMENT)
-		{
-			/* if source different from previous pass */
-			if (!equal_points(getSourceOf(position, sourceOfMap), bestMatchCorpusPoint))
-			{
-				repeatCountBetters++;   /* feedback for termination. */
-				integrate_color_change(position); // Must be before we store the new color values.
-
-				std::unique_lock<std::mutex> lock{ gSynthMutex };    // Atomic write to color and sourceOf
-				// Save the new color values (!!! not the alpha) for this target point
-				setColor(indices, targetMap, position, corpusMap, bestMatchCorpusPoint);
-				setSourceOf(position, bestMatchCorpusPoint, sourceOfMap); /* Remember new source */
-				// printf("Position %d %d source %d %d\n", position.x, position.y, bestMatchCorpusPoint.x, bestMatchCorpusPoint.y);					
-
-			} /* else same source for target */
-		} /* else match is same or worse */
-
 		// Shared, but no mutex lock because all writers are setting to the same value, TRUE
 		setHasValue(&position, TRUE, hasValueMap);
 	} /* end for each target pixel */
-
-	return repeatCountBetters;
 }
 
 
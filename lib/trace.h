@@ -0,0 +1,138 @@
+/*
+Trace of the phases of the engine: spans of wall time.
+
+For profiling: where does the time go, in preparation versus passes,
+and how evenly are passes divided among threads.
+Spans go to the caller's callback, and/or to a file in Chrome trace event format
+(open it in chrome://tracing or https://ui.perfetto.dev.)
+See TImageSynthExtras.
+
+When the caller wants no trace, each span costs only a test of a flag.
+
+Spans of the main thread have thread 0.
+A thread slice of a pass is timed by its own thread, privately,
+and traced by the main thread after the threads rejoin, so tracing takes no locks.
+
+  Copyright (C) 2010, 2011  Lloyd Konneker
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#pragma once
+#ifndef RESYNTH_TRACE_H_
+#define RESYNTH_TRACE_H_
+
+#include <cstdio>
+#include <chrono>
+#include <vector>
+
+// Not a pass, for spans of preparation
+#define TRACE_NO_PASS ((guint)-1)
+
+
+typedef struct tracerStruct {
+	gboolean isEnabled;
+	std::chrono::steady_clock::time_point origin;  // start of the engine
+	TImageSynthTraceCallback callback;  // or NULL
+	void* callbackContext;
+	const char* filePath;               // or NULL
+	std::vector<TImageSynthTraceSpan> spans;  // kept for the file
+} TTracer;
+
+
+static void prepareTracer(
+	TTracer* tracer,  // OUT
+	const TImageSynthExtras* extras,  // or NULL
+	std::chrono::steady_clock::time_point origin)
+{
+	tracer->origin = origin;
+	tracer->callback = (extras ? extras->traceCallback : NULL);
+	tracer->callbackContext = (extras ? extras->traceContext : NULL);
+	tracer->filePath = (extras ? extras->traceFilePath : NULL);
+	tracer->isEnabled = (tracer->callback != NULL || tracer->filePath != NULL);
+}
+
+
+static inline gdouble microsecondsFrom(std::chrono::steady_clock::time_point origin, std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration<gdouble, std::micro>(time - origin).count();
+}
+
+
+/* Trace a span between start and end. */
+static void traceSpanBetween(
+	TTracer* tracer,
+	const char* name,  // a literal, outlives the tracer
+	guint pass,        // or TRACE_NO_PASS
+	guint thread,
+	std::chrono::steady_clock::time_point start,
+	std::chrono::steady_clock::time_point end)
+{
+	TImageSynthTraceSpan span;
+
+	if (!tracer->isEnabled) return;
+
+	span.name = name;
+	span.pass = (pass == TRACE_NO_PASS ? -1 : (int)pass);
+	span.thread = thread;
+	span.startMicroseconds = microsecondsFrom(tracer->origin, start);
+	span.durationMicroseconds = microsecondsFrom(start, end);
+
+	if (tracer->callback)
+		tracer->callback(&span, tracer->callbackContext);
+	if (tracer->filePath)
+		tracer->spans.push_back(span);
+}
+
+
+/* Trace a span of the main thread from start until now.  Returns now, the start of a following span. */
+static inline std::chrono::steady_clock::time_point traceSpan(
+	TTracer* tracer,
+	const char* name,
+	std::chrono::steady_clock::time_point start)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	traceSpanBetween(tracer, name, TRACE_NO_PASS, 0, start, now);
+	return now;
+}
+
+
+/*
+Write the spans to the file, if any, as Chrome trace events: complete events ("ph":"X") in microseconds.
+Returns FALSE if the file could not be written.  The result of synthesis is unaffected.
+*/
+static gboolean finishTracer(TTracer* tracer)
+{
+	FILE* file;
+	size_t i;
+
+	if (!tracer->filePath) return TRUE;
+
+	file = fopen(tracer->filePath, "w");
+	if (!file) return FALSE;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (i = 0; i < tracer->spans.size(); i++)
+	{
+		const TImageSynthTraceSpan* span = &tracer->spans[i];
+		fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"resynthesizer\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+			"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"pass\":%d}}",
+			i ? "," : "", span->name, span->thread, span->startMicroseconds, span->durationMicroseconds, span->pass);
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+
+#endif /* RESYNTH_TRACE_H_ */
@@ -95,7 +95,7 @@ pixmap_to_drawable(
   for(i=0; i<width*height; i++)  // Iterate over map as a sequence
     for(j=0; j<pixelel_count; j++)  // Iterate over Pixelels
       img[i*pixelel_count+j] = 
-        g_array_index(map.data, Pixelel, i*map.depth+pixelel_offset+j);
+        map.data[i*map.depth+pixelel_offset+j];
   }
         
   /* Send seq of Pixelels to Gimp. */
@@ -152,7 +152,7 @@ pixmap_from_drawable(
   /* Copy SOME of the pixels from img sequence to our pixmap, OFFSET them. */
   for(i=0; i<width*height; i++)
     for(j=0; j<pixelel_count_to_copy; j++)  /* Count can be different from strides. */
-        g_array_index(map.data, Pixelel, i*map.depth+pixelel_offset+j)  /* Stride is depth of pixmap. */
+        map.data[i*map.depth+pixelel_offset+j]  /* Stride is depth of pixmap. */
           = img[i*drawable->bpp+j];   /* Stride is bpp */
   }
   
@@ -6,6 +6,8 @@ adaptPluginToLibraryParameters(
   TImageSynthParameters* p2
   )
 {
+  // Parameters the plugin does not expose take the library defaults
+  setDefaultParams(p2);
   p2->isMakeSeamlesslyTileableHorizontally = p1->h_tile;
   p2->isMakeSeamlesslyTileableVertically   = p1->v_tile;
   p2->matchContextType                     = p1->use_border;
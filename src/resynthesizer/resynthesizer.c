@@ -274,6 +274,7 @@ detach_drawables(
 
 #ifdef ADAPT_SIMPLE
   #include "imageBuffer.h"
+  #include "rowBands.h"
   #include "adaptSimple.h"
   #include "adaptGimpSimple.h"
 #endif
@@ -509,7 +510,8 @@ static void run(
     &corpusMap,
     progressUpdate,
     (void *) 0,
-    &cancelFlag
+    &cancelFlag,
+    (TImageSynthExtras *) NULL
     );
   
   if (result == IMAGE_SYNTH_ERROR_EMPTY_CORPUS)
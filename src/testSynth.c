@@ -44,7 +44,7 @@ dumpImage(
 	for (i=0; i<count; i++)
 	{
 		// hh is char, x is hex notation, O is left pad with zeroes, 2 is field width
-		printf("%02hhx ", (char) targetMap.data->data[i]);
+		printf("%02hhx ", (char) targetMap.data[i]);
 		if ( i % 5 == 4)
 			printf("\n");	// spaces after every 5 pixelels, ie after a pixel
 	}